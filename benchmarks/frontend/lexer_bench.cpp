@@ -0,0 +1,95 @@
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+#include "frontend/lexer.hpp"
+
+using Spark::FrontEnd::Lexer;
+using Spark::FrontEnd::LexerBackend;
+using Spark::FrontEnd::SourceBuffer;
+using Spark::FrontEnd::TokenType;
+
+/**
+ * Source of about 4 MiB made of a typical function with comments and strings.
+ */
+static const std::string& source() {
+    static const std::string src = [] {
+        constexpr std::string_view unit = R"(
+/* Picks the best score of the pots, see
+   https://www.geeksforgeeks.org/dsa/optimal-strategy-for-a-game-dp-31/ */
+fn potsOfGold(pots: Array<Int>^) -> Int do
+    fn recursion(pots: Array<Int>^, i: Int, j: Int, opt: Array<Array<Int>^>^) -> Int do
+        if i > j do
+            return 0 // no pot left
+        end
+        if opt[i][j] != 0 do
+            return opt[i][j]
+        end
+        const pickLeft = pots[i] + min(recursion(pots, i + 2, j, opt), recursion(pots, i + 1, j - 1, opt))
+        const pickRight = pots[j] + min(recursion(pots, i, j - 2, opt), recursion(pots, i + 1, j - 1, opt))
+        opt[i][j] = max(pickLeft, pickRight)
+        return opt[i][j]
+    end
+    const message = "computing the best strategy for\t\"pots\"..."
+    const ratio = 0_0.750 * 0x1F + 0b1010
+    return recursion(pots, 0, pots.size() - 1, Array(pots.size()))
+end
+)";
+        std::string s;
+        while (s.size() < (4 << 20)) {
+            s += unit;
+        }
+        return s;
+    }();
+    return src;
+}
+
+/**
+ * Source of about 4 MiB made of string tables (short strings and long strings embedding SQL).
+ */
+static const std::string& stringSource() {
+    static const std::string src = [] {
+        constexpr std::string_view unit = R"SPARK(
+const messages = {
+    "The quick brown fox jumps over the lazy dog, then rests under the old oak tree.",
+    'Pack my box with five dozen liquor jugs before the "guests" arrive tonight.',
+    "Escapes stay short:\tone\ttab\nand a new line."
+}
+const query = """
+    SELECT users.id, users.name, COUNT(orders.id) AS "order count"
+    FROM users LEFT JOIN orders ON orders.user_id = users.id
+    WHERE users.name LIKE 'A%' AND users.created_at > '2024-01-01'
+    GROUP BY users.id, users.name
+    ORDER BY "order count" DESC
+"""
+)SPARK";
+        std::string s;
+        while (s.size() < (4 << 20)) {
+            s += unit;
+        }
+        return s;
+    }();
+    return src;
+}
+
+static void BM_Lex(benchmark::State& state, LexerBackend backend, const std::string& (*source)()) {
+    const SourceBuffer srcbuf(source());
+    size_t tokens = 0;
+    for (auto _ : state) {
+        Lexer lexer(srcbuf, backend);
+        while (true) {
+            yy::parser::semantic_type semanticType;
+            yy::parser::location_type loc;
+            if (yylex(&semanticType, &loc, lexer) == TokenType::EndOfFile) {
+                break;
+            }
+            ++tokens;
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(tokens));
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * source().size()));
+}
+BENCHMARK_CAPTURE(BM_Lex, Flex, LexerBackend::Flex, source)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_Lex, Direct, LexerBackend::Direct, source)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_Lex, FlexStrings, LexerBackend::Flex, stringSource)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_Lex, DirectStrings, LexerBackend::Direct, stringSource)->Unit(benchmark::kMillisecond);
@@ -0,0 +1,45 @@
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "frontend/line_index.hpp"
+
+using Spark::FrontEnd::LineScanner;
+
+/**
+ * Source of about range(0) MiB with lines of 0 to 120 characters, 1 in 8 ending with CRLF.
+ */
+static const std::string& source(size_t mib) {
+    static std::string src;
+    if (src.size() < mib << 20) {
+        src.clear();
+        src.reserve((mib << 20) + 128);
+        std::mt19937 rng(42);
+        while (src.size() < mib << 20) {
+            src.append(rng() % 121, 'x');
+            src.append(rng() % 8 == 0 ? "\r\n" : "\n");
+        }
+    }
+    return src;
+}
+
+static void BM_LineStarts(benchmark::State& state, LineScanner scanner) {
+    if (!Spark::FrontEnd::isLineScannerSupported(scanner)) {
+        state.SkipWithError("unsupported on this CPU");
+        return;
+    }
+    const std::string& src = source(static_cast<size_t>(state.range(0)));
+    std::vector<uint32_t> starts;
+    for (auto _ : state) {
+        starts.clear();
+        Spark::FrontEnd::appendLineStarts(src, 0, starts, scanner);
+        benchmark::DoNotOptimize(starts.data());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * src.size()));
+}
+BENCHMARK_CAPTURE(BM_LineStarts, Scalar, LineScanner::Scalar)->Arg(256)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_LineStarts, SSE2, LineScanner::SSE2)->Arg(256)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_LineStarts, AVX2, LineScanner::AVX2)->Arg(256)->Unit(benchmark::kMillisecond);
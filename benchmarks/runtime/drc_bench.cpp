@@ -0,0 +1,249 @@
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "drc_graph.hpp"
+
+using Spark::Runtime::DRC;
+using Spark::Runtime::DRCHeader;
+using Spark::Runtime::DRCNode;
+
+using Graph = Spark::Benchmarks::DRCGraph;
+
+// Run with --benchmark_format=json (or --benchmark_out=<file>) for machine-readable results. Release benchmarks time
+// a single release per iteration, so their time per iteration is the pause of that release.
+
+namespace {
+    enum class Shape {
+        /**
+         * 0 -> 1 -> ... -> n-1
+         */
+        List,
+        /**
+         * 0 -> 1 -> ... -> n-1 -> 0
+         */
+        Ring,
+        /**
+         * Every node references every other node.
+         */
+        Complete,
+        /**
+         * Binary tree rooted at 0, every leaf references the root.
+         */
+        TreeWithBackEdges,
+    };
+
+    /**
+     * Graph of @p n nodes connected in a shape and held by an externally referenced holder (the last node).
+     * Everything but the holder is unreferenced externally, unless pinned.
+     */
+    Graph makeHeldShape(Shape shape, size_t n) {
+        Graph g(n + 1, 0);
+        DRCNode* holder = g.nodes[n];
+        g.objs[n].rcHeader.refCount = 1;
+        g.drc.retain(holder, g.nodes[0]);
+
+        switch (shape) {
+            case Shape::List:
+                for (size_t i = 0; i + 1 < n; ++i) {
+                    g.drc.retain(g.nodes[i], g.nodes[i + 1]);
+                }
+                break;
+            case Shape::Ring:
+                for (size_t i = 0; i < n; ++i) {
+                    g.drc.retain(g.nodes[i], g.nodes[(i + 1) % n]);
+                }
+                break;
+            case Shape::Complete:
+                for (size_t i = 0; i < n; ++i) {
+                    for (size_t j = 0; j < n; ++j) {
+                        if (i != j) {
+                            g.drc.retain(g.nodes[i], g.nodes[j]);
+                        }
+                    }
+                }
+                break;
+            case Shape::TreeWithBackEdges:
+                for (size_t i = 0; i < n; ++i) {
+                    if (2 * i + 1 < n) {
+                        g.drc.retain(g.nodes[i], g.nodes[2 * i + 1]);
+                    }
+                    if (2 * i + 2 < n) {
+                        g.drc.retain(g.nodes[i], g.nodes[2 * i + 2]);
+                    }
+                    if (2 * i + 1 >= n) {
+                        g.drc.retain(g.nodes[i], g.nodes[0]);
+                    }
+                }
+                break;
+        }
+        return g;
+    }
+
+    size_t edgeCount(Shape shape, size_t n) {
+        switch (shape) {
+            case Shape::List: return n - 1;
+            case Shape::Ring: return n;
+            case Shape::Complete: return n * (n - 1);
+            case Shape::TreeWithBackEdges: return n - 1 + (n + 1) / 2;
+        }
+        return 0;
+    }
+}
+
+/**
+ * Adding and removing range(0) nodes.
+ */
+static void BM_AddRemove(benchmark::State& state) {
+    const auto n = static_cast<size_t>(state.range(0));
+    DRC drc;
+    std::vector<DRCHeader> objs(n, DRCHeader { nullptr, { 0, nullptr } });
+    for (auto _ : state) {
+        for (DRCHeader& obj : objs) {
+            obj.node = drc.add(&obj);
+        }
+        for (DRCHeader& obj : objs) {
+            drc.remove(obj.node);
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * n * 2));
+}
+BENCHMARK(BM_AddRemove)->RangeMultiplier(8)->Range(64, 32768);
+
+/**
+ * Building a shape of range(0) nodes (retains only).
+ */
+static void BM_RetainShape(benchmark::State& state, Shape shape) {
+    const auto n = static_cast<size_t>(state.range(0));
+    for (auto _ : state) {
+        Graph g = makeHeldShape(shape, n);
+        benchmark::DoNotOptimize(g.nodes.data());
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * (edgeCount(shape, n) + 1)));
+}
+BENCHMARK_CAPTURE(BM_RetainShape, List, Shape::List)->RangeMultiplier(8)->Range(64, 32768);
+BENCHMARK_CAPTURE(BM_RetainShape, Ring, Shape::Ring)->RangeMultiplier(8)->Range(64, 32768);
+BENCHMARK_CAPTURE(BM_RetainShape, Complete, Shape::Complete)->RangeMultiplier(2)->Range(8, 128);
+BENCHMARK_CAPTURE(BM_RetainShape, TreeWithBackEdges, Shape::TreeWithBackEdges)->RangeMultiplier(8)->Range(64, 32768);
+
+/**
+ * Releasing the only reference to a shape of range(0) nodes, which collects all of it.
+ */
+static void BM_ReleaseGarbage(benchmark::State& state, Shape shape) {
+    const auto n = static_cast<size_t>(state.range(0));
+    for (auto _ : state) {
+        state.PauseTiming();
+        Graph g = makeHeldShape(shape, n);
+        state.ResumeTiming();
+        benchmark::DoNotOptimize(g.drc.release(g.nodes[n], g.nodes[0]).size());
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * n));
+}
+BENCHMARK_CAPTURE(BM_ReleaseGarbage, List, Shape::List)->RangeMultiplier(8)->Range(64, 32768);
+BENCHMARK_CAPTURE(BM_ReleaseGarbage, Ring, Shape::Ring)->RangeMultiplier(8)->Range(64, 32768);
+BENCHMARK_CAPTURE(BM_ReleaseGarbage, Complete, Shape::Complete)->RangeMultiplier(2)->Range(8, 128);
+BENCHMARK_CAPTURE(BM_ReleaseGarbage, TreeWithBackEdges, Shape::TreeWithBackEdges)
+    ->RangeMultiplier(8)->Range(64, 32768);
+
+/**
+ * Same as BM_ReleaseGarbage with cleanups of more than 4096 nodes going parallel on range(1) workers.
+ */
+static void BM_ReleaseGarbageParallel(benchmark::State& state, Shape shape) {
+    const auto n = static_cast<size_t>(state.range(0));
+    for (auto _ : state) {
+        state.PauseTiming();
+        Graph g = makeHeldShape(shape, n);
+        g.drc.setParallelCleanup(4096, static_cast<size_t>(state.range(1)));
+        state.ResumeTiming();
+        benchmark::DoNotOptimize(g.drc.release(g.nodes[n], g.nodes[0]).size());
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * n));
+}
+BENCHMARK_CAPTURE(BM_ReleaseGarbageParallel, Ring, Shape::Ring)
+    ->ArgsProduct({ { 32768, 262144 }, { 1, 2, 4 } })->UseRealTime();
+BENCHMARK_CAPTURE(BM_ReleaseGarbageParallel, TreeWithBackEdges, Shape::TreeWithBackEdges)
+    ->ArgsProduct({ { 32768, 262144 }, { 1, 2, 4 } })->UseRealTime();
+
+/**
+ * Releasing a reference to a shape of range(0) nodes where the last node is pinned by an external reference, so the
+ * cleanup traverses it but collects nothing that the pinned node reaches.
+ */
+static void BM_ReleasePinned(benchmark::State& state, Shape shape) {
+    const auto n = static_cast<size_t>(state.range(0));
+    Graph g = makeHeldShape(shape, n);
+    g.objs[n - 1].rcHeader.refCount = 1;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(g.drc.release(g.nodes[n], g.nodes[0]).size());
+        state.PauseTiming();
+        g.drc.retain(g.nodes[n], g.nodes[0]);
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * n));
+}
+BENCHMARK_CAPTURE(BM_ReleasePinned, Ring, Shape::Ring)->RangeMultiplier(8)->Range(64, 32768);
+BENCHMARK_CAPTURE(BM_ReleasePinned, Complete, Shape::Complete)->RangeMultiplier(2)->Range(8, 128);
+BENCHMARK_CAPTURE(BM_ReleasePinned, TreeWithBackEdges, Shape::TreeWithBackEdges)
+    ->RangeMultiplier(8)->Range(64, 32768);
+
+/**
+ * Random churn over 4096 externally referenced nodes: random retains and releases, with a candidate threshold of
+ * range(0) (0 cleans up on every release). Half of the nodes lose their external reference, so cycles among them are
+ * garbage and collected along the way; collected nodes are replaced by fresh ones.
+ */
+static void BM_RandomChurn(benchmark::State& state) {
+    constexpr size_t NodeCount = 4096;
+    constexpr size_t OpsPerIteration = 4096;
+
+    Graph g(NodeCount);
+    g.drc.setCandidateThreshold(static_cast<size_t>(state.range(0)));
+    for (size_t i = 0; i < NodeCount; i += 2) {
+        g.objs[i].rcHeader.refCount = 0;
+    }
+
+    // Edges as pairs of object indices
+    std::vector<std::pair<size_t, size_t>> edges;
+    std::vector<uint8_t> collected(NodeCount, 0);
+    std::mt19937 rng(42);
+
+    auto replaceCollected = [&](const std::vector<DRCNode*>& nodes) {
+        if (nodes.empty()) {
+            return;
+        }
+        for (DRCNode* node : nodes) {
+            DRCHeader* obj = node->obj;
+            size_t i = static_cast<size_t>(obj - g.objs.data());
+            collected[i] = 1;
+            g.drc.remove(node);
+            obj->node = g.drc.add(obj);
+            g.nodes[i] = obj->node;
+        }
+        // Edges of collected nodes went away with them
+        edges.erase(std::remove_if(edges.begin(), edges.end(), [&](const auto& edge) {
+            return collected[edge.first] || collected[edge.second];
+        }), edges.end());
+        std::fill(collected.begin(), collected.end(), 0);
+    };
+
+    for (auto _ : state) {
+        for (size_t op = 0; op < OpsPerIteration; ++op) {
+            if (edges.empty() || rng() % 2 == 0) {
+                size_t owner = rng() % NodeCount;
+                size_t referencee = rng() % NodeCount;
+                g.drc.retain(g.nodes[owner], g.nodes[referencee]);
+                edges.emplace_back(owner, referencee);
+            } else {
+                size_t i = rng() % edges.size();
+                auto [owner, referencee] = edges[i];
+                edges[i] = edges.back();
+                edges.pop_back();
+                replaceCollected(g.drc.release(g.nodes[owner], g.nodes[referencee]));
+            }
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * OpsPerIteration));
+}
+BENCHMARK(BM_RandomChurn)->Arg(0)->Arg(64)->Arg(1024);
@@ -0,0 +1,101 @@
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "drc_graph.hpp"
+
+using Spark::Runtime::DRCHeader;
+using Spark::Runtime::DRCNode;
+
+using Graph = Spark::Benchmarks::DRCGraph;
+
+/**
+ * Narrow fan-out: every node retains and releases a few (range(0)) other nodes.
+ */
+static void BM_RetainReleaseNarrow(benchmark::State& state) {
+    const auto fanOut = static_cast<size_t>(state.range(0));
+    Graph g(4096);
+    for (auto _ : state) {
+        for (size_t i = 0; i < g.nodes.size(); ++i) {
+            for (size_t j = 1; j <= fanOut; ++j) {
+                g.drc.retain(g.nodes[i], g.nodes[(i + j) % g.nodes.size()]);
+            }
+        }
+        for (size_t i = 0; i < g.nodes.size(); ++i) {
+            for (size_t j = 1; j <= fanOut; ++j) {
+                g.drc.release(g.nodes[i], g.nodes[(i + j) % g.nodes.size()]);
+            }
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * g.nodes.size() * fanOut * 2));
+}
+BENCHMARK(BM_RetainReleaseNarrow)->Arg(1)->Arg(2)->Arg(4);
+
+/**
+ * Wide fan-out: one hub retains range(0) nodes (each twice) then releases them in random order.
+ */
+static void BM_RetainReleaseWide(benchmark::State& state) {
+    const auto fanOut = static_cast<size_t>(state.range(0));
+    Graph g(fanOut + 1);
+    DRCNode* hub = g.nodes[0];
+    std::vector<DRCNode*> order;
+    for (size_t i = 1; i <= fanOut; ++i) {
+        order.push_back(g.nodes[i]);
+        order.push_back(g.nodes[i]);
+    }
+    std::shuffle(order.begin(), order.end(), std::mt19937(42));
+    for (auto _ : state) {
+        for (size_t i = 1; i <= fanOut; ++i) {
+            g.drc.retain(hub, g.nodes[i]);
+            g.drc.retain(hub, g.nodes[i]);
+        }
+        for (DRCNode* node : order) {
+            g.drc.release(hub, node);
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * order.size() * 2));
+}
+BENCHMARK(BM_RetainReleaseWide)->RangeMultiplier(8)->Range(8, 32768);
+
+/**
+ * Cleanup of an unreferenced hub with range(0) children (garbage, collected every iteration).
+ */
+static void BM_TryCleanupWide(benchmark::State& state) {
+    const auto fanOut = static_cast<size_t>(state.range(0));
+    for (auto _ : state) {
+        state.PauseTiming();
+        Graph g(fanOut + 1);
+        for (DRCHeader& obj : g.objs) {
+            obj.rcHeader.refCount = 0;
+        }
+        for (size_t i = 1; i <= fanOut; ++i) {
+            g.drc.retain(g.nodes[0], g.nodes[i]);
+        }
+        state.ResumeTiming();
+        benchmark::DoNotOptimize(g.drc.tryCleanup(g.nodes[0]).size());
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * (fanOut + 1)));
+}
+BENCHMARK(BM_TryCleanupWide)->RangeMultiplier(8)->Range(8, 32768);
+
+/**
+ * Cleanup of a ring of range(0) nodes pinned by one externally referenced node (the cleanup finds nothing).
+ */
+static void BM_TryCleanupPinnedRing(benchmark::State& state) {
+    const auto n = static_cast<size_t>(state.range(0));
+    Graph g(n);
+    for (DRCHeader& obj : g.objs) {
+        obj.rcHeader.refCount = 0;
+    }
+    g.objs[n / 2].rcHeader.refCount = 1;
+    for (size_t i = 0; i < n; ++i) {
+        g.drc.retain(g.nodes[i], g.nodes[(i + 1) % n]);
+    }
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(g.drc.tryCleanup(g.nodes[0]).size());
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * n));
+}
+BENCHMARK(BM_TryCleanupPinnedRing)->RangeMultiplier(8)->Range(64, 32768);
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <vector>
+
+#include "runtime/drc.hpp"
+
+namespace Spark::Benchmarks {
+
+/**
+ * Graph of DRC nodes without any edge, for benchmarks.
+ */
+struct DRCGraph {
+    Runtime::DRC drc;
+    std::vector<Runtime::DRCHeader> objs;
+    std::vector<Runtime::DRCNode*> nodes;
+
+    /**
+     * Constructs a graph of @p n nodes, each with an external reference count of @p externalRefCount.
+     */
+    explicit DRCGraph(size_t n, uint32_t externalRefCount = 1)
+        : objs(n, Runtime::DRCHeader { nullptr, { externalRefCount, nullptr } }) {
+        nodes.reserve(n);
+        for (Runtime::DRCHeader& obj : objs) {
+            obj.node = drc.add(&obj);
+            nodes.push_back(obj.node);
+        }
+    }
+};
+
+} // Spark::Benchmarks
@@ -0,0 +1,179 @@
+#include <chrono>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "runtime/slab_allocator.hpp"
+#include "runtime/spark.hpp"
+
+using Spark::Type;
+using Spark::Runtime::DefaultAllocator;
+using Spark::Runtime::DRCHeader;
+using Spark::Runtime::RCHeader;
+using Spark::Runtime::SlabAllocator;
+using Spark::Runtime::Thread;
+
+/**
+ * Allocating range(0) RC objects of 32 bytes, then deleting them.
+ */
+template <typename Allocator>
+static void BM_NewRCObject(benchmark::State& state) {
+    const auto n = static_cast<size_t>(state.range(0));
+    Type type(sizeof(RCHeader) + 16);
+    Thread<Allocator> th;
+    std::vector<RCHeader*> objs(n);
+    for (auto _ : state) {
+        for (RCHeader*& obj : objs) {
+            obj = Thread<Allocator>::newRCObject(&th, &type);
+        }
+        for (RCHeader* obj : objs) {
+            Thread<Allocator>::deleteRCObject(&th, obj);
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * n));
+}
+BENCHMARK_TEMPLATE(BM_NewRCObject, DefaultAllocator)->RangeMultiplier(8)->Range(64, 32768);
+BENCHMARK_TEMPLATE(BM_NewRCObject, SlabAllocator)->RangeMultiplier(8)->Range(64, 32768);
+
+/**
+ * Allocating range(0) RC objects of 32 bytes in the nursery, then deleting them (the nursery holds about 16K of them).
+ */
+static void BM_NewRCObjectNursery(benchmark::State& state) {
+    using DefaultThread = Thread<DefaultAllocator>;
+    const auto n = static_cast<size_t>(state.range(0));
+    Type type(sizeof(RCHeader) + 16);
+    DefaultThread th;
+    DefaultThread::useNursery(&th);
+    std::vector<RCHeader*> objs(n);
+    for (auto _ : state) {
+        for (RCHeader*& obj : objs) {
+            obj = DefaultThread::newRCObject(&th, &type);
+        }
+        for (RCHeader* obj : objs) {
+            DefaultThread::deleteRCObject(&th, obj);
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * n));
+}
+BENCHMARK(BM_NewRCObjectNursery)->RangeMultiplier(8)->Range(64, 32768);
+
+/**
+ * Allocating range(0) unreferenced DRC objects in the nursery, reclaimed by a minor collection (range(0) stays within
+ * the nursery, objects allocated past it would never be reclaimed).
+ */
+static void BM_NewDRCObjectNursery(benchmark::State& state) {
+    using DefaultThread = Thread<DefaultAllocator>;
+    const auto n = static_cast<size_t>(state.range(0));
+    Type type(sizeof(DRCHeader) + 16);
+    DefaultThread th;
+    DefaultThread::useNursery(&th);
+    for (auto _ : state) {
+        for (size_t i = 0; i < n; ++i) {
+            benchmark::DoNotOptimize(DefaultThread::newDRCObject(&th, &type));
+        }
+        DefaultThread::nurseryCollect(&th);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * n));
+}
+BENCHMARK(BM_NewDRCObjectNursery)->RangeMultiplier(8)->Range(64, 8192);
+
+/**
+ * Allocating range(0) DRC objects held by a root, then releasing them (each release collects one object).
+ */
+template <typename Allocator>
+static void BM_NewDRCObject(benchmark::State& state) {
+    const auto n = static_cast<size_t>(state.range(0));
+    Type type(sizeof(DRCHeader) + 16);
+    Thread<Allocator> th;
+    DRCHeader* root = Thread<Allocator>::newDRCObject(&th, &type);
+    root->rcHeader.refCount = 1;
+    std::vector<DRCHeader*> objs(n);
+    for (auto _ : state) {
+        for (DRCHeader*& obj : objs) {
+            obj = Thread<Allocator>::newDRCObject(&th, &type);
+            Thread<Allocator>::drcRetainDRC(&th, root, obj);
+        }
+        for (DRCHeader* obj : objs) {
+            Thread<Allocator>::drcReleaseDRC(&th, root, obj);
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * n));
+}
+BENCHMARK_TEMPLATE(BM_NewDRCObject, DefaultAllocator)->RangeMultiplier(8)->Range(64, 32768);
+BENCHMARK_TEMPLATE(BM_NewDRCObject, SlabAllocator)->RangeMultiplier(8)->Range(64, 32768);
+
+/**
+ * Retaining and releasing an RC object on its owner thread (biased count) or on another thread (shared count).
+ */
+static void BM_RCRetainRelease(benchmark::State& state, bool owner) {
+    using DefaultThread = Thread<DefaultAllocator>;
+    Type type(sizeof(RCHeader));
+    DefaultThread ownerThread;
+    DefaultThread otherThread;
+    DefaultThread* th = owner ? &ownerThread : &otherThread;
+    RCHeader* obj = DefaultThread::newRCObject(&ownerThread, &type);
+    DefaultThread::rcRetain(&ownerThread, obj);
+    for (auto _ : state) {
+        DefaultThread::rcRetain(th, obj);
+        DefaultThread::rcRelease(th, obj);
+    }
+    DefaultThread::rcRelease(&ownerThread, obj);
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * 2));
+}
+BENCHMARK_CAPTURE(BM_RCRetainRelease, Owner, true);
+BENCHMARK_CAPTURE(BM_RCRetainRelease, Shared, false);
+
+/**
+ * Retaining and releasing a DRC edge from a root, without (false) or with (true) a background cycle collector attached.
+ * The collector has nothing to do, so this is the cost of taking the uncontended graph lock on every operation.
+ */
+static void BM_DRCRetainRelease(benchmark::State& state, bool background) {
+    using DefaultThread = Thread<DefaultAllocator>;
+    Type type(sizeof(DRCHeader));
+    Spark::Runtime::Spark<> spark({}, background);
+    DefaultThread* th = spark.newThread();
+    DRCHeader* root = DefaultThread::newDRCObject(th, &type);
+    root->rcHeader.refCount = 1;
+    DRCHeader* obj = DefaultThread::newDRCObject(th, &type);
+    obj->rcHeader.refCount = 1;
+    for (auto _ : state) {
+        DefaultThread::drcRetainDRC(th, root, obj);
+        DefaultThread::drcReleaseDRC(th, root, obj);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * 2));
+}
+BENCHMARK_CAPTURE(BM_DRCRetainRelease, Inline, false);
+BENCHMARK_CAPTURE(BM_DRCRetainRelease, Background, true);
+
+/**
+ * Building and dropping range(0) garbage rings of 8 DRC objects, with the cycles collected on the mutator thread
+ * (false) or by a background cycle collector (true), whose steps hold the graph lock that every mutator operation takes.
+ * Items are mutator operations (allocations, retains and releases), the garbage is freed at a safe point per iteration.
+ */
+static void BM_DRCGarbageRings(benchmark::State& state, bool background) {
+    using DefaultThread = Thread<DefaultAllocator>;
+    constexpr size_t RingSize = 8;
+    const auto n = static_cast<size_t>(state.range(0));
+    Type type(sizeof(DRCHeader));
+    Spark::Runtime::Spark<> spark({}, background);
+    DefaultThread* th = spark.newThread();
+    DRCHeader* root = DefaultThread::newDRCObject(th, &type);
+    root->rcHeader.refCount = 1;
+    DRCHeader* ring[RingSize];
+    for (auto _ : state) {
+        for (size_t i = 0; i < n; ++i) {
+            for (DRCHeader*& obj : ring) {
+                obj = DefaultThread::newDRCObject(th, &type);
+            }
+            for (size_t j = 0; j < RingSize; ++j) {
+                DefaultThread::drcRetainDRC(th, ring[j], ring[(j + 1) % RingSize]);
+            }
+            DefaultThread::drcRetainDRC(th, root, ring[0]);
+            DefaultThread::drcReleaseDRC(th, root, ring[0]);
+        }
+        DefaultThread::drcSafePoint(th, std::chrono::nanoseconds(0));
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * n * (2 * RingSize + 2)));
+}
+BENCHMARK_CAPTURE(BM_DRCGarbageRings, Inline, false)->RangeMultiplier(8)->Range(64, 4096);
+BENCHMARK_CAPTURE(BM_DRCGarbageRings, Background, true)->RangeMultiplier(8)->Range(64, 4096);
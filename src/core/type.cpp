@@ -0,0 +1,114 @@
+﻿#include "type.hpp"
+
+#include <mutex>
+#include <stdexcept>
+
+namespace Spark {
+
+/**
+ * Registration side of the global type table (see `Type::_table`).
+ */
+class TypeTable {
+private:
+    std::mutex _mutex;
+
+    /**
+     * Next never used index (0 is reserved for no type).
+     */
+    uint32_t _next = 1;
+
+    /**
+     * Serial of the next registered type.
+     */
+    uint64_t _nextSerial = 0;
+
+    /**
+     * Indices of destroyed types, to be reused.
+     */
+    std::vector<uint32_t> _free;
+
+public:
+    static TypeTable& instance() noexcept {
+        static TypeTable table;
+        return table;
+    }
+
+    ~TypeTable() noexcept {
+        for (std::atomic<const Type*>*& chunk : Type::_table) {
+            delete[] chunk;
+            chunk = nullptr;
+        }
+    }
+
+    static void set(uint32_t index, const Type* type) noexcept {
+        Type::_table[index >> Type::TableChunkBits][index & (Type::TableChunkSize - 1)]
+            .store(type, std::memory_order_relaxed);
+    }
+
+    uint32_t add(Type* type) {
+        std::lock_guard lock(_mutex);
+        uint32_t index;
+        if (!_free.empty()) {
+            index = _free.back();
+            _free.pop_back();
+        } else {
+            if (_next > Type::TableCapacity) {
+                throw std::length_error("too many Spark types");
+            }
+            std::atomic<const Type*>*& chunk = Type::_table[_next >> Type::TableChunkBits];
+            if (chunk == nullptr) {
+                chunk = new std::atomic<const Type*>[Type::TableChunkSize]();
+            }
+            index = _next++;
+        }
+        type->_serial = _nextSerial++;
+        set(index, type);
+        return index;
+    }
+
+    void remove(uint32_t index) noexcept {
+        std::lock_guard lock(_mutex);
+        set(index, nullptr);
+        _free.push_back(index);
+    }
+};
+
+Type::~Type() noexcept {
+    if (_index != 0) {
+        TypeTable::instance().remove(_index);
+    }
+}
+
+Type::Type(Type&& other) noexcept
+    : _size(other._size), _destructor(other._destructor), _drcFields(std::move(other._drcFields)),
+      _traced(other._traced), _serial(other._serial), _index(other._index) {
+    other._index = 0;
+    if (_index != 0) {
+        TypeTable::set(_index, this);
+    }
+}
+
+Type& Type::operator=(Type&& other) noexcept {
+    if (this != &other) {
+        if (_index != 0) {
+            TypeTable::instance().remove(_index);
+        }
+        _size = other._size;
+        _destructor = other._destructor;
+        _drcFields = std::move(other._drcFields);
+        _traced = other._traced;
+        _serial = other._serial;
+        _index = other._index;
+        other._index = 0;
+        if (_index != 0) {
+            TypeTable::set(_index, this);
+        }
+    }
+    return *this;
+}
+
+uint32_t Type::registerType(Type* type) {
+    return TypeTable::instance().add(type);
+}
+
+} // Spark
@@ -1,6 +1,10 @@
 ﻿#pragma once
 
+#include <atomic>
 #include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
 
 namespace Spark {
 
@@ -11,18 +15,106 @@ class Type {
 private:
     using Destructor = void (*)(void*);
 
+    static constexpr uint32_t TableChunkBits = 12;
+    static constexpr uint32_t TableChunkSize = 1 << TableChunkBits;
+    static constexpr uint32_t TableChunkCount = 1 << 12;
+
+    /**
+     * Maximum number of types alive at once (index 0 is reserved for no type).
+     */
+    static constexpr uint32_t TableCapacity = TableChunkSize * TableChunkCount - 1;
+
+    /**
+     * Chunks of the global type table, indexed by type index. Chunks never move, so lookups don't lock.
+     */
+    static inline std::atomic<const Type*>* _table[TableChunkCount] = { };
+
     size_t _size;
 
     Destructor _destructor = nullptr;
 
+    /**
+     * Offsets of the DRC reference fields (`DRCHeader*`) of the objects, if `_traced`.
+     */
+    std::vector<size_t> _drcFields;
+
+    bool _traced = false;
+
+    /**
+     * Number of types registered before the type (set by `registerType`).
+     */
+    uint64_t _serial = 0;
+
+    /**
+     * Index of the type in the type table (see `TypeRef`).
+     */
+    uint32_t _index;
+
 public:
-    explicit Type(size_t size, Destructor destructor = nullptr) noexcept : _size(size), _destructor(destructor) { }
+    /**
+     * Constructs a type.
+     *
+     * @param size Size of the type in bytes.
+     * @param destructor Destructor of the type.
+     * @throws std::length_error if `TableCapacity` types are alive already.
+     */
+    explicit Type(size_t size, Destructor destructor = nullptr)
+        : _size(size), _destructor(destructor), _index(registerType(this)) { }
+
+    /**
+     * Constructs a traced type, whose objects have their DRC references at known offsets.
+     * The DRC graph derives the outgoing edges of such objects from their memory instead of storing them.
+     *
+     * @param size Size of the type in bytes.
+     * @param drcFields Offsets of the DRC reference fields (`DRCHeader*`, nullptr if unset) in the objects.
+     * @param destructor Destructor of the type.
+     * @throws std::length_error if `TableCapacity` types are alive already.
+     */
+    Type(size_t size, std::vector<size_t> drcFields, Destructor destructor = nullptr)
+        : _size(size), _destructor(destructor), _drcFields(std::move(drcFields)), _traced(true),
+          _index(registerType(this)) { }
+
+    ~Type() noexcept;
 
     Type(const Type& other) = delete;
     Type& operator=(const Type& other) = delete;
 
-    Type(Type&& other) noexcept = default;
-    Type& operator=(Type&& other) noexcept = default;
+    Type(Type&& other) noexcept;
+    Type& operator=(Type&& other) noexcept;
+
+    /**
+     * Gets the type registered at an index of the type table.
+     *
+     * @param index Index of the type, 0 for none.
+     * @return Registered type, nullptr if @p index is 0.
+     */
+    static const Type* fromIndex(uint32_t index) noexcept {
+        if (index == 0) {
+            return nullptr;
+        }
+        return _table[index >> TableChunkBits][index & (TableChunkSize - 1)].load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Gets the index of the type in the type table (never 0).
+     *
+     * @return Index of the type.
+     */
+    [[nodiscard]]
+    uint32_t index() const noexcept {
+        return _index;
+    }
+
+    /**
+     * Gets the registration serial of the type: unlike its index, it is never reused by a later type, so per-index
+     * state (e.g. in a thread) can tell a type from a destroyed type that had the same index.
+     *
+     * @return Serial of the type.
+     */
+    [[nodiscard]]
+    uint64_t serial() const noexcept {
+        return _serial;
+    }
 
     /**
      * Calls the destructor of the type (if exist).
@@ -35,6 +127,36 @@ public:
         }
     }
 
+    /**
+     * Checks if the type has a destructor.
+     *
+     * @return true if the type has a destructor, false otherwise.
+     */
+    [[nodiscard]]
+    bool hasDestructor() const noexcept {
+        return _destructor != nullptr;
+    }
+
+    /**
+     * Checks if the type has a trace map (see `drcFields`).
+     *
+     * @return true if the DRC references of the objects are at known offsets, false otherwise.
+     */
+    [[nodiscard]]
+    bool traced() const noexcept {
+        return _traced;
+    }
+
+    /**
+     * Gets the offsets of the DRC reference fields of the objects (empty unless the type is traced).
+     *
+     * @return Offsets of the DRC reference fields in bytes.
+     */
+    [[nodiscard]]
+    const std::vector<size_t>& drcFields() const noexcept {
+        return _drcFields;
+    }
+
     /**
      * Size of the type in bytes for the current platform.
      */
@@ -42,6 +164,50 @@ public:
     constexpr size_t size() const noexcept {
         return _size;
     }
+
+private:
+    friend class TypeTable;
+
+    /**
+     * Adds a type to the type table, reusing the index of a destroyed type if any, and sets its serial.
+     *
+     * @throws std::length_error if the table is full.
+     */
+    static uint32_t registerType(Type* type);
+};
+
+/**
+ * Compact reference to a type: its 32-bit index in the type table, 0 for none.
+ * Converts to and from `const Type*`, so it can be used in place of a type pointer in object headers.
+ */
+class TypeRef {
+private:
+    uint32_t _index = 0;
+
+public:
+    TypeRef() noexcept = default;
+
+    TypeRef(std::nullptr_t) noexcept { }
+
+    TypeRef(const Type* type) noexcept : _index(type != nullptr ? type->index() : 0) { }
+
+    [[nodiscard]]
+    const Type* get() const noexcept {
+        return Type::fromIndex(_index);
+    }
+
+    operator const Type*() const noexcept {
+        return get();
+    }
+
+    const Type* operator->() const noexcept {
+        return get();
+    }
+
+    [[nodiscard]]
+    uint32_t index() const noexcept {
+        return _index;
+    }
 };
 
 } // Spark
@@ -54,6 +54,15 @@ public:
     InternedNameValue intern(NameValue v) {
         return _interner.intern(std::move(v));
     }
+
+    /**
+     * Interns an identifier, see `NameValueInterner::internIdentifier`.
+     * @param name Name of the identifier.
+     * @return `InternedNameValue` instance.
+     */
+    InternedNameValue internIdentifier(std::string_view name) {
+        return _interner.internIdentifier(name);
+    }
 };
 
 } // Spark::FrontEnd
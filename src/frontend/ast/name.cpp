@@ -70,4 +70,13 @@ InternedNameValue NameValueInterner::intern(NameValue value) {
     return InternedNameValue{it->get()};
 }
 
+InternedNameValue NameValueInterner::internIdentifier(std::string_view name) {
+    if (auto it = _identifiers.find(name); it != _identifiers.end()) {
+        return it->second;
+    }
+    InternedNameValue interned = intern(NameValue::identifier(std::string(name)));
+    _identifiers.emplace(interned.str(), interned);
+    return interned;
+}
+
 } // Spark::FrontEnd
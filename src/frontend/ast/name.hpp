@@ -3,6 +3,8 @@
 #include <memory>
 #include <ostream>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <unordered_set>
 #include <variant>
 
@@ -145,8 +147,20 @@ private:
 
     std::unordered_set<std::unique_ptr<NameValue>, PtrHash, PtrEq> _set;
 
+    /**
+     * Interned identifiers by name, keyed by views of the names they own.
+     */
+    std::unordered_map<std::string_view, InternedNameValue> _identifiers;
+
 public:
     InternedNameValue intern(NameValue value);
+
+    /**
+     * Interns an identifier, without allocating if it has been interned before.
+     * @param name Name of the identifier.
+     * @return Interned identifier.
+     */
+    InternedNameValue internIdentifier(std::string_view name);
 };
 
 } // Spark::FrontEnd
@@ -1,22 +1,36 @@
 ﻿#include "lexer.hpp"
 
 #include <new>
+#include <stdexcept>
 
 #include <lex.yy.hpp>
 
 namespace Spark::FrontEnd {
 
-Lexer::Lexer(SourceBuffer srcbuf)
-    : _scanner(nullptr), _lstate(_srcbuf, 1, 1), _srcbuf(std::move(srcbuf)) {
+Lexer::Lexer(SourceBuffer srcbuf, LexerBackend backend)
+    : _scanner(nullptr), _lstate(_srcbuf, 1, 1), _backend(backend), _direct(_lstate), _srcbuf(std::move(srcbuf)) {
+    if (backend == LexerBackend::Direct) {
+        return;
+    }
+
     yylex_init_extra(&_lstate, &_scanner);
     if (_scanner == nullptr) {
         throw std::bad_alloc();
     }
     yyset_in(nullptr, _scanner);
+
+    // Scan a mapped source in place instead of reading it chunk by chunk (`YY_INPUT`)
+    size_t size;
+    if (char* base = _srcbuf.scanBuffer(size)) {
+        if (yy_scan_buffer(base, size, _scanner) == nullptr) {
+            yylex_destroy(_scanner);
+            throw std::runtime_error("invalid scan buffer");
+        }
+    }
 }
 
-Lexer::Lexer(std::istream& stream)
-    : Lexer(SourceBuffer(stream)) { }
+Lexer::Lexer(std::istream& stream, LexerBackend backend)
+    : Lexer(SourceBuffer(stream), backend) { }
 
 Lexer::~Lexer() {
     if (_scanner != nullptr) {
@@ -27,7 +41,7 @@ Lexer::~Lexer() {
 Token Lexer::lex() {
     yy::parser::semantic_type semanticType;
     yy::parser::location_type loc;
-    TokenType type = static_cast<TokenType>(yylex(&semanticType, &loc, _scanner));
+    TokenType type = static_cast<TokenType>(yylex(&semanticType, &loc, *this));
     const TokenValue& value = semanticType.as<TokenValue>();
     return Token{type, value.lexeme, value.start.line, value.start.column};
 }
@@ -44,10 +58,18 @@ std::vector<Token> Lexer::lexAll() {
     return tokens;
 }
 
-LexResult Lexer::lexAll(std::istream& stream) {
-    Lexer lexer(stream);
+LexResult Lexer::lexAll(std::istream& stream, LexerBackend backend) {
+    Lexer lexer(stream, backend);
     std::vector<Token> tokens = lexer.lexAll();
-    return LexResult{std::move(tokens), std::move(lexer._srcbuf), std::move(lexer._diagnostics)};
+    return LexResult{std::move(tokens), std::move(lexer._srcbuf), std::move(lexer._diagnostics),
+                     std::move(lexer._lstate.lexemes())};
 }
 
 } // Spark::FrontEnd
+
+int yylex(yy::parser::semantic_type* yylval, yy::parser::location_type* yylloc, Spark::FrontEnd::Lexer& lexer) {
+    if (lexer._backend == Spark::FrontEnd::LexerBackend::Direct) {
+        return lexer._direct.lex(*yylval, *yylloc);
+    }
+    return yylex(yylval, yylloc, lexer._scanner);
+}
@@ -2,6 +2,8 @@
 
 #include <vector>
 
+#include "lexer/direct_lexer.hpp"
+#include "lexer/lexeme_arena.hpp"
 #include "lexer/lexer_state.hpp"
 #include "lexer/lexer_utils.hpp"
 #include "lexer/token.hpp"
@@ -11,16 +13,48 @@
 #include "source_buffer.hpp"
 #include "utils/diagnostic.hpp"
 
+namespace Spark::FrontEnd {
+class Lexer;
+} // Spark::FrontEnd
+
+/**
+ * Lexes the next token with the backend of @p lexer, called by the parser.
+ * @param yylval Semantic value to emplace the `TokenValue` of the token into.
+ * @param yylloc Location of the token.
+ * @param lexer Lexer to use.
+ * @return Type of the token.
+ */
+int yylex(yy::parser::semantic_type* yylval, yy::parser::location_type* yylloc, Spark::FrontEnd::Lexer& lexer);
+
 namespace Spark::FrontEnd {
 
 struct LexResult {
+    /**
+     * Tokens, whose lexemes are views into `srcbuf` and `lexemes`.
+     */
     std::vector<Token> tokens;
     SourceBuffer srcbuf;
     Diagnostics diagnostics;
+    LexemeArena lexemes;
 
     LexResult() noexcept = default;
-    LexResult(std::vector<Token> tokens, SourceBuffer srcbuf, Diagnostics diagnostics) noexcept
-        : tokens(std::move(tokens)), srcbuf(std::move(srcbuf)), diagnostics(std::move(diagnostics)) { }
+    LexResult(std::vector<Token> tokens, SourceBuffer srcbuf, Diagnostics diagnostics, LexemeArena lexemes) noexcept
+        : tokens(std::move(tokens)), srcbuf(std::move(srcbuf)), diagnostics(std::move(diagnostics)),
+          lexemes(std::move(lexemes)) { }
+};
+
+/**
+ * Implementations of the lexer.
+ */
+enum class LexerBackend {
+    /**
+     * Scanner generated by Flex from `lexer.l`.
+     */
+    Flex,
+    /**
+     * Hand-written scanner meant to produce the same tokens (see `DirectLexer`).
+     */
+    Direct,
 };
 
 /**
@@ -31,15 +65,23 @@ private:
     yyscan_t _scanner;
     LexerState _lstate;
 
+    LexerBackend _backend;
+    DirectLexer _direct;
+
     SourceBuffer _srcbuf;
 
     Diagnostics _diagnostics{};
 
-private:
-    explicit Lexer(SourceBuffer srcbuf);
-
 public:
-    explicit Lexer(std::istream& stream);
+    /**
+     * Constructs a lexer over a source buffer.
+     * A source buffer backed by a file mapping (`SourceBuffer::fromFile`) is scanned in place.
+     * @param srcbuf Source buffer to lex.
+     * @param backend Implementation of the lexer to use.
+     */
+    explicit Lexer(SourceBuffer srcbuf, LexerBackend backend = LexerBackend::Flex);
+
+    explicit Lexer(std::istream& stream, LexerBackend backend = LexerBackend::Flex);
 
     ~Lexer();
 
@@ -62,6 +104,16 @@ public:
     [[nodiscard]]
     yyscan_t scanner() const noexcept { return _scanner; }
 
+    [[nodiscard]]
+    constexpr LexerBackend backend() const noexcept { return _backend; }
+
+    /**
+     * Retrieves the errors reported while lexing (unrecognized characters, unterminated literals...).
+     * @return Errors reported while lexing.
+     */
+    [[nodiscard]]
+    constexpr const std::vector<Error>& errors() const noexcept { return _lstate.errors(); }
+
     /**
      * Clears the lexer.
      */
@@ -84,11 +136,12 @@ public:
     /**
      * Lexes all tokens till the end of ths stream.
      * @param stream Input stream.
+     * @param backend Implementation of the lexer to use.
      * @return Lexing result.
      */
-    static LexResult lexAll(std::istream& stream);
+    static LexResult lexAll(std::istream& stream, LexerBackend backend = LexerBackend::Flex);
 
-    friend class Parser;
+    friend int ::yylex(yy::parser::semantic_type* yylval, yy::parser::location_type* yylloc, Lexer& lexer);
 };
 
 } // Spark::FrontEnd
@@ -0,0 +1,561 @@
+﻿#include "direct_lexer.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "lexer_utils.hpp"
+
+namespace Spark::FrontEnd {
+
+namespace {
+    enum CharClass : uint8_t {
+        Blank = 1 << 0,       // [ \t\r]
+        Decimal = 1 << 1,     // [0-9_]
+        WordChar = 1 << 2,    // [A-Za-z0-9_]
+        WordStart = 1 << 3,   // [A-Za-z_]
+    };
+
+    struct CharClassTable {
+        uint8_t classes[256] = {};
+
+        constexpr CharClassTable() {
+            classes[static_cast<uint8_t>(' ')] = Blank;
+            classes[static_cast<uint8_t>('\t')] = Blank;
+            classes[static_cast<uint8_t>('\r')] = Blank;
+            for (int c = '0'; c <= '9'; ++c) {
+                classes[c] = Decimal | WordChar;
+            }
+            for (int c = 'A'; c <= 'Z'; ++c) {
+                classes[c] = WordChar | WordStart;
+                classes[c + ('a' - 'A')] = WordChar | WordStart;
+            }
+            classes[static_cast<uint8_t>('_')] = Decimal | WordChar | WordStart;
+        }
+    };
+
+    constexpr CharClassTable charClasses;
+
+    inline bool is(char c, uint8_t charClass) noexcept {
+        return (charClasses.classes[static_cast<uint8_t>(c)] & charClass) != 0;
+    }
+
+#if defined(__SSE2__)
+    /**
+     * Sets the bytes of @p v in [@p lo, @p hi] (unsigned).
+     */
+    inline __m128i inRange(__m128i v, char lo, char hi) noexcept {
+        const __m128i ge = _mm_cmpeq_epi8(_mm_max_epu8(v, _mm_set1_epi8(lo)), v);
+        const __m128i le = _mm_cmpeq_epi8(_mm_min_epu8(v, _mm_set1_epi8(hi)), v);
+        return _mm_and_si128(ge, le);
+    }
+
+    inline __m128i classify(__m128i v, uint8_t charClass) noexcept {
+        switch (charClass) {
+            case Blank:
+                return _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+                                                 _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+                                    _mm_cmpeq_epi8(v, _mm_set1_epi8('\r')));
+            case Decimal:
+                return _mm_or_si128(inRange(v, '0', '9'), _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+            default: // WordChar
+                return _mm_or_si128(_mm_or_si128(inRange(v, '0', '9'), _mm_cmpeq_epi8(v, _mm_set1_epi8('_'))),
+                                    inRange(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 'z'));
+        }
+    }
+#endif
+
+    /**
+     * Gets the index of the first character from @p i on which is not in @p charClass.
+     */
+    size_t skip(std::string_view src, size_t i, uint8_t charClass) noexcept {
+#if defined(__SSE2__)
+        for (; i + 16 <= src.size(); i += 16) {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src.data() + i));
+            const auto mask = static_cast<uint32_t>(_mm_movemask_epi8(classify(v, charClass))) ^ 0xFFFF;
+            if (mask != 0) {
+                return i + static_cast<size_t>(__builtin_ctz(mask));
+            }
+        }
+#endif
+        while (i < src.size() && is(src[i], charClass)) {
+            ++i;
+        }
+        return i;
+    }
+
+    /**
+     * Gets the index of the first character from @p i on which is one of @p needles, or the size of @p src.
+     */
+    template <typename... Chars>
+    size_t find(std::string_view src, size_t i, Chars... needles) noexcept {
+#if defined(__SSE2__)
+        for (; i + 16 <= src.size(); i += 16) {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src.data() + i));
+            __m128i found = _mm_setzero_si128();
+            ((found = _mm_or_si128(found, _mm_cmpeq_epi8(v, _mm_set1_epi8(needles)))), ...);
+            const auto mask = static_cast<uint32_t>(_mm_movemask_epi8(found));
+            if (mask != 0) {
+                return i + static_cast<size_t>(__builtin_ctz(mask));
+            }
+        }
+#endif
+        for (; i < src.size(); ++i) {
+            const char e = src[i];
+            if (((e == needles) || ...)) {
+                return i;
+            }
+        }
+        return src.size();
+    }
+
+    /**
+     * Gets the index of the first character from @p i on which is not in @p digits, or the size of @p src.
+     */
+    size_t skipDigits(std::string_view src, size_t i, std::string_view digits) noexcept {
+        while (i < src.size() && (src[i] == '_' || digits.find(src[i]) != std::string_view::npos)) {
+            ++i;
+        }
+        return i;
+    }
+
+    void setLocation(yy::parser::location_type& yylloc, Location start, Location end) noexcept {
+        yylloc.begin.line = start.line;
+        yylloc.begin.column = start.column;
+        yylloc.end.line = end.line;
+        yylloc.end.column = end.column;
+    }
+
+    /**
+     * Length of the newline at @p i (`\r\n`, `\r` or `\n`).
+     */
+    inline size_t newlineLength(std::string_view src, size_t i) noexcept {
+        return src[i] == '\r' && i + 1 < src.size() && src[i + 1] == '\n' ? 2 : 1;
+    }
+}
+
+TokenType DirectLexer::lex(yy::parser::semantic_type& yylval, yy::parser::location_type& yylloc) {
+    LexerState& ls = *_lstatep;
+    const std::string_view src = ls.text();
+    size_t& i = ls.index;
+
+    while (i < src.size()) {
+        const char c = src[i];
+        switch (c) {
+            case '\n':
+                ++i;
+                ls.whenNewline();
+                break;
+
+            case '\r': {
+                // A CR starting a longer run of blanks is a blank (longest match), else a newline
+                const size_t end = src.size() > i + 1 && src[i + 1] == '\n' ? i : skip(src, i, Blank);
+                if (end - i <= 1) {
+                    i += newlineLength(src, i);
+                    ls.whenNewline();
+                } else {
+                    ls.column += end - i;
+                    i = end;
+                }
+                break;
+            }
+
+            case ' ':
+            case '\t': {
+                const size_t end = skip(src, i, Blank);
+                ls.column += end - i;
+                i = end;
+                break;
+            }
+
+            case '/':
+                if (i + 1 < src.size() && src[i + 1] == '/') {
+                    return lexLineComment(yylval, yylloc);
+                }
+                if (i + 1 < src.size() && src[i + 1] == '*') {
+                    return lexBlockComment(yylval, yylloc);
+                }
+                return lexOperator(yylval, yylloc);
+
+            case '"':
+            case '\'':
+                if (i + 2 < src.size() && src[i + 1] == c && src[i + 2] == c) {
+                    return lexLongString(yylval, yylloc);
+                }
+                return lexString(yylval, yylloc);
+
+            case '.':
+                return lexNumberOrWord(yylval, yylloc);
+
+            default:
+                if (is(c, WordChar)) {
+                    return lexNumberOrWord(yylval, yylloc);
+                }
+                return lexOperator(yylval, yylloc);
+        }
+    }
+
+    const Location loc(ls.line, ls.column);
+    yylval.emplace<TokenValue>(std::string_view(), loc, loc);
+    return TokenType::EndOfFile;
+}
+
+TokenType DirectLexer::lexNumberOrWord(yy::parser::semantic_type& yylval, yy::parser::location_type& yylloc) {
+    const std::string_view src = _lstatep->text();
+    const size_t i = _lstatep->index;
+    const char c = src[i];
+
+    // Longest match of the rules in the order of `lexer.l`, the earliest rule wins a tie
+    const size_t decimalEnd = skip(src, i, Decimal);
+    size_t length = 0;
+    TokenType type = TokenType::Error;
+
+    // [0-9_]*\.[0-9_]+
+    if (decimalEnd + 1 < src.size() && src[decimalEnd] == '.' && is(src[decimalEnd + 1], Decimal)) {
+        length = skip(src, decimalEnd + 1, Decimal) - i;
+        type = TokenType::Real;
+    }
+
+    if (c >= '0' && c <= '9') {
+        // [0-9][0-9_]*
+        if (decimalEnd - i > length) {
+            length = decimalEnd - i;
+            type = TokenType::Integer;
+        }
+
+        // 0[bB][01][01_]*, 0[oO][0-7][0-7_]*, 0[xX][0-9A-Fa-f][0-9A-Fa-f_]*
+        if (c == '0' && i + 2 < src.size()) {
+            std::string_view digits;
+            switch (src[i + 1]) {
+                case 'b': case 'B': digits = "01"; break;
+                case 'o': case 'O': digits = "01234567"; break;
+                case 'x': case 'X': digits = "0123456789ABCDEFabcdef"; break;
+                default: break;
+            }
+            if (!digits.empty() && digits.find(src[i + 2]) != std::string_view::npos) {
+                const size_t prefixedLength = skipDigits(src, i + 3, digits) - i;
+                if (prefixedLength > length) {
+                    length = prefixedLength;
+                    type = TokenType::Integer;
+                }
+            }
+        }
+    } else if (is(c, WordStart)) {
+        // [A-Za-z_][A-Za-z0-9_]*
+        const size_t wordLength = skip(src, i + 1, WordChar) - i;
+        if (wordLength > length) {
+            length = wordLength;
+            type = classifyWord(src.substr(i, length));
+        }
+    }
+
+    if (length == 0) {
+        // A dot not starting a real
+        return lexOperator(yylval, yylloc);
+    }
+    return emit(yylval, yylloc, type, length);
+}
+
+TokenType DirectLexer::lexOperator(yy::parser::semantic_type& yylval, yy::parser::location_type& yylloc) {
+    LexerState& ls = *_lstatep;
+    const std::string_view src = ls.text();
+    const size_t i = ls.index;
+    const char next = i + 1 < src.size() ? src[i + 1] : '\0';
+    const char nextNext = i + 2 < src.size() ? src[i + 2] : '\0';
+
+    switch (src[i]) {
+        case '+':
+            return next == '=' ? emit(yylval, yylloc, TokenType::AddAssign, 2) : emit(yylval, yylloc, TokenType::Add, 1);
+        case '-':
+            if (next == '>') {
+                return emit(yylval, yylloc, TokenType::Arrow, 2);
+            }
+            return next == '=' ? emit(yylval, yylloc, TokenType::SubAssign, 2) : emit(yylval, yylloc, TokenType::Sub, 1);
+        case '*':
+            return next == '=' ? emit(yylval, yylloc, TokenType::MulAssign, 2) : emit(yylval, yylloc, TokenType::Mul, 1);
+        case '/':
+            return next == '=' ? emit(yylval, yylloc, TokenType::DivAssign, 2) : emit(yylval, yylloc, TokenType::Div, 1);
+        case '%':
+            return next == '=' ? emit(yylval, yylloc, TokenType::ModAssign, 2) : emit(yylval, yylloc, TokenType::Mod, 1);
+        case '~':
+            return emit(yylval, yylloc, TokenType::Tide, 1);
+        case '&':
+            if (next == '&') {
+                return emit(yylval, yylloc, TokenType::LogAnd, 2);
+            }
+            return next == '=' ? emit(yylval, yylloc, TokenType::BitAndAssign, 2)
+                               : emit(yylval, yylloc, TokenType::And, 1);
+        case '|':
+            switch (next) {
+                case '|': return emit(yylval, yylloc, TokenType::LogOr, 2);
+                case '=': return emit(yylval, yylloc, TokenType::BitOrAssign, 2);
+                case '>': return emit(yylval, yylloc, TokenType::Pipe, 2);
+                default: return emit(yylval, yylloc, TokenType::VBar, 1);
+            }
+        case '^':
+            return next == '=' ? emit(yylval, yylloc, TokenType::BitXorAssign, 2)
+                               : emit(yylval, yylloc, TokenType::Caret, 1);
+        case '<':
+            return next == '=' ? emit(yylval, yylloc, TokenType::Le, 2) : emit(yylval, yylloc, TokenType::Lt, 1);
+        case '>':
+            return next == '=' ? emit(yylval, yylloc, TokenType::Ge, 2) : emit(yylval, yylloc, TokenType::Gt, 1);
+        case '!':
+            if (next == '=') {
+                return nextNext == '=' ? emit(yylval, yylloc, TokenType::StrictNe, 3)
+                                       : emit(yylval, yylloc, TokenType::Ne, 2);
+            }
+            return emit(yylval, yylloc, TokenType::Bang, 1);
+        case '=':
+            switch (next) {
+                case '=':
+                    return nextNext == '=' ? emit(yylval, yylloc, TokenType::StrictEq, 3)
+                                           : emit(yylval, yylloc, TokenType::Eq, 2);
+                case '>': return emit(yylval, yylloc, TokenType::FatArrow, 2);
+                default: return emit(yylval, yylloc, TokenType::Assign, 1);
+            }
+        case '.':
+            if (next == '.' && nextNext == '<') {
+                return emit(yylval, yylloc, TokenType::RangeExcl, 3);
+            }
+            if (next == '.' && nextNext == '.') {
+                return emit(yylval, yylloc, TokenType::Range, 3);
+            }
+            return emit(yylval, yylloc, TokenType::Dot, 1);
+        case '?':
+            switch (next) {
+                case '?':
+                    return nextNext == '=' ? emit(yylval, yylloc, TokenType::CoalesceAssign, 3)
+                                           : emit(yylval, yylloc, TokenType::Coalesce, 2);
+                case '!': return emit(yylval, yylloc, TokenType::NonNull, 2);
+                default: return emit(yylval, yylloc, TokenType::Question, 1);
+            }
+        case ',': return emit(yylval, yylloc, TokenType::Comma, 1);
+        case ':': return emit(yylval, yylloc, TokenType::Colon, 1);
+        case ';': return emit(yylval, yylloc, TokenType::Semicolon, 1);
+        case '(': return emit(yylval, yylloc, TokenType::LParen, 1);
+        case ')': return emit(yylval, yylloc, TokenType::RParen, 1);
+        case '[': return emit(yylval, yylloc, TokenType::LBracket, 1);
+        case ']': return emit(yylval, yylloc, TokenType::RBracket, 1);
+        case '{': return emit(yylval, yylloc, TokenType::LBrace, 1);
+        case '}': return emit(yylval, yylloc, TokenType::RBrace, 1);
+        case '@': return emit(yylval, yylloc, TokenType::At, 1);
+        case '$': return emit(yylval, yylloc, TokenType::Dollar, 1);
+        default:
+            break;
+    }
+
+    // Unrecognized character (yylloc is left untouched)
+    const Location loc(ls.line, ls.column);
+    std::ostringstream oss;
+    oss << "unrecognized character: " << "'" << src[i] << "'";
+    ls.addError(oss.str(), loc, loc);
+    yylval.emplace<TokenValue>(src.substr(i, 1), loc, loc);
+    ++ls.column;
+    ++ls.index;
+    return TokenType::Error;
+}
+
+TokenType DirectLexer::lexLineComment(yy::parser::semantic_type& yylval, yy::parser::location_type& yylloc) {
+    LexerState& ls = *_lstatep;
+    const std::string_view src = ls.text();
+    const size_t i = ls.index;
+    const auto end = static_cast<const char*>(std::memchr(src.data() + i, '\n', src.size() - i));
+    const size_t length = (end != nullptr ? static_cast<size_t>(end - src.data()) : src.size()) - i;
+
+    const Location start(ls.line, ls.column);
+    const Location endLoc(ls.line, ls.column + length);
+    setLocation(yylloc, start, endLoc);
+    yylval.emplace<TokenValue>(src.substr(i + 2, length - 2), start, endLoc);
+    ls.column += length;
+    ls.index += length;
+    return TokenType::LineComment;
+}
+
+TokenType DirectLexer::lexBlockComment(yy::parser::semantic_type& yylval, yy::parser::location_type& yylloc) {
+    LexerState& ls = *_lstatep;
+    const std::string_view src = ls.text();
+    size_t& i = ls.index;
+
+    const Location start(ls.line, ls.column);
+    ls.tokbuf().reset(ls.line, ls.column);
+    ls.column += 2;
+    i += 2;
+    ls.tokenIndex = i;
+
+    // Comments never contain escape sequences, their lexeme is always the source
+    while (i < src.size()) {
+        switch (src[i]) {
+            case '*':
+                if (i + 1 < src.size() && src[i + 1] == '/') {
+                    const Location end(ls.line, ls.column);
+                    setLocation(yylloc, start, end);
+                    yylval.emplace<TokenValue>(ls.source(ls.tokenIndex, i), start, end);
+                    ls.column += 2;
+                    i += 2;
+                    return TokenType::BlockComment;
+                }
+                ++ls.column;
+                ++i;
+                break;
+            case '\r':
+            case '\n':
+                i += newlineLength(src, i);
+                ls.whenNewline();
+                break;
+            default: {
+                const size_t end = find(src, i, '*', '\r', '\n');
+                ls.column += end - i;
+                i = end;
+                break;
+            }
+        }
+    }
+
+    const Location end(ls.line, ls.column - 1);
+    ls.addError("unterminated block comment", end, end);
+    setLocation(yylloc, start, end);
+    yylval.emplace<TokenValue>(ls.source(ls.tokenIndex, i), start, end);
+    return TokenType::BlockComment;
+}
+
+TokenType DirectLexer::lexString(yy::parser::semantic_type& yylval, yy::parser::location_type& yylloc) {
+    LexerState& ls = *_lstatep;
+    const std::string_view src = ls.text();
+    size_t& i = ls.index;
+    TokenBuffer& buffer = ls.tokbuf();
+
+    const Location start(ls.line, ls.column);
+    const char delim = src[i];
+    buffer.reset(ls.line, ls.column);
+    ++ls.column;
+    ++i;
+    ls.tokenIndex = i;
+
+    // The buffer is only filled once an escape sequence makes the lexeme differ from the source
+    bool escaped = false;
+    auto lexeme = [&](size_t end) {
+        return escaped ? ls.lexemes().store(buffer.view()) : ls.source(ls.tokenIndex, end);
+    };
+
+    while (i < src.size()) {
+        const char c = src[i];
+        if (c == delim) {
+            ++ls.column;
+            ++i;
+            const Location end(ls.line, ls.column);
+            setLocation(yylloc, start, end);
+            yylval.emplace<TokenValue>(lexeme(i - 1), start, end);
+            return TokenType::String;
+        }
+
+        if (c == '\r' || c == '\n') {
+            const Location end(ls.line, ls.column - 1);
+            ls.addError("unterminated string literal", start, end);
+            setLocation(yylloc, start, end);
+            const std::string_view value = lexeme(i);
+            i += newlineLength(src, i);
+            ls.whenNewline();
+            yylval.emplace<TokenValue>(value, start, end);
+            return TokenType::String;
+        }
+
+        if (c == '\\' && i + 1 < src.size() && src[i + 1] != '\n') {
+            if (!escaped) {
+                buffer.append(ls.source(ls.tokenIndex, i));
+                escaped = true;
+            }
+            const char e = src[i + 1];
+            switch (e) {
+                case 'n': buffer.append('\n'); break;
+                case 't': buffer.append('\t'); break;
+                case 'r': buffer.append('\r'); break;
+                case '\\': case '"': case '\'': buffer.append(e); break;
+                default: {
+                    buffer.append(e);
+                    std::ostringstream oss;
+                    oss << "unrecognized escape sequence: " << "'" << src.substr(i, 2) << "'";
+                    ls.addError(oss.str(), Location(ls.line, ls.column - 1), Location(ls.line, ls.column));
+                    break;
+                }
+            }
+            ls.column += 2;
+            i += 2;
+            continue;
+        }
+
+        // Run of plain characters (a backslash before a newline or the end of file is one)
+        const size_t end = c == '\\' ? i + 1 : find(src, i, delim, '\\', '\r', '\n');
+        if (escaped) {
+            buffer.append(src.substr(i, end - i));
+        }
+        ls.column += end - i;
+        i = end;
+    }
+
+    const Location end(ls.line, ls.column - 1);
+    ls.addError("unterminated string literal", start, end);
+    setLocation(yylloc, start, end);
+    yylval.emplace<TokenValue>(lexeme(i), start, end);
+    return TokenType::String;
+}
+
+TokenType DirectLexer::lexLongString(yy::parser::semantic_type& yylval, yy::parser::location_type& yylloc) {
+    LexerState& ls = *_lstatep;
+    const std::string_view src = ls.text();
+    size_t& i = ls.index;
+
+    const Location start(ls.line, ls.column);
+    const char delim = src[i];
+    ls.tokbuf().reset(ls.line, ls.column);
+    ls.column += 3;
+    i += 3;
+    ls.tokenIndex = i;
+
+    // Long strings have no escape sequences, their lexeme is always the source
+    while (i < src.size()) {
+        const char c = src[i];
+        if (c == '\r' || c == '\n') {
+            i += newlineLength(src, i);
+            ls.whenNewline();
+        } else if (c == '"' || c == '\'') {
+            if (c == delim && i + 2 < src.size() && src[i + 1] == delim && src[i + 2] == delim) {
+                ls.column += 3;
+                i += 3;
+                const Location end(ls.line, ls.column);
+                setLocation(yylloc, start, end);
+                yylval.emplace<TokenValue>(ls.source(ls.tokenIndex, i - 3), start, end);
+                return TokenType::String;
+            }
+            ++ls.column;
+            ++i;
+        } else {
+            const size_t end = find(src, i, '"', '\'', '\r', '\n');
+            ls.column += end - i;
+            i = end;
+        }
+    }
+
+    const Location end(ls.line, ls.column - 1);
+    ls.addError("unterminated string literal", start, end);
+    setLocation(yylloc, start, end);
+    yylval.emplace<TokenValue>(ls.source(ls.tokenIndex, i), start, end);
+    return TokenType::String;
+}
+
+TokenType DirectLexer::emit(yy::parser::semantic_type& yylval, yy::parser::location_type& yylloc,
+                            TokenType type, size_t length) {
+    LexerState& ls = *_lstatep;
+    const Location start(ls.line, ls.column);
+    const Location end(ls.line, ls.column + length);
+    setLocation(yylloc, start, end);
+    yylval.emplace<TokenValue>(ls.source(ls.index, ls.index + length), start, end);
+    ls.column += length;
+    ls.index += length;
+    return type;
+}
+
+} // Spark::FrontEnd
@@ -0,0 +1,47 @@
+﻿#pragma once
+
+#include <string_view>
+
+#include "lexer_state.hpp"
+#include "token_type.hpp"
+#include "token_value.hpp"
+
+namespace Spark::FrontEnd {
+
+/**
+ * Represents a hand-written lexer meant to produce the same tokens, locations and errors as the Flex scanner generated
+ * from `lexer.l` (`DirectLexerTest` compares both backends). The rules of `lexer.l` are coded directly as a switch over
+ * the first character of each token, and runs of blanks, identifier characters, digits and comment or string bodies are
+ * skipped 16 bytes at a time.
+ */
+class DirectLexer {
+private:
+    LexerState* _lstatep;
+
+public:
+    explicit DirectLexer(LexerState& lstate) noexcept : _lstatep(&lstate) { }
+
+    /**
+     * Lexes the next token, the same way as `yylex`.
+     * @param yylval Semantic value to emplace the `TokenValue` of the token into.
+     * @param yylloc Location of the token (left untouched for errors and the end of file, as by `yylex`).
+     * @return Type of the token.
+     */
+    TokenType lex(yy::parser::semantic_type& yylval, yy::parser::location_type& yylloc);
+
+private:
+    TokenType lexNumberOrWord(yy::parser::semantic_type& yylval, yy::parser::location_type& yylloc);
+    TokenType lexOperator(yy::parser::semantic_type& yylval, yy::parser::location_type& yylloc);
+    TokenType lexLineComment(yy::parser::semantic_type& yylval, yy::parser::location_type& yylloc);
+    TokenType lexBlockComment(yy::parser::semantic_type& yylval, yy::parser::location_type& yylloc);
+    TokenType lexString(yy::parser::semantic_type& yylval, yy::parser::location_type& yylloc);
+    TokenType lexLongString(yy::parser::semantic_type& yylval, yy::parser::location_type& yylloc);
+
+    /**
+     * Emits a single-line token of @p length characters at the current location and moves past it.
+     */
+    TokenType emit(yy::parser::semantic_type& yylval, yy::parser::location_type& yylloc,
+                   TokenType type, size_t length);
+};
+
+} // Spark::FrontEnd
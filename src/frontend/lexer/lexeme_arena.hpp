@@ -0,0 +1,85 @@
+﻿#pragma once
+
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace Spark::FrontEnd {
+
+/**
+ * Represents an arena storing the lexemes that are not a substring of the source (string literals with escape
+ * sequences). Stored lexemes keep their address until the arena is cleared or destroyed, also when it is moved.
+ */
+class LexemeArena {
+private:
+    static constexpr size_t ChunkSize = 4096;
+
+    /**
+     * Chunks of storage, the last one is the one being filled.
+     */
+    std::vector<std::unique_ptr<char[]>> _chunks;
+
+    /**
+     * Number of bytes used in the last chunk.
+     */
+    size_t _used = ChunkSize;
+
+public:
+    LexemeArena() = default;
+
+    LexemeArena(const LexemeArena& other) = delete;
+    LexemeArena& operator=(const LexemeArena& other) = delete;
+
+    LexemeArena(LexemeArena&& other) noexcept : _chunks(std::move(other._chunks)), _used(other._used) {
+        other.clear();
+    }
+
+    LexemeArena& operator=(LexemeArena&& other) noexcept {
+        _chunks = std::move(other._chunks);
+        _used = other._used;
+        other.clear();
+        return *this;
+    }
+
+    /**
+     * Copies a lexeme into the arena.
+     * @param sv Lexeme to copy.
+     * @return View of the copy.
+     */
+    std::string_view store(std::string_view sv) {
+        if (sv.empty()) {
+            return {};
+        }
+
+        char* p;
+        if (sv.size() > ChunkSize / 4) {
+            // Large lexemes get a chunk of their own, before the one being filled
+            auto chunk = std::make_unique<char[]>(sv.size());
+            p = chunk.get();
+            _chunks.insert(_chunks.empty() ? _chunks.end() : _chunks.end() - 1, std::move(chunk));
+            if (_chunks.size() == 1) {
+                _used = ChunkSize;
+            }
+        } else {
+            if (ChunkSize - _used < sv.size()) {
+                _chunks.push_back(std::make_unique<char[]>(ChunkSize));
+                _used = 0;
+            }
+            p = _chunks.back().get() + _used;
+            _used += sv.size();
+        }
+        std::memcpy(p, sv.data(), sv.size());
+        return { p, sv.size() };
+    }
+
+    /**
+     * Frees every stored lexeme.
+     */
+    void clear() noexcept {
+        _chunks.clear();
+        _used = ChunkSize;
+    }
+};
+
+} // Spark::FrontEnd
@@ -5,6 +5,7 @@
 
 #include "frontend/source_buffer.hpp"
 #include "frontend/source_reader.hpp"
+#include "lexeme_arena.hpp"
 #include "token_buffer.hpp"
 #include "utils/error.hpp"
 
@@ -19,6 +20,7 @@ private:
     SourceReader _srcreader;
 
     TokenBuffer _tokbuf;
+    LexemeArena _lexemes;
 
     std::vector<Error> _errors;
 
@@ -26,11 +28,24 @@ public:
     size_t line;
     size_t column;
 
+    /**
+     * Index in the source past the text matched so far.
+     */
+    size_t index = 0;
+
+    /**
+     * Index in the source where the content of the token in the token buffer starts.
+     */
+    size_t tokenIndex = 0;
+
     char strDelim = '\0';
 
     [[nodiscard]]
     constexpr TokenBuffer& tokbuf() noexcept { return _tokbuf; }
 
+    [[nodiscard]]
+    constexpr LexemeArena& lexemes() noexcept { return _lexemes; }
+
     [[nodiscard]]
     constexpr const std::vector<Error>& errors() const noexcept { return _errors; }
 
@@ -61,6 +76,42 @@ public:
         return _srcreader.readChunk(buf, maxSize);
     }
 
+    /**
+     * Gets the whole source.
+     * @return Source text.
+     */
+    [[nodiscard]]
+    std::string_view text() const noexcept {
+        return _srcbufp->text();
+    }
+
+    /**
+     * Gets a view of the source, as lexemes are views into the source buffer instead of into the Flex buffer.
+     * @param begin Index in the source where the view starts.
+     * @param end Index in the source where the view ends (exclusive).
+     * @return View of the source.
+     */
+    [[nodiscard]]
+    std::string_view source(size_t begin, size_t end) const noexcept {
+        return _srcbufp->text().substr(begin, end - begin);
+    }
+
+    /**
+     * Gets the lexeme of the token in the token buffer, which is a view of the source from `tokenIndex` to @p end
+     * unless escape sequences made the buffer differ from the source (then a copy in the lexeme arena).
+     * @param end Index in the source where the content of the token ends (exclusive).
+     * @return Lexeme of the token.
+     */
+    std::string_view bufferedLexeme(size_t end) {
+        std::string_view src = source(tokenIndex, end);
+        std::string_view buffered = _tokbuf.view();
+        // Escape sequences are always shorter than the text they stand for
+        if (src.size() == buffered.size()) {
+            return src;
+        }
+        return _lexemes.store(buffered);
+    }
+
     /**
       * Adds a new error to the state.
       * @param error `Error` instance to add.
@@ -1,5 +1,6 @@
 #include "lexer_utils.hpp"
 
+#include <algorithm>
 #include <unordered_map>
 
 namespace Spark::FrontEnd {
@@ -29,11 +30,18 @@ namespace {
         { "undefine", TokenType::Undefine },
         { "while", TokenType::While },
     };
+
+    const size_t maxKeywordLength = std::max_element(
+        keywordTokenMap.begin(), keywordTokenMap.end(),
+        [](const auto& a, const auto& b) { return a.first.size() < b.first.size(); })->first.size();
 }
 
 TokenType classifyWord(std::string_view word) noexcept {
-    if (keywordTokenMap.find(word) != keywordTokenMap.end()) {
-        return keywordTokenMap.at(word);
+    // Keywords are lowercase and short, most identifiers don't need to be hashed
+    if (!word.empty() && word.size() <= maxKeywordLength && word[0] >= 'a' && word[0] <= 'z') {
+        if (auto it = keywordTokenMap.find(word); it != keywordTokenMap.end()) {
+            return it->second;
+        }
     }
     return word == "_" ? TokenType::Discard : TokenType::Identifier;
 }
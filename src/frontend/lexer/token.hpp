@@ -1,5 +1,8 @@
 ﻿#pragma once
 
+#include <ostream>
+#include <string_view>
+
 #include "token_type.hpp"
 
 namespace Spark::FrontEnd {
@@ -9,17 +12,21 @@ namespace Spark::FrontEnd {
  */
 struct Token {
     TokenType type;
-    std::string lexeme;
+
+    /**
+     * View into the source buffer or the lexeme arena of the lexer, valid as long as the lexer (or its `LexResult`).
+     */
+    std::string_view lexeme;
     Location start;
     Location end;
 
-    Token(TokenType type, std::string lexeme, Location start, Location end) noexcept
-        : type(type), lexeme(std::move(lexeme)), start(start), end(end) { }
+    Token(TokenType type, std::string_view lexeme, Location start, Location end) noexcept
+        : type(type), lexeme(lexeme), start(start), end(end) { }
     Token() noexcept : Token(TokenType::EndOfFile, "", {0, 0}, {0, 0}) { }
 
     // TODO: Delete this constructor
-    Token(TokenType type, std::string lexeme, size_t line, size_t column) noexcept
-        : Token(type, std::move(lexeme), Location(line, column), Location(line, column)) { }
+    Token(TokenType type, std::string_view lexeme, size_t line, size_t column) noexcept
+        : Token(type, lexeme, Location(line, column), Location(line, column)) { }
 
     bool operator==(const Token& rhs) const noexcept {
         return type == rhs.type && lexeme == rhs.lexeme /* TODO: && start == rhs.start && end == rhs.end */;
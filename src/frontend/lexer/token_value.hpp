@@ -1,20 +1,23 @@
 ﻿#pragma once
 
 #include <cstddef>
-#include <string>
+#include <string_view>
 
 #include "utils/location.hpp"
 
 namespace Spark::FrontEnd {
 
 struct TokenValue {
-    std::string lexeme;
+    /**
+     * View into the source buffer or the lexeme arena of the lexer, valid as long as the lexer (or its `LexResult`).
+     */
+    std::string_view lexeme;
     Location start;
     Location end;
 
     TokenValue() = default;
-    TokenValue(std::string lexeme, Location start, Location end) noexcept
-        : lexeme(std::move(lexeme)), start(start), end(end) { }
+    TokenValue(std::string_view lexeme, Location start, Location end) noexcept
+        : lexeme(lexeme), start(start), end(end) { }
 
     TokenValue(const TokenValue& other) = default;
     TokenValue& operator=(const TokenValue& other) = default;
@@ -0,0 +1,117 @@
+﻿#include "line_index.hpp"
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define SPARK_LINE_SCANNER_X86
+#include <immintrin.h>
+#endif
+
+namespace Spark::FrontEnd {
+
+namespace {
+    /**
+     * Appends the line start following the newline character at @p i, if any (the LF of a CRLF ends the line).
+     */
+    inline void appendLineStart(std::string_view src, size_t i, std::vector<uint32_t>& starts) {
+        if (src[i] == '\n' || i + 1 == src.size() || src[i + 1] != '\n') {
+            starts.push_back(static_cast<uint32_t>(i + 1));
+        }
+    }
+
+    void scanScalar(std::string_view src, size_t i, std::vector<uint32_t>& starts) {
+        for (; i < src.size(); ++i) {
+            if (src[i] == '\n' || src[i] == '\r') {
+                appendLineStart(src, i, starts);
+            }
+        }
+    }
+
+    /**
+     * Appends the line starts of the newline characters whose bits are set in @p mask, bit 0 being @p base.
+     */
+    template <typename Mask>
+    inline void appendMaskedLineStarts(std::string_view src, size_t base, Mask mask, std::vector<uint32_t>& starts) {
+        while (mask != 0) {
+            appendLineStart(src, base + static_cast<size_t>(__builtin_ctzll(mask)), starts);
+            mask &= mask - 1;
+        }
+    }
+
+#ifdef SPARK_LINE_SCANNER_X86
+    __attribute__((target("sse2")))
+    void scanSSE2(std::string_view src, size_t i, std::vector<uint32_t>& starts) {
+        const __m128i lf = _mm_set1_epi8('\n');
+        const __m128i cr = _mm_set1_epi8('\r');
+        const char* data = src.data();
+        for (; i + 16 <= src.size(); i += 16) {
+            const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            const __m128i newline = _mm_or_si128(_mm_cmpeq_epi8(chunk, lf), _mm_cmpeq_epi8(chunk, cr));
+            appendMaskedLineStarts(src, i, static_cast<uint32_t>(_mm_movemask_epi8(newline)), starts);
+        }
+        scanScalar(src, i, starts);
+    }
+
+    __attribute__((target("avx2")))
+    void scanAVX2(std::string_view src, size_t i, std::vector<uint32_t>& starts) {
+        const __m256i lf = _mm256_set1_epi8('\n');
+        const __m256i cr = _mm256_set1_epi8('\r');
+        const char* data = src.data();
+        // 64 bytes per iteration, most of which have no newline at all
+        for (; i + 64 <= src.size(); i += 64) {
+            const __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+            const __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 32));
+            const __m256i lowNewline = _mm256_or_si256(_mm256_cmpeq_epi8(low, lf), _mm256_cmpeq_epi8(low, cr));
+            const __m256i highNewline = _mm256_or_si256(_mm256_cmpeq_epi8(high, lf), _mm256_cmpeq_epi8(high, cr));
+            const uint64_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(lowNewline)) |
+                                  static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(highNewline))) << 32;
+            appendMaskedLineStarts(src, i, mask, starts);
+        }
+        scanScalar(src, i, starts);
+    }
+#endif
+}
+
+bool isLineScannerSupported(LineScanner scanner) noexcept {
+    switch (scanner) {
+        case LineScanner::Scalar:
+            return true;
+#ifdef SPARK_LINE_SCANNER_X86
+        case LineScanner::SSE2:
+            return __builtin_cpu_supports("sse2");
+        case LineScanner::AVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+LineScanner bestLineScanner() noexcept {
+    static const LineScanner best = [] {
+        if (isLineScannerSupported(LineScanner::AVX2)) {
+            return LineScanner::AVX2;
+        }
+        if (isLineScannerSupported(LineScanner::SSE2)) {
+            return LineScanner::SSE2;
+        }
+        return LineScanner::Scalar;
+    }();
+    return best;
+}
+
+void appendLineStarts(std::string_view src, size_t beginIndex, std::vector<uint32_t>& starts, LineScanner scanner) {
+    switch (scanner) {
+#ifdef SPARK_LINE_SCANNER_X86
+        case LineScanner::SSE2:
+            scanSSE2(src, beginIndex, starts);
+            return;
+        case LineScanner::AVX2:
+            scanAVX2(src, beginIndex, starts);
+            return;
+#endif
+        default:
+            scanScalar(src, beginIndex, starts);
+            return;
+    }
+}
+
+} // Spark::FrontEnd
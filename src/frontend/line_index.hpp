@@ -0,0 +1,51 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace Spark::FrontEnd {
+
+/**
+ * Implementations of `appendLineStarts`.
+ */
+enum class LineScanner {
+    Scalar,
+    SSE2,
+    AVX2,
+};
+
+/**
+ * Checks whether @p scanner can run on this CPU.
+ * @param scanner Scanner to check.
+ * @return true if supported, false otherwise.
+ */
+bool isLineScannerSupported(LineScanner scanner) noexcept;
+
+/**
+ * Gets the fastest scanner supported by this CPU.
+ * @return Fastest supported scanner.
+ */
+LineScanner bestLineScanner() noexcept;
+
+/**
+ * Appends the index of the start of every line that begins in @p src after @p beginIndex, that is the index right
+ * after each LF, CRLF or lone CR found from @p beginIndex on. A CR at the end of @p src counts as a lone CR.
+ * @param src Source to scan, whose size must fit in 32 bits.
+ * @param beginIndex Index in @p src to scan from.
+ * @param starts Vector to append the line starts to.
+ * @param scanner Scanner to use, which must be supported (see `isLineScannerSupported`).
+ */
+void appendLineStarts(std::string_view src, size_t beginIndex, std::vector<uint32_t>& starts, LineScanner scanner);
+
+/**
+ * Appends the line starts of @p src with the fastest scanner supported by this CPU (see the overload above).
+ * @param src Source to scan, whose size must fit in 32 bits.
+ * @param beginIndex Index in @p src to scan from.
+ * @param starts Vector to append the line starts to.
+ */
+inline void appendLineStarts(std::string_view src, size_t beginIndex, std::vector<uint32_t>& starts) {
+    appendLineStarts(src, beginIndex, starts, bestLineScanner());
+}
+
+} // Spark::FrontEnd
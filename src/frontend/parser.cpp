@@ -10,7 +10,7 @@ ParseResult Parser::parse(std::istream& stream) {
     yy::parser::location_type loc;
     AST ast;
     Diagnostics diagnostics;
-    yy::parser parser(lexer._scanner, &loc, ast, diagnostics);
+    yy::parser parser(lexer, &loc, ast, diagnostics);
 
     // Parse
     int result = parser.parse();
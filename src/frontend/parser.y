@@ -10,8 +10,8 @@
 
 %locations
 
-%lex-param {yyscan_t scanner}
-%parse-param {yyscan_t scanner} {yy::parser::location_type* yylloc} {AST& ast} {Diagnostics& diagnostics}
+%lex-param {Spark::FrontEnd::Lexer& lexer}
+%parse-param {Spark::FrontEnd::Lexer& lexer} {yy::parser::location_type* yylloc} {AST& ast} {Diagnostics& diagnostics}
 
 %code requires {
 #include <cstdint>
@@ -23,6 +23,10 @@
 
 typedef void* yyscan_t;
 
+namespace Spark::FrontEnd {
+    class Lexer;
+} // Spark::FrontEnd
+
 namespace yy {
     using namespace Spark;
     using namespace FrontEnd;
@@ -41,7 +45,7 @@ namespace yy {
 }
 
 %code {
-int yylex(yy::parser::semantic_type*, yy::parser::location_type*, yyscan_t);
+#include "frontend/lexer.hpp"
 
 #define RAISE_ERROR(start, end, msg) diagnostics.add(Diagnostic::error(start, end, msg))
 #define REMOVE_LAST_ERROR()
@@ -874,7 +878,7 @@ literal:
     | Real           { $$ = Spanned<Literal>($1.start, $1.end, RealLiteral(BigReal($1.lexeme))); }
     | True           { $$ = Spanned<Literal>($1.start, $1.end, BoolLiteral(true)); }
     | False          { $$ = Spanned<Literal>($1.start, $1.end, BoolLiteral(false)); }
-    | String         { $$ = Spanned<Literal>($1.start, $1.end, StringLiteral(std::move($1.lexeme))); }
+    | String         { $$ = Spanned<Literal>($1.start, $1.end, StringLiteral(std::string($1.lexeme))); }
     | Nil            { $$ = Spanned<Literal>($1.start, $1.end, NilLiteral()); }
     | LParen RParen  { $$ = Spanned<Literal>($1.start, $2.end, VoidLiteral()); }
     ;
@@ -882,7 +886,7 @@ literal:
 name:
       Identifier
         {
-            $$ = ast.make<Name>($1.start, $1.end, ast.intern(NameValue::identifier(std::move($1.lexeme))));
+            $$ = ast.make<Name>($1.start, $1.end, ast.internIdentifier($1.lexeme));
         }
     | Discard      { $$ = ast.make<Name>($1.start, $1.end, ast.intern(NameValue::discard())); }
     | Self         { $$ = ast.make<Name>($1.start, $1.end, ast.intern(NameValue::self())); }
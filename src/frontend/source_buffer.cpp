@@ -1,6 +1,17 @@
 ﻿#include "source_buffer.hpp"
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <fstream>
 #include <stdexcept>
+#include <system_error>
+
+#include "line_index.hpp"
 
 namespace Spark::FrontEnd {
 
@@ -10,7 +21,7 @@ bool SourceBuffer::tryGet(Location start, Location end, std::string_view& out) c
     if (!s || !e || *e < *s) {
         return false;
     }
-    out = std::string_view(_src.data() + *s, (*e - *s) + 1);
+    out = text().substr(*s, (*e - *s) + 1);
     return true;
 }
 
@@ -22,9 +33,102 @@ std::string_view SourceBuffer::get(Location start, Location end) const {
     throw std::out_of_range("invalid source range");
 }
 
+std::string_view SourceBuffer::getLine(size_t lineno) const {
+    if (lineno == 0 || lineno > lineNum()) {
+        throw std::out_of_range("invalid line number");
+    }
+    const std::string_view src = text();
+    const size_t begin = _lineStarts[lineno - 1];
+    if (lineno == lineNum()) {
+        return src.substr(begin);
+    }
+
+    // Strip the newline (a CR right before the LF belongs to the newline, lines never contain CRs)
+    size_t end = _lineStarts[lineno] - 1;
+    if (src[end] == '\n' && end > begin && src[end - 1] == '\r') {
+        --end;
+    }
+    return src.substr(begin, end - begin);
+}
+
+SourceBuffer SourceBuffer::fromFile(const std::string& path) {
+    constexpr std::string_view bom = "\xEF\xBB\xBF";
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        throw std::system_error(errno, std::generic_category(), "cannot open file: " + path);
+    }
+    struct stat st{};
+    if (fstat(fd, &st) == -1) {
+        int error = errno;
+        close(fd);
+        throw std::system_error(error, std::generic_category(), "cannot stat file: " + path);
+    }
+
+    // Pipes and the like can't be mapped, read them instead
+    if (!S_ISREG(st.st_mode)) {
+        close(fd);
+        std::ifstream stream(path, std::ios::binary);
+        SourceBuffer srcbuf(stream);
+
+        // Skip the BOM (the stream may not seek back, so it's removed once read)
+        if (srcbuf._src->compare(0, bom.size(), bom) == 0) {
+            srcbuf._src->erase(0, bom.size());
+            srcbuf._lineStarts.clear();
+            srcbuf.identifyLines(0);
+        }
+        return srcbuf;
+    }
+
+    // Reserve room for the file followed by 2 zero bytes (Flex's end of buffer sentinels), then map the file over it.
+    // The mapping is private and writable because Flex null-terminates each token in place, the file is never written.
+    const auto size = static_cast<size_t>(st.st_size);
+    const auto pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const size_t fileLength = (size + pageSize - 1) / pageSize * pageSize;
+    const size_t length = (size + 2 + pageSize - 1) / pageSize * pageSize;
+    void* base = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED ||
+        (size > 0 && mmap(base, fileLength, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED)) {
+        int error = errno;
+        if (base != MAP_FAILED) {
+            munmap(base, length);
+        }
+        close(fd);
+        throw std::system_error(error, std::generic_category(), "cannot map file: " + path);
+    }
+    close(fd);
+    madvise(base, fileLength, MADV_SEQUENTIAL);
+
+    SourceBuffer srcbuf;
+    srcbuf._mapping = std::shared_ptr<char>(static_cast<char*>(base), [length](char* p) { munmap(p, length); });
+
+    // Skip the BOM
+    if (std::string_view(static_cast<char*>(base), std::min(size, bom.size())) == bom) {
+        srcbuf._mappingOffset = bom.size();
+    }
+    srcbuf._mappingSize = size - srcbuf._mappingOffset;
+
+    srcbuf.identifyLines(0);
+    return srcbuf;
+}
+
 void SourceBuffer::load(std::istream& stream) {
     // Begin index is the start of the new source
-    const size_t beginIndex = _src.size();
+    size_t beginIndex = text().size();
+
+    // Appending to a mapped source needs a copy of it, whose lines are all identified again
+    if (_mapping != nullptr) {
+        _src = std::make_shared<std::string>(text());
+        _mapping.reset();
+        _mappingOffset = 0;
+        _mappingSize = 0;
+        _lineStarts.clear();
+        beginIndex = 0;
+    } else if (_src == nullptr) {
+        _src = std::make_shared<std::string>();
+    } else if (_src.use_count() > 1) {
+        // Copies keep the source they were made with
+        _src = std::make_shared<std::string>(*_src);
+    }
 
     // Append the entire stream
     {
@@ -33,42 +137,28 @@ void SourceBuffer::load(std::istream& stream) {
         if (!stream.good()) {
             throw std::runtime_error("I/O error while loading from stream");
         }
-        _src.append(loaded);
-    }
-
-    // If there's any previously loaded lines, removed the last identified line because we need to re-indetify it
-    if (!_lines.empty()) {
-        _lines.pop_back();
-    }
-
-    // Identify lines
-    const char* lineBegin = &(_src[beginIndex]);
-    size_t lineLen = 0;
-    for (size_t i = beginIndex; i < _src.size(); ++i) {
-        char c = _src[i];
-        if (c == '\n') {
-            // LF
-            _lines.emplace_back(lineBegin, lineLen);
-            lineBegin += lineLen + 1;
-            lineLen = 0;
-        } else if (c == '\r') {
-            // CR/CRLF
-            const char* oldLineBegin = lineBegin;
-            if (i != _src.size() - 1 && _src[i + 1] == '\n') {
-                // CRLF
-                ++i; // Skip '\n' in the next iteration
-                ++lineBegin; // Pre-skip '\n' for next line
-            }
-            _lines.emplace_back(oldLineBegin, lineLen);
-            lineBegin += lineLen + 1;
-            lineLen = 0;
-        } else {
-            ++lineLen;
-        }
+        _src->append(loaded);
+    }
+
+    identifyLines(beginIndex);
+}
+
+void SourceBuffer::identifyLines(size_t beginIndex) {
+    const std::string_view src = text();
+    if (src.size() > UINT32_MAX) {
+        throw std::length_error("source is too large");
+    }
+
+    if (_lineStarts.empty()) {
+        _lineStarts.push_back(0);
+    }
+
+    // A CR ending the previously loaded source and an LF starting the new one are a single CRLF
+    if (beginIndex > 0 && beginIndex < src.size() && src[beginIndex - 1] == '\r' && src[beginIndex] == '\n') {
+        _lineStarts.pop_back();
     }
 
-    // Append the last line (empty if ended with a newline)
-    _lines.emplace_back(lineBegin, lineLen);
+    appendLineStarts(src, beginIndex, _lineStarts);
 }
 
 std::optional<size_t> SourceBuffer::locToIndex(Location loc) const noexcept {
@@ -86,7 +176,7 @@ std::optional<size_t> SourceBuffer::locToIndex(Location loc) const noexcept {
         return std::nullopt;
     }
 
-    return static_cast<size_t>(line.data() - _src.data()) + (columnno - 1);
+    return static_cast<size_t>(line.data() - text().data()) + (columnno - 1);
 }
 
 } // Spark::FrontEnd
@@ -1,6 +1,8 @@
 ﻿#pragma once
 
+#include <cstdint>
 #include <istream>
+#include <memory>
 #include <optional>
 #include <sstream>
 #include <string>
@@ -16,12 +18,30 @@ namespace Spark::FrontEnd {
  */
 class SourceBuffer {
 private:
-    std::string _src;
-    std::vector<std::string_view> _lines;
+    /**
+     * Source when it's not mapped, nullptr until loaded. It's held by pointer so that views into it (e.g. the lexemes
+     * of tokens) stay valid when the buffer is moved, and copies share it until one of them loads more.
+     */
+    std::shared_ptr<std::string> _src;
+
+    /**
+     * Index in the source where each line starts. Offsets stay valid when `_src` grows, and take a quarter of the
+     * memory of views.
+     */
+    std::vector<uint32_t> _lineStarts;
+
+    /**
+     * Private writable mapping of the source file the buffer is backed by (see `fromFile`), nullptr if the source is in
+     * `_src`. The mapping is followed by at least 2 zero bytes.
+     */
+    std::shared_ptr<char> _mapping;
+
+    /**
+     * Offset of the source in the mapping (past the BOM, if any).
+     */
+    size_t _mappingOffset = 0;
 
-protected:
-    SourceBuffer(std::string src, std::vector<std::string_view> lines) noexcept
-        : _src(std::move(src)), _lines(std::move(lines)) { }
+    size_t _mappingSize = 0;
 
 public:
     explicit SourceBuffer(std::istream& stream) {
@@ -35,6 +55,17 @@ public:
 
     virtual ~SourceBuffer() = default;
 
+    /**
+     * Creates a source buffer backed by a memory mapping of a file, without copying its content.
+     * A leading UTF-8 BOM is skipped.
+     * @param path Path of the file.
+     * @return Source buffer of the file.
+     * @throws std::system_error if the file can't be opened or mapped.
+     * @throws std::runtime_error if reading a file that can't be mapped (e.g. a pipe) fails.
+     * @throws std::length_error if the source is 4 GiB or larger.
+     */
+    static SourceBuffer fromFile(const std::string& path);
+
     SourceBuffer(const SourceBuffer& other) = default;
     SourceBuffer& operator=(const SourceBuffer& other) = default;
     SourceBuffer(SourceBuffer&& other) noexcept = default;
@@ -46,14 +77,26 @@ public:
      */
     [[nodiscard]]
     size_t lineNum() const noexcept {
-        return _lines.size();
+        return _lineStarts.size();
+    }
+
+    /**
+     * Gets the whole source.
+     * @return Source text.
+     */
+    [[nodiscard]]
+    std::string_view text() const noexcept {
+        if (_mapping != nullptr) {
+            return { _mapping.get() + _mappingOffset, _mappingSize };
+        }
+        return _src != nullptr ? std::string_view(*_src) : std::string_view();
     }
 
     /**
      * Clears the buffer.
      */
     void clear() noexcept {
-        _lines.clear();
+        _lineStarts.clear();
     }
 
     /**
@@ -80,17 +123,39 @@ public:
      * @return Retrieved line.
      */
     [[nodiscard]]
-    virtual std::string_view getLine(size_t lineno) const {
-        return _lines.at(lineno - 1);
-    }
+    virtual std::string_view getLine(size_t lineno) const;
 
     /**
      * Loads the entire stream's content into the source buffer.
+     * A buffer backed by a file mapping, or sharing its source with copies, gets a copy of the source first.
      * @param stream Stream to load from.
+     * @throws std::runtime_error if reading the stream fails.
+     * @throws std::length_error if the source becomes 4 GiB or larger.
      */
     virtual void load(std::istream& stream);
 
 private:
+    /**
+     * Identifies the lines of the source from @p beginIndex on, after the ones identified so far.
+     * @param beginIndex Index in the source where the new lines start.
+     * @throws std::length_error if the source is 4 GiB or larger.
+     */
+    void identifyLines(size_t beginIndex);
+
+    /**
+     * Gets the source for Flex to scan in place (`yy_scan_buffer`), which ends with 2 zero bytes that are not part of
+     * the source.
+     * @param size Size of the returned buffer, including the 2 zero bytes.
+     * @return Pointer to the buffer, nullptr if the source is not backed by a file mapping.
+     */
+    char* scanBuffer(size_t& size) noexcept {
+        if (_mapping == nullptr) {
+            return nullptr;
+        }
+        size = _mappingSize + 2;
+        return _mapping.get() + _mappingOffset;
+    }
+
     /**
      * Converts a location in the source lines to index in the flat source string.
      * @param loc Location in the source lines.
@@ -99,6 +164,7 @@ private:
     [[nodiscard]]
     std::optional<size_t> locToIndex(Location loc) const noexcept;
 
+    friend class Lexer;
     friend class SourceReader;
 };
 
@@ -107,7 +173,7 @@ private:
  */
 class NullSourceBuffer final : public SourceBuffer {
 private:
-    NullSourceBuffer() : SourceBuffer("", {}) { }
+    NullSourceBuffer() = default;
 
 public:
     static NullSourceBuffer& instance() noexcept {
@@ -2,12 +2,12 @@
 
 #include <algorithm>
 #include <cstring>
-#include <string>
+#include <string_view>
 
 namespace Spark::FrontEnd {
 
 size_t SourceReader::readChunk(char* buf, size_t maxSize) noexcept {
-    const std::string& src = _srcbufp->_src;
+    const std::string_view src = _srcbufp->text();
     if (_index >= src.size()) {
         return 0;
     }
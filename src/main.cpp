@@ -2,7 +2,7 @@
 #include <fcntl.h>
 
 #include <cstdlib>
-#include <fstream>
+#include <exception>
 #include <iostream>
 #include <string>
 #include <string_view>
@@ -96,30 +96,21 @@ int main(int argc, char* argv[]) {
         return EXIT_FAILURE;
     }
 
-    // Gets path and open file
-    std::ifstream file(filePath, std::ios::binary);
-    if (!file.is_open()) {
-        std::cerr << "error: cannot open file: " << filePath << "\n";
+    // Maps the file (the BOM is skipped by offset)
+    SourceBuffer srcbuf;
+    try {
+        srcbuf = SourceBuffer::fromFile(filePath);
+    } catch (const std::exception& e) {
+        std::cerr << "error: " << e.what() << "\n";
         return EXIT_FAILURE;
     }
 
-    // Handle BOM
-    {
-        char bom[3];
-        file.read(bom, 3);
-        if (!(file.gcount() == 3 &&
-            (unsigned char)bom[0] == 0xEF && (unsigned char)bom[1] == 0xBB && (unsigned char)bom[2] == 0xBF)) {
-            file.clear();
-            file.seekg(0, std::ios::beg);
-        }
-    }
-
     // Parse
-    Lexer lexer(file);
+    Lexer lexer(std::move(srcbuf));
     yy::parser::location_type loc;
     AST ast;
     Diagnostics parserDiags;
-    yy::parser parser(lexer.scanner(), &loc, ast, parserDiags);
+    yy::parser parser(lexer, &loc, ast, parserDiags);
     if (parser.parse() == 2) {
         throw std::bad_alloc();
     }
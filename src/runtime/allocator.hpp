@@ -11,6 +11,7 @@ namespace Spark::Runtime {
  * @see std::free
  */
 class DefaultAllocator {
+public:
     void* alloc(std::size_t size) noexcept {
         return std::malloc(size);
     }
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace Spark::Runtime {
+
+/**
+ * Represents a pool of objects stored in fixed-size contiguous chunks.
+ * Addresses of acquired objects stay stable for the lifetime of the pool, and released slots are recycled before new
+ * ones are carved from the last chunk.
+ *
+ * @tparam T Type of the pooled objects (must be default constructible).
+ * @tparam ChunkSize Number of objects per chunk.
+ */
+template <typename T, size_t ChunkSize = 256>
+class ChunkedPool {
+private:
+    std::vector<std::unique_ptr<T[]>> _chunks;
+
+    /**
+     * Number of slots carved from the last chunk.
+     */
+    size_t _carved = ChunkSize;
+
+    /**
+     * Released slots to be recycled (a deque, so releasing never copies the slots released before).
+     */
+    std::deque<T*> _free;
+
+    size_t _size = 0;
+
+public:
+    ChunkedPool() = default;
+
+    ChunkedPool(const ChunkedPool& other) = delete;
+    ChunkedPool& operator=(const ChunkedPool& other) = delete;
+
+    ChunkedPool(ChunkedPool&& other) noexcept = default;
+    ChunkedPool& operator=(ChunkedPool&& other) noexcept = default;
+
+    /**
+     * Gets the number of acquired objects.
+     *
+     * @return Number of acquired objects.
+     */
+    [[nodiscard]]
+    size_t size() const noexcept { return _size; }
+
+    /**
+     * Acquires a slot from the pool.
+     * A recycled slot keeps the state it was released with, so callers must reinitialize it.
+     *
+     * @return Pointer to the acquired slot.
+     */
+    T* acquire() {
+        ++_size;
+        if (!_free.empty()) {
+            T* p = _free.back();
+            _free.pop_back();
+            return p;
+        }
+        if (_carved == ChunkSize) {
+            _chunks.push_back(std::make_unique<T[]>(ChunkSize));
+            _carved = 0;
+        }
+        return &_chunks.back()[_carved++];
+    }
+
+    /**
+     * Releases a slot back to the pool.
+     *
+     * @param p Pointer to the slot previously acquired from this pool.
+     */
+    void release(T* p) {
+        --_size;
+        _free.push_back(p);
+    }
+
+    /**
+     * Calls @p f on every carved slot in memory order, including released ones.
+     *
+     * @param f Function to call with a reference to each slot.
+     */
+    template <typename F>
+    void forEachSlot(F&& f) noexcept(noexcept(f(std::declval<T&>()))) {
+        for (size_t i = 0; i < _chunks.size(); ++i) {
+            size_t count = i + 1 == _chunks.size() ? _carved : ChunkSize;
+            T* chunk = _chunks[i].get();
+            for (size_t j = 0; j < count; ++j) {
+                f(chunk[j]);
+            }
+        }
+    }
+};
+
+} // Spark::Runtime
@@ -0,0 +1,172 @@
+﻿#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "drc.hpp"
+
+namespace Spark::Runtime {
+
+template <typename Allocator>
+class Thread;
+
+/**
+ * Background cycle collector of a Spark context.
+ * Mutator threads hand themselves over through a lock-free queue once they have buffered enough candidate roots, and
+ * the collector thread cleans up their DRC graphs incrementally. Each step runs under the graph lock of the thread for a
+ * short quantum of work, mutations in between are accounted for or cancel the cleanup (see `DRC::startCleanup`), and
+ * the garbage found is handed back to the owning thread to be destructed and freed with its own allocator.
+ * The collector doesn't work on a snapshot or under epoch protection: the candidate roots stay in the buffer of their
+ * thread's graph, and while a collector is attached every DRC operation of the thread takes its graph lock, contending
+ * with the steps of the collector (see `BM_DRCRetainRelease` and `BM_DRCGarbageRings` in the runtime benchmarks).
+ */
+template <typename Allocator>
+class CycleCollector {
+private:
+    /**
+     * Number of nodes the collector processes per step while holding the graph lock of a thread.
+     */
+    static constexpr size_t StepQuantum = 64;
+
+    /**
+     * Intrusive lock-free stack of threads with pending candidate roots (linked by `Thread::_collectorNext`).
+     * Producers push with CAS, the collector takes the whole stack at once, so there's no ABA problem.
+     */
+    std::atomic<Thread<Allocator>*> _queue = nullptr;
+
+    std::atomic<bool> _stopping = false;
+
+    std::mutex _sleepMutex;
+    std::condition_variable _wakeUp;
+
+    /**
+     * Garbage found in the thread being collected, detached a step at a time.
+     */
+    std::deque<DRCNode*> _garbage;
+
+    std::thread _thread;
+
+public:
+    CycleCollector() : _thread([this] { run(); }) { }
+
+    ~CycleCollector() noexcept {
+        stop();
+    }
+
+    CycleCollector(const CycleCollector& other) = delete;
+    CycleCollector& operator=(const CycleCollector& other) = delete;
+
+    CycleCollector(CycleCollector&& other) = delete;
+    CycleCollector& operator=(CycleCollector&& other) = delete;
+
+    /**
+     * Queues a thread whose candidate roots need to be collected.
+     * Must be called with the graph lock of @p th held and `Thread::_collectorQueued` unset.
+     *
+     * @param th Thread to queue.
+     */
+    void enqueue(Thread<Allocator>* th) noexcept {
+        th->_collectorQueued = true;
+        Thread<Allocator>* head = _queue.load(std::memory_order_relaxed);
+        do {
+            th->_collectorNext = head;
+        } while (!_queue.compare_exchange_weak(head, th, std::memory_order_release, std::memory_order_relaxed));
+
+        // Synchronize with the sleeping collector so the notification can't get lost
+        { std::lock_guard<std::mutex> lock(_sleepMutex); }
+        _wakeUp.notify_one();
+    }
+
+    /**
+     * Stops the collector thread (waits for the current step to finish).
+     * Queued threads that were not processed keep their candidate roots.
+     */
+    void stop() noexcept {
+        if (!_thread.joinable()) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(_sleepMutex);
+            _stopping.store(true, std::memory_order_relaxed);
+        }
+        _wakeUp.notify_one();
+        _thread.join();
+    }
+
+private:
+    void run() noexcept {
+        while (true) {
+            Thread<Allocator>* th;
+            {
+                std::unique_lock<std::mutex> lock(_sleepMutex);
+                _wakeUp.wait(lock, [this] {
+                    return _stopping.load(std::memory_order_relaxed) ||
+                           _queue.load(std::memory_order_relaxed) != nullptr;
+                });
+                if (_stopping.load(std::memory_order_relaxed)) {
+                    return;
+                }
+                th = _queue.exchange(nullptr, std::memory_order_acquire);
+            }
+
+            while (th != nullptr) {
+                Thread<Allocator>* next = th->_collectorNext;
+                collect(th);
+                th = next;
+            }
+        }
+    }
+
+    /**
+     * Collects every candidate root of a thread, one step at a time.
+     *
+     * @param th Thread to collect.
+     */
+    void collect(Thread<Allocator>* th) noexcept {
+        while (!_stopping.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> lock(th->_graphMutex);
+            DRC& drc = th->_drc;
+            if (!_garbage.empty()) {
+                detachGarbage(th, StepQuantum);
+                continue;
+            }
+            if (!drc.cleanupInProgress()) {
+                DRCNode* candidate = drc.takeCandidate();
+                if (candidate == nullptr) {
+                    th->_collectorQueued = false;
+                    return;
+                }
+                drc.startCleanup(candidate);
+            }
+            if (drc.stepCleanup(StepQuantum) == DRC::CleanupStatus::Collected) {
+                // The garbage is unreachable, it's detached over the next steps
+                drc.takeCleanupResult(_garbage);
+            }
+        }
+
+        // Stopping, leave the rest of the candidate roots for the thread itself
+        std::lock_guard<std::mutex> lock(th->_graphMutex);
+        detachGarbage(th, SIZE_MAX);
+        th->_collectorQueued = false;
+    }
+
+    /**
+     * Detaches at most @p limit nodes of the garbage found in a thread, handing their objects over to it (with the graph
+     * lock of the thread held).
+     */
+    void detachGarbage(Thread<Allocator>* th, size_t limit) noexcept {
+        for (; limit > 0 && !_garbage.empty(); --limit) {
+            DRCNode* node = _garbage.front();
+            _garbage.pop_front();
+            th->_collected.push_back(node->obj);
+            th->_drc.remove(node);
+        }
+    }
+};
+
+} // Spark::Runtime
@@ -1,131 +1,747 @@
-#include "drc.hpp"
+﻿#include "drc.hpp"
+
+#include <algorithm>
+#include <thread>
 
 #include "thread.hpp"
+#include "work_stealing.hpp"
 
 namespace Spark::Runtime {
 
-/**
- * Swap removes referencee from owner's referencee list.
- *
- * @param owner Owner node (to remove referencee from).
- * @param referencee Node that's being referenced by owner (to be removed from owner).
- */
-static bool removeReferencee(DRCNode* owner, DRCNode* referencee) noexcept {
-    std::vector<DRCNode*>& referencees = owner->referencees;
-    DRCNode* referenceeNode = referencee;
-    for (size_t i = 0; i < referencees.size(); ++i) {
-        if (referencees[i] == referenceeNode) {
-            referencees[i] = referencees.back();
-            referencees.pop_back();
-            return true;
-        }
-    }
-    return false;
-}
-
 DRCNode* DRC::add(DRCHeader* obj) noexcept {
-    auto it = _nodes.emplace().first;
-    DRCNode* node = const_cast<DRCNode*>(&*it);
+    DRCNode* node = _nodes.acquire();
     node->obj = obj;
+    node->internalRefCount = 0;
+    node->traversalId.store(0, std::memory_order_relaxed);
+    node->candidateIndex = DRCNode::NotCandidate;
+    node->cleanupId = 0;
+    node->traced = obj->rcHeader.type != nullptr && obj->rcHeader.type->traced();
+    node->referencees = node->traced ? nullptr : _edgeLists.acquire();
+    node->weak = nullptr;
     return node;
 }
 
+void DRC::remove(DRCNode* node) noexcept {
+    if (cleanupCancellable() && node->cleanupId == _incremental.id) {
+        cancelCleanup(node != _incremental.from);
+    }
+    unbufferCandidate(node);
+    if (node->weak != nullptr) {
+        node->weak->obj = nullptr;
+        node->weak = nullptr;
+    }
+    node->obj = nullptr;
+    if (node->referencees != nullptr) {
+        // A recycled list is empty, its spilled table is freed
+        node->referencees->clear();
+        _edgeLists.release(node->referencees);
+        node->referencees = nullptr;
+    }
+    _nodes.release(node);
+}
+
 void DRC::retain(DRCNode* owner, DRCNode* referencee) noexcept {
-    owner->referencees.push_back(referencee);
+    if constexpr (StatsEnabled) {
+        ++_stats.retains;
+    }
+    if (!owner->traced) {
+        owner->referencees->add(referencee);
+    }
     referencee->internalRefCount++;
+
+    if (cleanupCancellable()) {
+        if (_incremental.phase != IncrementalCleanup::Phase::Mark) {
+            if (touchedByCleanup(owner) || touchedByCleanup(referencee)) {
+                cancelCleanup(true);
+            }
+        } else if (touchedByCleanup(owner) && (owner->cleanupFlags & CleanupFlag::Expanded)) {
+            // An expanded owner's edges are all subtracted, so the new one must be too (reaching the referencee)
+            if (!touchedByCleanup(referencee)) {
+                touchInCleanup(referencee);
+                referencee->trialRefCount--;
+            }
+        } else if (touchedByCleanup(referencee)) {
+            // The new edge is not subtracted yet (it will be if the owner gets expanded later)
+            referencee->trialRefCount++;
+        }
+    }
+
+    // A re-referenced candidate is no longer a possible cycle root
+    unbufferCandidate(referencee);
 }
 
 const std::vector<DRCNode*>& DRC::release(DRCNode* owner, DRCNode* referencee) noexcept {
+    if constexpr (StatsEnabled) {
+        ++_stats.releases;
+    }
     // Remove referencee node from owner's referencees
-    if (!removeReferencee(owner, referencee)) {
+    if (!owner->traced && !owner->referencees->remove(referencee)) {
         _toRemoveCache.clear();
         return _toRemoveCache;
     }
     referencee->internalRefCount--;
 
-    return tryCleanup(referencee);
+    if (cleanupCancellable()) {
+        if (_incremental.phase != IncrementalCleanup::Phase::Mark) {
+            if (touchedByCleanup(owner) || touchedByCleanup(referencee)) {
+                cancelCleanup(true);
+            }
+        } else if (touchedByCleanup(referencee) &&
+                   !(touchedByCleanup(owner) && (owner->cleanupFlags & CleanupFlag::Expanded))) {
+            // The removed edge has not been subtracted from the trial count yet
+            referencee->trialRefCount--;
+        }
+    }
+
+    return releaseCandidate(referencee);
+}
+
+const std::vector<DRCNode*>& DRC::releaseExternal(DRCNode* node) noexcept {
+    return releaseCandidate(node);
+}
+
+const std::vector<DRCNode*>& DRC::releaseCandidate(DRCNode* node) noexcept {
+    // Clean up immediately if buffering is disabled or the node is definitely unreachable
+    if (_candidateThreshold == 0 || (node->internalRefCount == 0 && node->obj->rcHeader.refCount == 0)) {
+        unbufferCandidate(node);
+        return tryCleanup(node);
+    }
+
+    // Otherwise the node may be the root of a garbage cycle, defer the cleanup
+    bufferCandidate(node);
+    if (_candidates.size() >= _candidateThreshold) {
+        return collectCandidates();
+    }
+    _toRemoveCache.clear();
+    return _toRemoveCache;
+}
+
+DRCWeakRef* DRC::weakRetain(DRCNode* node) noexcept {
+    if (node->weak == nullptr) {
+        node->weak = _weakRefs.acquire();
+        node->weak->obj = node->obj;
+        node->weak->weakCount = 0;
+    }
+    ++node->weak->weakCount;
+    return node->weak;
+}
+
+void DRC::weakRelease(DRCWeakRef* ref) noexcept {
+    if (--ref->weakCount > 0) {
+        return;
+    }
+    if (ref->obj != nullptr) {
+        ref->obj->node->weak = nullptr;
+    }
+    _weakRefs.release(ref);
+}
+
+DRCHeader* DRC::weakUpgrade(DRCWeakRef* ref) noexcept {
+    DRCHeader* obj = ref->obj;
+    if (obj == nullptr || !touchedByCleanup(obj->node)) {
+        return obj;
+    }
+    if (!cleanupCancellable()) {
+        // Dropping the garbage, whose weak references are cleared a step at a time
+        return (obj->node->cleanupFlags & CleanupFlag::Live) ? obj : nullptr;
+    }
+    // Marking accounts for new external references, later phases may have decided on the object already
+    if (_incremental.phase != IncrementalCleanup::Phase::Mark) {
+        cancelCleanup(true);
+    }
+    return obj;
 }
 
 const std::vector<DRCNode*>& DRC::tryCleanup(DRCNode* from) noexcept {
-    // Ignore if the starting node is still externally referenced
-    if (from->obj->rcHeader.refCount > 0) {
-        _toRemoveCache.clear();
-        return _toRemoveCache;
+    CleanupTraceScope trace(_tracer, CleanupEvent::Kind::Cleanup);
+    const std::vector<DRCNode*>& toRemove = findGarbage(from);
+    if constexpr (StatsEnabled) {
+        ++_stats.cleanups;
+        if (toRemove.empty()) {
+            ++_stats.abortedCleanups;
+        }
+        _stats.collectedNodes += toRemove.size();
+        _stats.traversalSizes.add(_traversalSize);
+        trace.setVisited(_traversalSize);
+        trace.setCollected(toRemove.size());
     }
+    return toRemove;
+}
 
-    // Trial removal
-    uintptr_t traversalId = getNewTraversalId();
+const std::vector<DRCNode*>& DRC::findGarbage(DRCNode* from) noexcept {
     _toRemoveCache.clear();
+    _visitCache.clear();
+    _traversalSize = 0;
     std::vector<DRCNode*>& toRemove = _toRemoveCache;
-    toRemove.push_back(from);
-    _stackCache.clear();
-    std::vector<DRCNode*>& stack = _stackCache;
-    stack.push_back(from);
-    while (!stack.empty()) {
-        DRCNode* node = stack.back();
-        stack.pop_back();
-        if (node->traversalId == traversalId) {
+
+    // Ignore if the starting node is still externally referenced
+    if (from->obj->rcHeader.refCount > 0) {
+        return toRemove;
+    }
+
+    // Tarjan's SCC over the reachable subgraph
+    const uintptr_t traversalId = getNewTraversalId();
+    std::vector<VisitState>& states = _visitCache;
+    std::vector<VisitFrame>& frames = _frameCache;
+    std::vector<uint32_t>& sccStack = _sccStackCache;
+    std::vector<uint32_t>& sccMembers = _sccMembersCache;
+    frames.clear();
+    sccStack.clear();
+    sccMembers.clear();
+
+    visit(from, traversalId);
+    while (!frames.empty()) {
+        VisitFrame& frame = frames.back();
+        const uint32_t v = frame.index;
+
+        DRCNode* referencee;
+        RCInt count;
+        if (nextEdge(states[v].node, frame.cursor, referencee, count)) {
+            uint32_t w;
+            if (referencee->traversalId.load(std::memory_order_relaxed) != traversalId) {
+                // Large subgraphs are cleaned up in parallel, the traversal so far only wrote scratch state
+                if (states.size() == _parallelThreshold) {
+                    return findGarbageParallel(from);
+                }
+                // Tree edge (the child's lowlink is propagated when its frame finishes)
+                w = visit(referencee, traversalId);
+            } else {
+                w = referencee->traversalIndex;
+                if (states[w].onStack && w < states[v].low) {
+                    states[v].low = w;
+                }
+            }
+            // Every edge from an expanded node is internal to the subgraph
+            states[w].trialRefCount -= count;
             continue;
         }
-        node->traversalId = traversalId; // Update traversal ID to mark it as visited
 
-        for (DRCNode* referencee : node->referencees) {
-            // Decrease internal RC
-            referencee->internalRefCount--;
+        // Finish the node
+        frames.pop_back();
+        if (states[v].low == v) {
+            // Root of an SCC, pop its members (SCCs are identified by the position of their first member)
+            const auto scc = static_cast<uint32_t>(sccMembers.size());
+            uint32_t w;
+            do {
+                w = sccStack.back();
+                sccStack.pop_back();
+                states[w].onStack = false;
+                states[w].scc = scc;
+                sccMembers.push_back(w);
+            } while (w != v);
+        }
+        if (!frames.empty()) {
+            VisitState& parent = states[frames.back().index];
+            if (states[v].low < parent.low) {
+                parent.low = states[v].low;
+            }
+        }
+    }
+
+    _traversalSize = states.size();
+
+    // An SCC is live if any member is referenced from outside the subgraph
+    std::vector<uint8_t>& sccLive = _sccLiveCache;
+    sccLive.assign(sccMembers.size(), 0);
+    bool anyLive = false;
+    for (const VisitState& state : states) {
+        if (state.trialRefCount > 0 || state.external) {
+            sccLive[state.scc] = 1;
+            anyLive = true;
+        }
+    }
+
+    // The starting node's SCC completes last and reaches everything, nothing is garbage if it's live
+    if (sccLive[states[0].scc]) {
+        return toRemove;
+    }
+
+    // Propagate liveness in topological order, each SCC is final before its members are reached
+    if (anyLive) {
+        for (size_t i = sccMembers.size(); i-- > 0;) {
+            const VisitState& state = states[sccMembers[i]];
+            // Not expanded nodes don't matter, their referencees in the subgraph have outside references anyway
+            if (!sccLive[state.scc] || state.external) {
+                continue;
+            }
+            forEachEdge(state.node, [&](DRCNode* referencee, RCInt) {
+                sccLive[states[referencee->traversalIndex].scc] = 1;
+            });
+        }
+    }
+
+    // Collect the garbage and drop its edges to surviving nodes
+    for (const VisitState& state : states) {
+        if (!sccLive[state.scc]) {
+            toRemove.push_back(state.node);
+        }
+    }
+    if (anyLive) {
+        for (DRCNode* node : toRemove) {
+            forEachEdge(node, [&](DRCNode* referencee, RCInt count) {
+                if (sccLive[states[referencee->traversalIndex].scc]) {
+                    referencee->internalRefCount -= count;
+                }
+            });
+        }
+    }
+
+    return toRemove;
+}
+
+const std::vector<DRCNode*>& DRC::findGarbageParallel(DRCNode* from) noexcept {
+    if constexpr (StatsEnabled) {
+        ++_stats.parallelCleanups;
+    }
+
+    const uintptr_t traversalId = getNewTraversalId();
+    const size_t workerCount = _parallelWorkerCount;
+    _parallelWorkers.resize(workerCount);
+    for (ParallelWorker& worker : _parallelWorkers) {
+        worker.visited.clear();
+        worker.toRemove.clear();
+        worker.dropped.clear();
+    }
 
-            // Stop if it's externally referenced
-            if (referencee->obj->rcHeader.refCount > 0) {
+    WorkStealingFrontier<DRCNode*> frontier(workerCount);
+    Barrier barrier(workerCount);
+    std::atomic<bool> fromLive = false;
+    size_t total = 0;
+
+    // The starting node is claimed by the first worker, so it's numbered 0
+    from->traversalId.store(traversalId, std::memory_order_relaxed);
+    _parallelWorkers[0].visited.push_back(from);
+    frontier.push(0, from);
+
+    auto work = [&](size_t w) {
+        ParallelWorker& worker = _parallelWorkers[w];
+
+        // Discover the subgraph, externally referenced nodes are not expanded
+        frontier.drain(w, [&](DRCNode* node) {
+            forEachEdge(node, [&](DRCNode* referencee, RCInt) {
+                uintptr_t id = referencee->traversalId.load(std::memory_order_relaxed);
+                if (id != traversalId &&
+                    referencee->traversalId.compare_exchange_strong(id, traversalId, std::memory_order_relaxed)) {
+                    worker.visited.push_back(referencee);
+                    if (referencee->obj->rcHeader.refCount == 0) {
+                        frontier.push(w, referencee);
+                    }
+                }
+            });
+        });
+        barrier.arriveAndWait();
+
+        if (w == 0) {
+            for (ParallelWorker& other : _parallelWorkers) {
+                other.offset = static_cast<uint32_t>(total);
+                total += other.visited.size();
+            }
+            if (total > _parallelStateCapacity) {
+                _parallelStateCapacity = std::max(total, 2 * _parallelStateCapacity);
+                _parallelStates = std::make_unique<ParallelVisitState[]>(_parallelStateCapacity);
+            }
+        }
+        barrier.arriveAndWait();
+
+        ParallelVisitState* states = _parallelStates.get();
+        for (size_t i = 0; i < worker.visited.size(); ++i) {
+            DRCNode* node = worker.visited[i];
+            node->traversalIndex = worker.offset + static_cast<uint32_t>(i);
+            ParallelVisitState& state = states[node->traversalIndex];
+            state.node = node;
+            state.trialRefCount.store(node->internalRefCount, std::memory_order_relaxed);
+            state.live.store(false, std::memory_order_relaxed);
+            state.external = node->obj->rcHeader.refCount > 0;
+        }
+        barrier.arriveAndWait();
+
+        // Every edge from an expanded node is internal to the subgraph
+        for (DRCNode* node : worker.visited) {
+            if (states[node->traversalIndex].external) {
                 continue;
             }
+            forEachEdge(node, [&](DRCNode* referencee, RCInt count) {
+                states[referencee->traversalIndex].trialRefCount.fetch_sub(count, std::memory_order_relaxed);
+            });
+        }
+        barrier.arriveAndWait();
+
+        // Propagate liveness from nodes referenced from outside the subgraph, nothing is garbage once `from` is live
+        auto markLive = [&](DRCNode* node) {
+            ParallelVisitState& state = states[node->traversalIndex];
+            if (state.live.exchange(true, std::memory_order_relaxed)) {
+                return;
+            }
+            if (node == from) {
+                fromLive.store(true, std::memory_order_relaxed);
+            } else if (!state.external) {
+                frontier.push(w, node);
+            }
+        };
+        for (DRCNode* node : worker.visited) {
+            const ParallelVisitState& state = states[node->traversalIndex];
+            if (state.external || state.trialRefCount.load(std::memory_order_relaxed) > 0) {
+                markLive(node);
+            }
+        }
+        frontier.drain(w, [&](DRCNode* node) {
+            if (!fromLive.load(std::memory_order_relaxed)) {
+                forEachEdge(node, [&](DRCNode* referencee, RCInt) { markLive(referencee); });
+            }
+        });
+        barrier.arriveAndWait();
 
-            // Mark as to remove if internal RC reaches zero (the source node is always marked as to remove, so ignore it)
-            if (referencee->internalRefCount == 0 && referencee != from) {
-                toRemove.push_back(referencee);
+        if (fromLive.load(std::memory_order_relaxed)) {
+            return;
+        }
+        for (DRCNode* node : worker.visited) {
+            if (states[node->traversalIndex].live.load(std::memory_order_relaxed)) {
+                continue;
             }
+            worker.toRemove.push_back(node);
+            forEachEdge(node, [&](DRCNode* referencee, RCInt count) {
+                if (states[referencee->traversalIndex].live.load(std::memory_order_relaxed)) {
+                    worker.dropped.emplace_back(referencee, count);
+                }
+            });
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(workerCount - 1);
+    for (size_t w = 1; w < workerCount; ++w) {
+        threads.emplace_back(work, w);
+    }
+    work(0);
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
 
-            // Push to the stack
-            stack.push_back(referencee);
+    // Merge the buffers of the workers
+    _traversalSize = total;
+    std::vector<DRCNode*>& toRemove = _toRemoveCache;
+    toRemove.clear();
+    if (fromLive.load(std::memory_order_relaxed)) {
+        return toRemove;
+    }
+    for (const ParallelWorker& worker : _parallelWorkers) {
+        toRemove.insert(toRemove.end(), worker.toRemove.begin(), worker.toRemove.end());
+        for (auto [referencee, count] : worker.dropped) {
+            referencee->internalRefCount -= count;
         }
     }
+    return toRemove;
+}
+
+uint32_t DRC::visit(DRCNode* node, uintptr_t traversalId) {
+    const auto index = static_cast<uint32_t>(_visitCache.size());
+    node->traversalId.store(traversalId, std::memory_order_relaxed);
+    node->traversalIndex = index;
+
+    // Externally referenced nodes are not expanded, so they're leaves like nodes without edges
+    const bool external = node->obj->rcHeader.refCount > 0;
+    if (external || !mayHaveEdges(node)) {
+        const auto scc = static_cast<uint32_t>(_sccMembersCache.size());
+        _visitCache.push_back(VisitState{ node, node->internalRefCount, index, scc, false, external });
+        _sccMembersCache.push_back(index);
+        return index;
+    }
+
+    _visitCache.push_back(VisitState{ node, node->internalRefCount, index, 0, true, false });
+    _sccStackCache.push_back(index);
+    _frameCache.push_back(VisitFrame{ index, 0 });
+    return index;
+}
+
+const std::vector<DRCNode*>& DRC::collectCandidates() noexcept {
+    _collectedCache.clear();
+    while (!_candidates.empty()) {
+        DRCNode* candidate = _candidates.back();
+        _candidates.pop_back();
+        candidate->candidateIndex = DRCNode::NotCandidate;
+
+        // Skip candidates that are externally referenced again
+        if (candidate->obj->rcHeader.refCount > 0) {
+            continue;
+        }
 
-    // Check if any node is still being referenced
-    bool abort = false;
-    for (DRCNode* node : toRemove) {
-        if (node->internalRefCount > 0 || node->obj->rcHeader.refCount > 0) {
-            abort = true;
-            break;
+        // Deleted nodes must not be tried again as candidates in this batch
+        for (DRCNode* node : tryCleanup(candidate)) {
+            unbufferCandidate(node);
+            _collectedCache.push_back(node);
         }
     }
-    if (abort) {
-        // Resume internal RCs
-        traversalId = getNewTraversalId();
-        stack.clear();
-        stack.push_back(from);
-        while (!stack.empty()) {
-            DRCNode* node = stack.back();
-            stack.pop_back();
-            node->traversalId = traversalId; // Update traversal ID to mark it as visited
+    return _collectedCache;
+}
+
+void DRC::setParallelCleanup(size_t threshold, size_t workers) noexcept {
+    if (workers == 0) {
+        workers = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    }
+    _parallelThreshold = threshold;
+    _parallelWorkerCount = workers;
+}
+
+void DRC::bufferCandidate(DRCNode* node) noexcept {
+    if (node->candidateIndex != DRCNode::NotCandidate) {
+        return;
+    }
+    node->candidateIndex = _candidates.size();
+    _candidates.push_back(node);
+}
 
-            for (DRCNode* referencee : node->referencees) {
-                referencee->internalRefCount++;
-                if (referencee->traversalId != traversalId) {
-                    stack.push_back(referencee);
+void DRC::unbufferCandidate(DRCNode* node) noexcept {
+    if (node->candidateIndex == DRCNode::NotCandidate) {
+        return;
+    }
+
+    // Swap remove
+    DRCNode* last = _candidates.back();
+    _candidates[node->candidateIndex] = last;
+    last->candidateIndex = node->candidateIndex;
+    _candidates.pop_back();
+    node->candidateIndex = DRCNode::NotCandidate;
+}
+
+DRCNode* DRC::takeCandidate() noexcept {
+    if (_candidates.empty()) {
+        return nullptr;
+    }
+    DRCNode* candidate = _candidates.back();
+    unbufferCandidate(candidate);
+    return candidate;
+}
+
+void DRC::startCleanup(DRCNode* from) noexcept {
+    if (cleanupInProgress()) {
+        cancelCleanup(true);
+    }
+
+    IncrementalCleanup& ic = _incremental;
+    ic.from = from;
+    ic.id = getNewTraversalId();
+    ic.stack.clear();
+    ic.touched.clear();
+    ic.collected.clear();
+    ic.index = 0;
+    ic.phase = IncrementalCleanup::Phase::Mark;
+    touchInCleanup(from);
+}
+
+DRC::CleanupStatus DRC::stepCleanup(size_t budget) noexcept {
+    CleanupTraceScope trace(_tracer, CleanupEvent::Kind::Step);
+    const size_t initialBudget = budget;
+    const CleanupStatus status = runCleanup(budget);
+    if constexpr (StatsEnabled) {
+        if (status == CleanupStatus::Collected) {
+            ++_stats.cleanups;
+            _stats.collectedNodes += _incremental.collected.size();
+            trace.setCollected(_incremental.collected.size());
+        }
+        trace.setVisited(initialBudget - budget);
+    }
+    return status;
+}
+
+DRC::CleanupStatus DRC::runCleanup(size_t& budget) noexcept {
+    using Phase = IncrementalCleanup::Phase;
+    IncrementalCleanup& ic = _incremental;
+
+    while (ic.phase != Phase::Idle) {
+        bool ok = true;
+        switch (ic.phase) {
+            case Phase::Mark: ok = stepMark(budget); break;
+            case Phase::Scan: ok = stepScan(budget); break;
+            case Phase::Collect: ok = stepCollect(budget); break;
+            case Phase::Drop: ok = stepDrop(budget); break;
+            case Phase::Idle: break;
+        }
+        if (!ok) {
+            cancelCleanup(false);
+            return CleanupStatus::Aborted;
+        }
+        if (ic.phase == Phase::Idle) {
+            return CleanupStatus::Collected;
+        }
+        if (budget == 0) {
+            return CleanupStatus::Pending;
+        }
+    }
+    return CleanupStatus::Aborted;
+}
+
+void DRC::touchInCleanup(DRCNode* node) noexcept {
+    node->cleanupId = _incremental.id;
+    node->trialRefCount = node->internalRefCount;
+    node->cleanupFlags = 0;
+    _incremental.touched.push_back(node);
+
+    // Externally referenced nodes are live, so there's no need to expand them
+    if (node->obj->rcHeader.refCount == 0) {
+        _incremental.stack.push_back(node);
+    }
+}
+
+bool DRC::markLiveInCleanup(DRCNode* node) noexcept {
+    if (node == _incremental.from) {
+        return false;
+    }
+    node->cleanupFlags |= CleanupFlag::Live;
+    _incremental.stack.push_back(node);
+    return true;
+}
+
+void DRC::cancelCleanup(bool requeue) noexcept {
+    if constexpr (StatsEnabled) {
+        ++_stats.cleanups;
+        ++_stats.abortedCleanups;
+    }
+
+    IncrementalCleanup& ic = _incremental;
+    ic.phase = IncrementalCleanup::Phase::Idle;
+    if (requeue) {
+        bufferCandidate(ic.from);
+    }
+    ic.from = nullptr;
+    ic.stack.clear();
+    ic.touched.clear();
+    ic.collected.clear();
+}
+
+bool DRC::stepMark(size_t& budget) noexcept {
+    IncrementalCleanup& ic = _incremental;
+    while (budget > 0 && !ic.stack.empty()) {
+        DRCNode* node = ic.stack.back();
+        ic.stack.pop_back();
+        --budget;
+
+        forEachEdge(node, [&](DRCNode* referencee, RCInt count) {
+            if (referencee->cleanupId != ic.id) {
+                touchInCleanup(referencee);
+            }
+            referencee->trialRefCount -= count;
+        });
+        node->cleanupFlags |= CleanupFlag::Expanded;
+    }
+
+    if (ic.stack.empty()) {
+        if constexpr (StatsEnabled) {
+            _stats.traversalSizes.add(ic.touched.size());
+        }
+        ic.phase = IncrementalCleanup::Phase::Scan;
+        ic.index = 0;
+    }
+    return true;
+}
+
+bool DRC::stepScan(size_t& budget) noexcept {
+    IncrementalCleanup& ic = _incremental;
+    while (budget > 0) {
+        // Propagate liveness to everything reachable from a live node
+        if (!ic.stack.empty()) {
+            DRCNode* node = ic.stack.back();
+            ic.stack.pop_back();
+            --budget;
+
+            bool ok = true;
+            forEachEdge(node, [&](DRCNode* referencee, RCInt) {
+                if (ok && referencee->cleanupId == ic.id && !(referencee->cleanupFlags & CleanupFlag::Live)) {
+                    ok = markLiveInCleanup(referencee);
                 }
+            });
+            if (!ok) {
+                return false;
             }
+            continue;
         }
 
-        toRemove.clear();
+        if (ic.index == ic.touched.size()) {
+            ic.phase = IncrementalCleanup::Phase::Collect;
+            ic.index = 0;
+            return true;
+        }
+
+        // Nodes still referenced from outside the traversal (or not expanded) are live
+        DRCNode* node = ic.touched[ic.index++];
+        --budget;
+        if (!(node->cleanupFlags & CleanupFlag::Live) &&
+            (node->trialRefCount > 0 || node->obj->rcHeader.refCount > 0 ||
+             !(node->cleanupFlags & CleanupFlag::Expanded))) {
+            if (!markLiveInCleanup(node)) {
+                return false;
+            }
+        }
     }
+    return true;
+}
 
-    return toRemove;
+bool DRC::stepCollect(size_t& budget) noexcept {
+    IncrementalCleanup& ic = _incremental;
+    while (budget > 0 && ic.index < ic.touched.size()) {
+        DRCNode* node = ic.touched[ic.index++];
+        --budget;
+        if (node->cleanupFlags & CleanupFlag::Live) {
+            continue;
+        }
+        // Got externally referenced again after it was scanned
+        if (node->obj->rcHeader.refCount > 0) {
+            return false;
+        }
+        ic.collected.push_back(node);
+    }
+    if (ic.index == ic.touched.size()) {
+        ic.phase = IncrementalCleanup::Phase::Drop;
+        ic.index = 0;
+    }
+    return true;
+}
+
+bool DRC::stepDrop(size_t& budget) noexcept {
+    IncrementalCleanup& ic = _incremental;
+    // The traversal is over, its nodes are let go of a step at a time (clearing them at once would free every block)
+    while (budget > 0 && !ic.touched.empty()) {
+        DRCNode* node = ic.touched.front();
+        ic.touched.pop_front();
+        --budget;
+        if (node->cleanupFlags & CleanupFlag::Live) {
+            continue;
+        }
+
+        // Edges from garbage to surviving nodes go away with the garbage (surviving nodes can't be removed before)
+        forEachEdge(node, [&](DRCNode* referencee, RCInt count) {
+            if (referencee->cleanupId != ic.id || (referencee->cleanupFlags & CleanupFlag::Live)) {
+                referencee->internalRefCount -= count;
+            }
+        });
+        unbufferCandidate(node);
+        if (node->weak != nullptr) {
+            node->weak->obj = nullptr;
+            node->weak = nullptr;
+        }
+    }
+    if (!ic.touched.empty()) {
+        return true;
+    }
+
+    ic.phase = IncrementalCleanup::Phase::Idle;
+    ic.from = nullptr;
+    return true;
 }
 
 uintptr_t DRC::getNewTraversalId() noexcept {
     _traversalId++;
     if (_traversalId == 0) {
-        for (const DRCNode& node : _nodes) {
-            const_cast<DRCNode&>(node).traversalId = 0;
+        if (cleanupCancellable()) {
+            cancelCleanup(true);
         }
+        // A cleanup dropping the edges of its garbage keeps its ID, which won't come again before the next wrap
+        const uintptr_t keptId = cleanupInProgress() ? _incremental.id : 0;
+        _nodes.forEachSlot([keptId](DRCNode& node) noexcept {
+            node.traversalId.store(0, std::memory_order_relaxed);
+            if (node.cleanupId != keptId) {
+                node.cleanupId = 0;
+            }
+        });
         _traversalId = 1;
     }
 
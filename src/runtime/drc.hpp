@@ -1,10 +1,16 @@
-#pragma once
+﻿#pragma once
 
+#include <atomic>
 #include <cstdint>
-#include <unordered_set>
+#include <deque>
+#include <memory>
+#include <utility>
 #include <vector>
 
+#include "chunked_pool.hpp"
+#include "drc_edge_list.hpp"
 #include "rc.hpp"
+#include "runtime_stats.hpp"
 
 namespace Spark::Runtime {
 
@@ -18,45 +24,248 @@ struct DRCHeader {
     RCHeader rcHeader;
 };
 
-struct DRCNode {
-    DRCHeader* obj;
-    RCInt internalRefCount;
-    std::vector<DRCNode*> referencees;
-    uintptr_t traversalId;
+static_assert(sizeof(DRCHeader) == 16);
 
-    bool operator==(const DRCNode& other) const noexcept {
-        return obj == other.obj;
-    }
+/**
+ * Side-table entry of a weakly referenced DRC object, shared by every weak reference to it.
+ * Weak references don't count as references in the DRC graph. The entry outlives its object until the last weak
+ * reference is released, and reads nullptr once the object has been deleted.
+ */
+struct DRCWeakRef {
+    DRCHeader* obj = nullptr;
+    size_t weakCount = 0;
 };
 
-} // Spark::Runtime
+struct DRCNode {
+    /**
+     * Value of `candidateIndex` for nodes that are not in the candidate buffer.
+     */
+    static constexpr size_t NotCandidate = SIZE_MAX;
 
-namespace std {
-    template <>
-    struct hash<Spark::Runtime::DRCNode> {
-        size_t operator()(const Spark::Runtime::DRCNode& node) const noexcept {
-            return std::hash<Spark::Runtime::DRCHeader*>{}(node.obj);
-        }
-    };
-} // std
+    DRCHeader* obj = nullptr;
+    RCInt internalRefCount = 0;
 
-namespace Spark::Runtime {
+    /**
+     * Outgoing edges (from `DRC::_edgeLists`), nullptr if the node is `traced` (then they're read from the fields of
+     * the object).
+     */
+    DRCEdgeList* referencees = nullptr;
+
+    /**
+     * ID of the traversal that last visited this node, atomic so that parallel cleanup workers can claim nodes.
+     */
+    std::atomic<uintptr_t> traversalId = 0;
+
+    /**
+     * Index of the node in the candidate root buffer, `NotCandidate` if it's not buffered.
+     */
+    size_t candidateIndex = NotCandidate;
+
+    /**
+     * ID of the incremental cleanup that last touched this node, `trialRefCount` and `cleanupFlags` are only valid
+     * while it's current.
+     */
+    uintptr_t cleanupId = 0;
+
+    /**
+     * Internal references not coming from nodes expanded by the incremental cleanup.
+     */
+    RCInt trialRefCount = 0;
+
+    /**
+     * Weak reference entry of the object, nullptr if it's not weakly referenced.
+     */
+    DRCWeakRef* weak = nullptr;
+
+    /**
+     * Index of the node in the scratch state of the traversal `traversalId`.
+     */
+    uint32_t traversalIndex = 0;
+
+    /**
+     * State of the node in the incremental cleanup (`DRC::CleanupFlag`).
+     */
+    uint8_t cleanupFlags = 0;
+
+    /**
+     * Whether the type of the object is traced, see `Type::drcFields`.
+     */
+    bool traced = false;
+};
+
+static_assert(sizeof(DRCNode) == 72);
 
 /**
  * Represents a DRC graph that associates DRC objects with DRC nodes to manage their lifetimes.
  */
 class DRC {
+public:
+    /**
+     * Status of an incremental cleanup.
+     */
+    enum class CleanupStatus {
+        /**
+         * The cleanup needs more steps.
+         */
+        Pending,
+        /**
+         * The cleanup finished and found garbage (see `cleanupResult`).
+         */
+        Collected,
+        /**
+         * The cleanup finished without garbage, or was cancelled by a conflicting mutation.
+         */
+        Aborted,
+    };
+
 private:
-    std::unordered_set<DRCNode> _nodes;
+    enum CleanupFlag : uint8_t {
+        /**
+         * Outgoing edges of the node have been subtracted from the trial counts.
+         */
+        Expanded = 1 << 0,
+        /**
+         * The node is known to be reachable from outside the garbage candidates.
+         */
+        Live = 1 << 1,
+    };
+
+    /**
+     * State of an incremental cleanup, persisted between steps.
+     * Marking computes trial counts in scratch fields instead of `internalRefCount`, so an aborted cleanup needs no
+     * restoring pass, scanning propagates liveness from nodes with remaining references, everything touched but not
+     * live is collected, and the edges from the garbage to surviving nodes are dropped (a step at a time as well).
+     * The node lists are deques, so that growing or draining them never copies or frees them whole in a single step.
+     */
+    struct IncrementalCleanup {
+        enum class Phase { Idle, Mark, Scan, Collect, Drop };
+
+        Phase phase = Phase::Idle;
+        DRCNode* from = nullptr;
+        uintptr_t id = 0;
+        std::deque<DRCNode*> stack;
+        std::deque<DRCNode*> touched;
+        size_t index = 0;
+        std::deque<DRCNode*> collected;
+    };
+
+    /**
+     * Storage of every DRC node, nodes keep their addresses until removed.
+     */
+    ChunkedPool<DRCNode> _nodes;
+
+    /**
+     * Edge lists of the nodes that are not traced, kept apart so that traced nodes don't carry one.
+     */
+    ChunkedPool<DRCEdgeList> _edgeLists;
+
+    /**
+     * Weak reference side table, entries keep their addresses until their last weak reference is released.
+     */
+    ChunkedPool<DRCWeakRef> _weakRefs;
+
+    /**
+     * Scratch state of a node visited by `tryCleanup`, indexed by `DRCNode::traversalIndex` (discovery order).
+     */
+    struct VisitState {
+        DRCNode* node;
+        /**
+         * Internal references not coming from expanded nodes of the traversal.
+         */
+        RCInt trialRefCount;
+        /**
+         * Lowest discovery index reachable through the DFS subtree (Tarjan's lowlink).
+         */
+        uint32_t low;
+        uint32_t scc;
+        bool onStack;
+        bool external;
+    };
+
+    /**
+     * DFS frame of `tryCleanup`, iterating the node's edges with a cursor.
+     */
+    struct VisitFrame {
+        uint32_t index;
+        uint32_t cursor;
+    };
 
     std::vector<DRCNode*> _toRemoveCache;
-    std::vector<DRCNode*> _stackCache;
+    std::vector<VisitState> _visitCache;
+    std::vector<VisitFrame> _frameCache;
+    std::vector<uint32_t> _sccStackCache;
+    /**
+     * Members of every SCC, grouped by SCC in completion order (so reversed it's a topological order).
+     */
+    std::vector<uint32_t> _sccMembersCache;
+    std::vector<uint8_t> _sccLiveCache;
+
+    /**
+     * Scratch state of a node visited by a parallel cleanup, indexed by `DRCNode::traversalIndex`.
+     */
+    struct ParallelVisitState {
+        DRCNode* node;
+        /**
+         * Internal references not coming from expanded nodes of the traversal.
+         */
+        std::atomic<RCInt> trialRefCount;
+        std::atomic<bool> live;
+        bool external;
+    };
+
+    /**
+     * Buffers of a parallel cleanup worker, merged once every worker is done.
+     */
+    struct ParallelWorker {
+        /**
+         * Nodes claimed by the worker while discovering the subgraph, numbered from `offset`.
+         */
+        std::vector<DRCNode*> visited;
+        uint32_t offset = 0;
+        std::vector<DRCNode*> toRemove;
+        /**
+         * Edges from garbage to surviving nodes.
+         */
+        std::vector<std::pair<DRCNode*, RCInt>> dropped;
+    };
+
+    std::unique_ptr<ParallelVisitState[]> _parallelStates;
+    size_t _parallelStateCapacity = 0;
+    std::vector<ParallelWorker> _parallelWorkers;
+
+    /**
+     * Number of nodes a cleanup visits sequentially before going parallel, 0 if cleanups are always sequential.
+     */
+    size_t _parallelThreshold = 0;
+    size_t _parallelWorkerCount = 1;
+
+    /**
+     * Number of nodes visited by the last `tryCleanup`.
+     */
+    size_t _traversalSize = 0;
+
+    /**
+     * Buffered candidate roots (possible cycle roots whose cleanup is deferred).
+     */
+    std::vector<DRCNode*> _candidates;
+    std::vector<DRCNode*> _collectedCache;
+
+    /**
+     * Number of candidate roots that triggers a batch collection, 0 if releases clean up immediately.
+     */
+    size_t _candidateThreshold = 0;
+
+    IncrementalCleanup _incremental;
 
     /**
      * Current traversal ID.
      */
     uintptr_t _traversalId = 0;
 
+    DRCStats _stats;
+
+    CleanupTracer* _tracer = nullptr;
+
 public:
     DRC() = default;
 
@@ -68,6 +277,111 @@ public:
     [[nodiscard]]
     size_t nodeCount() const noexcept { return _nodes.size(); }
 
+    /**
+     * Gets the number of entries in the weak reference side table (including those of deleted objects).
+     *
+     * @return Number of weak reference entries.
+     */
+    [[nodiscard]]
+    size_t weakRefCount() const noexcept { return _weakRefs.size(); }
+
+    /**
+     * Gets the number of buffered candidate roots.
+     *
+     * @return Number of buffered candidate roots.
+     */
+    [[nodiscard]]
+    size_t candidateCount() const noexcept { return _candidates.size(); }
+
+    /**
+     * Gets the candidate root buffer threshold.
+     *
+     * @return Number of candidate roots that triggers a batch collection, 0 if buffering is disabled.
+     */
+    [[nodiscard]]
+    size_t candidateThreshold() const noexcept { return _candidateThreshold; }
+
+    /**
+     * Sets the candidate root buffer threshold.
+     * When non-zero, a release that leaves the referencee alive buffers it as a candidate root instead of cleaning up
+     * immediately, and the buffer is collected once it holds @p threshold candidates. Setting it to 0 disables
+     * buffering, already buffered candidates stay until `collectCandidates` is called.
+     *
+     * @param threshold Number of candidate roots that triggers a batch collection, 0 to disable buffering.
+     */
+    void setCandidateThreshold(size_t threshold) noexcept { _candidateThreshold = threshold; }
+
+    /**
+     * Gets the parallel cleanup threshold.
+     *
+     * @return Number of nodes a cleanup visits sequentially before going parallel, 0 if parallel cleanups are disabled.
+     */
+    [[nodiscard]]
+    size_t parallelThreshold() const noexcept { return _parallelThreshold; }
+
+    /**
+     * Enables parallel cleanups of large subgraphs.
+     * A cleanup that visits more than @p threshold nodes gives up its sequential traversal and runs a parallel trial
+     * deletion over the subgraph instead, with @p workers threads (the calling one included) sharing the traversal
+     * frontier by work stealing. Cleanups of smaller subgraphs stay sequential. The workers are started per parallel
+     * cleanup, so the threshold should be large enough to amortize that.
+     *
+     * @param threshold Number of nodes that makes a cleanup parallel, 0 to disable parallel cleanups.
+     * @param workers Number of worker threads, 0 for one per hardware thread.
+     */
+    void setParallelCleanup(size_t threshold, size_t workers = 0) noexcept;
+
+    /**
+     * Gets the statistics of this DRC graph (all zero unless built with `SPARK_RUNTIME_STATS`).
+     *
+     * @return Statistics of this DRC graph.
+     */
+    [[nodiscard]]
+    const DRCStats& stats() const noexcept { return _stats; }
+
+    void resetStats() noexcept { _stats = {}; }
+
+    /**
+     * Sets the tracer that records the cleanup pauses of this DRC graph (ignored unless built with
+     * `SPARK_RUNTIME_STATS`).
+     *
+     * @param tracer Tracer to record to, nullptr to stop tracing.
+     */
+    void setTracer(CleanupTracer* tracer) noexcept { _tracer = tracer; }
+
+    /**
+     * Calls @p f with the DRC object of every node in this DRC graph, walking the node storage linearly.
+     *
+     * @param f Function to call as `f(DRCHeader* obj)`.
+     */
+    template <typename F>
+    void forEachObject(F&& f) {
+        _nodes.forEachSlot([&](DRCNode& node) {
+            if (node.obj != nullptr) {
+                f(node.obj);
+            }
+        });
+    }
+
+    /**
+     * Calls @p f with every outgoing edge of a node, stored or traced, as `DRCEdgeList::forEach` does.
+     *
+     * @param node DRC node whose edges to walk.
+     * @param f Function to call as `f(DRCNode* referencee, RCInt count)`.
+     */
+    template <typename F>
+    static void forEachEdge(const DRCNode* node, F&& f) {
+        if (!node->traced) {
+            node->referencees->forEach(f);
+            return;
+        }
+        for (size_t offset : node->obj->rcHeader.type->drcFields()) {
+            if (DRCNode* referencee = fieldReferencee(node->obj, offset)) {
+                f(referencee, RCInt{1});
+            }
+        }
+    }
+
     /**
      * Adds a new DRC node to the DRC graph with associated with a given DRC object.
      *
@@ -76,8 +390,17 @@ public:
      */
     DRCNode* add(DRCHeader* obj) noexcept;
 
+    /**
+     * Removes a DRC node from the DRC graph, recycling its storage for later nodes.
+     * The node must no longer be referenced by any other node (e.g. it was returned from a cleanup).
+     *
+     * @param node DRC node to remove.
+     */
+    void remove(DRCNode* node) noexcept;
+
     /**
      * A DRC node references another DRC node.
+     * If the owner is traced, the reference must already be stored in a DRC field of its object.
      *
      * @param owner DRC node that references referencee.
      * @param referencee DRC node that gets referenced by owner.
@@ -86,6 +409,8 @@ public:
 
     /**
      * A DRC node releases (one) reference for the other DRC node.
+     * With candidate buffering enabled, the cleanup from @p referencee may be deferred to a batch collection.
+     * If the owner is traced, the reference must already be cleared from the fields of its object.
      *
      * @param owner DRC node that references referencee.
      * @param referencee DRC node that is referencing by owner.
@@ -93,21 +418,259 @@ public:
      */
     const std::vector<DRCNode*>& release(DRCNode* owner, DRCNode* referencee) noexcept;
 
+    /**
+     * Handles the drop of the last external reference to the object of a node.
+     * Like `release`, the node is cleaned up from right away if it's definitely unreachable (or buffering is disabled),
+     * otherwise it's buffered as a candidate root.
+     *
+     * @param node DRC node whose object is no longer externally referenced.
+     * @return Array of DRC nodes that were deleted.
+     */
+    const std::vector<DRCNode*>& releaseExternal(DRCNode* node) noexcept;
+
+    /**
+     * Weakly references the object of a node.
+     * The weak reference doesn't keep the object alive nor make it reachable, so referencing back (e.g. from a child to
+     * its parent) through weak references forms no cycle to clean up.
+     *
+     * @param node DRC node of the object to weakly reference.
+     * @return Weak reference entry of the object, released with `weakRelease`.
+     */
+    DRCWeakRef* weakRetain(DRCNode* node) noexcept;
+
+    /**
+     * Releases a weak reference, dropping the entry with its last weak reference.
+     *
+     * @param ref Weak reference entry returned by `weakRetain`.
+     */
+    void weakRelease(DRCWeakRef* ref) noexcept;
+
+    /**
+     * Gets the object of a weak reference to upgrade it to a strong one, the caller then adds the external reference.
+     * An incremental cleanup that traversed the object after marking is cancelled (buffering its starting node again),
+     * as its outcome no longer holds. Once the cleanup is dropping its garbage, the object may be part of it: it's
+     * then upgraded only if it survives.
+     *
+     * @param ref Weak reference entry returned by `weakRetain`.
+     * @return Object to reference, nullptr if it has been deleted or is about to be.
+     */
+    DRCHeader* weakUpgrade(DRCWeakRef* ref) noexcept;
+
     /**
      * Tries to start cleaning up from a node.
+     * Finds the strongly connected components of the subgraph reachable from @p from (stopping at externally
+     * referenced nodes) in a single DFS, counting the references each node gets from outside the subgraph on the way.
+     * Components with such references, and everything reachable from them, survive, the rest is deleted. Nothing is
+     * deleted if @p from survives. Internal reference counts are never decremented on trial, only the edges from deleted
+     * nodes to surviving ones are dropped.
+     * Subgraphs larger than the parallel threshold are cleaned up in parallel instead (see `setParallelCleanup`).
      *
      * @param from Node where the cleanup starts.
      * @return Array of DRC nodes that were deleted during the cleanup.
      */
     const std::vector<DRCNode*>& tryCleanup(DRCNode* from) noexcept;
 
+    /**
+     * Tries to clean up from every buffered candidate root and empties the buffer.
+     * Candidates that got externally referenced again in the meantime are skipped.
+     *
+     * @return Array of DRC nodes that were deleted during the collection.
+     */
+    const std::vector<DRCNode*>& collectCandidates() noexcept;
+
+    /**
+     * Takes a candidate root out of the buffer, e.g. to clean up from it incrementally.
+     *
+     * @return Taken candidate root, or nullptr if the buffer is empty.
+     */
+    DRCNode* takeCandidate() noexcept;
+
+    /**
+     * Checks if an incremental cleanup is in progress.
+     *
+     * @return true if an incremental cleanup is in progress, false otherwise.
+     */
+    [[nodiscard]]
+    bool cleanupInProgress() const noexcept { return _incremental.phase != IncrementalCleanup::Phase::Idle; }
+
+    /**
+     * Starts an incremental cleanup from a node, to be advanced with `stepCleanup`.
+     * A cleanup already in progress is cancelled and its starting node is buffered as a candidate root.
+     * The graph may be mutated between steps: retains and releases during marking are accounted for, while mutations
+     * touching the traversed nodes after marking cancel the cleanup (buffering its starting node again).
+     *
+     * @param from Node where the cleanup starts.
+     */
+    void startCleanup(DRCNode* from) noexcept;
+
+    /**
+     * Advances the incremental cleanup by at most @p budget units of work (nodes expanded, scanned, collected or
+     * dropped).
+     *
+     * @param budget Maximum amount of work to do.
+     * @return Status of the cleanup, `Aborted` if no cleanup is in progress.
+     */
+    CleanupStatus stepCleanup(size_t budget) noexcept;
+
+    /**
+     * Gets the DRC nodes deleted by the last incremental cleanup that returned `Collected`.
+     * They're unreachable, no longer buffered nor weakly referenced, and their edges to surviving nodes have been
+     * dropped, so they can be removed at any later time (e.g. a batch per safe point) while other cleanups run.
+     *
+     * @return Array of DRC nodes that were deleted.
+     */
+    [[nodiscard]]
+    const std::deque<DRCNode*>& cleanupResult() const noexcept { return _incremental.collected; }
+
+    /**
+     * Takes the result of the last incremental cleanup that returned `Collected` (see `cleanupResult`), leaving it
+     * empty.
+     *
+     * @param result Array to swap the DRC nodes that were deleted into (cleared first).
+     */
+    void takeCleanupResult(std::deque<DRCNode*>& result) noexcept {
+        result.clear();
+        result.swap(_incremental.collected);
+    }
+
 private:
+    /**
+     * Reads the referencee of a DRC field of an object.
+     *
+     * @return Node of the referencee, nullptr if the field is unset or refers to an object outside of the graph.
+     */
+    static DRCNode* fieldReferencee(const DRCHeader* obj, size_t offset) noexcept {
+        const DRCHeader* referencee = *reinterpret_cast<DRCHeader* const*>(reinterpret_cast<const char*>(obj) + offset);
+        return referencee != nullptr ? referencee->node : nullptr;
+    }
+
+    /**
+     * Advances a cursor over the outgoing edges of a node, stored or traced, as `DRCEdgeList::next` does.
+     */
+    static bool nextEdge(const DRCNode* node, uint32_t& cursor, DRCNode*& referencee, RCInt& count) noexcept {
+        if (!node->traced) {
+            return node->referencees->next(cursor, referencee, count);
+        }
+        const std::vector<size_t>& fields = node->obj->rcHeader.type->drcFields();
+        while (cursor < fields.size()) {
+            referencee = fieldReferencee(node->obj, fields[cursor++]);
+            if (referencee != nullptr) {
+                count = 1;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Checks if a node may have outgoing edges.
+     */
+    static bool mayHaveEdges(const DRCNode* node) noexcept {
+        return node->traced ? !node->obj->rcHeader.type->drcFields().empty() : !node->referencees->empty();
+    }
+
+    /**
+     * Finds the garbage reachable from a node (the algorithm of `tryCleanup`).
+     */
+    const std::vector<DRCNode*>& findGarbage(DRCNode* from) noexcept;
+
+    /**
+     * Finds the garbage reachable from a node with parallel trial deletion.
+     * Workers discover the subgraph (claiming each node with its traversal ID), number it, subtract the internal edges
+     * from atomic trial counts, propagate liveness from the nodes with remaining references, and collect the rest into
+     * their own buffers, each phase separated by a barrier. Like `findGarbage`, only scratch state is written until the
+     * buffers are merged.
+     */
+    const std::vector<DRCNode*>& findGarbageParallel(DRCNode* from) noexcept;
+
+    /**
+     * Runs the phases of the incremental cleanup (the loop of `stepCleanup`), consuming @p budget.
+     */
+    CleanupStatus runCleanup(size_t& budget) noexcept;
+
+    /**
+     * Cleans up from a node that lost a reference if it's definitely unreachable, buffers it as a candidate root
+     * otherwise (collecting the candidates once there are enough).
+     */
+    const std::vector<DRCNode*>& releaseCandidate(DRCNode* node) noexcept;
+
+    /**
+     * Adds a node to the candidate root buffer (if not buffered yet).
+     *
+     * @param node Node to buffer.
+     */
+    void bufferCandidate(DRCNode* node) noexcept;
+
+    /**
+     * Removes a node from the candidate root buffer (if buffered).
+     *
+     * @param node Node to unbuffer.
+     */
+    void unbufferCandidate(DRCNode* node) noexcept;
+
+    /**
+     * Checks if a node has been touched by the incremental cleanup in progress.
+     */
+    [[nodiscard]]
+    bool touchedByCleanup(const DRCNode* node) const noexcept {
+        return cleanupInProgress() && node->cleanupId == _incremental.id;
+    }
+
+    /**
+     * Checks if the incremental cleanup in progress can still be cancelled by mutations. Once the garbage is known
+     * (dropping its edges), the mutator can't reach it anymore, so mutations can't change the outcome.
+     */
+    [[nodiscard]]
+    bool cleanupCancellable() const noexcept {
+        return cleanupInProgress() && _incremental.phase != IncrementalCleanup::Phase::Drop;
+    }
+
+    /**
+     * Touches a node in the incremental cleanup, initializing its trial count.
+     */
+    void touchInCleanup(DRCNode* node) noexcept;
+
+    /**
+     * Marks a node as live in the incremental cleanup.
+     *
+     * @return false if the starting node became live (so nothing can be collected), true otherwise.
+     */
+    bool markLiveInCleanup(DRCNode* node) noexcept;
+
+    /**
+     * Cancels the incremental cleanup in progress.
+     *
+     * @param requeue Whether to buffer the starting node as a candidate root again.
+     */
+    void cancelCleanup(bool requeue) noexcept;
+
+    /**
+     * Advances a phase of the incremental cleanup, consuming @p budget.
+     *
+     * @param budget Remaining amount of work (updated).
+     * @return false if the cleanup found nothing to collect, true otherwise.
+     */
+    bool stepMark(size_t& budget) noexcept;
+    bool stepScan(size_t& budget) noexcept;
+    bool stepCollect(size_t& budget) noexcept;
+    bool stepDrop(size_t& budget) noexcept;
+
     /**
      * Gets a new traversal traversal ID.
      *
      * @return New traversal ID.
      */
     uintptr_t getNewTraversalId() noexcept;
+
+    /**
+     * Visits a node in `tryCleanup`, pushing its DFS frame.
+     * Nodes without edges to expand form an SCC on their own right away.
+     *
+     * @param node Node to visit.
+     * @param traversalId ID of the traversal.
+     * @return Index of the node in the scratch state.
+     */
+    uint32_t visit(DRCNode* node, uintptr_t traversalId);
 };
 
 } // Spark::Runtime
@@ -0,0 +1,141 @@
+#include "drc_edge_list.hpp"
+
+#include <utility>
+
+namespace Spark::Runtime {
+
+/**
+ * Capacity of the hash table when the inline edges first spill.
+ */
+static constexpr uint32_t InitialTableCapacity = 16;
+
+DRCEdgeList::DRCEdgeList(DRCEdgeList&& other) noexcept : _table(nullptr) {
+    *this = std::move(other);
+}
+
+DRCEdgeList& DRCEdgeList::operator=(DRCEdgeList&& other) noexcept {
+    if (this != &other) {
+        clear();
+        if (other.spilled()) {
+            _table = std::exchange(other._table, nullptr);
+        } else {
+            for (uint32_t i = 0; i < other._size; ++i) {
+                _inline[i] = other._inline[i];
+            }
+        }
+        _size = std::exchange(other._size, 0);
+        _capacity = std::exchange(other._capacity, 0);
+    }
+    return *this;
+}
+
+void DRCEdgeList::add(DRCNode* node) {
+    if (!spilled()) {
+        if (_size < InlineCapacity) {
+            _inline[_size++] = node;
+            return;
+        }
+        rehash(InitialTableCapacity);
+    } else if ((_size + 1) * 4 > _capacity * 3) {
+        rehash(_capacity * 2);
+    }
+    insertCounted(node, 1);
+}
+
+bool DRCEdgeList::remove(DRCNode* node) noexcept {
+    if (!spilled()) {
+        // Swap remove
+        for (uint32_t i = 0; i < _size; ++i) {
+            if (_inline[i] == node) {
+                _inline[i] = _inline[--_size];
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Find the slot of the node
+    const uint32_t mask = _capacity - 1;
+    uint32_t i = slotOf(node);
+    while (_table[i].node != node) {
+        if (_table[i].node == nullptr) {
+            return false;
+        }
+        i = (i + 1) & mask;
+    }
+    if (--_table[i].count > 0) {
+        return true;
+    }
+
+    // Backward shift deletion, so lookups never need tombstones
+    --_size;
+    uint32_t hole = i;
+    for (uint32_t j = (i + 1) & mask; _table[j].node != nullptr; j = (j + 1) & mask) {
+        uint32_t home = slotOf(_table[j].node);
+        // Move the entry into the hole unless its home lies cyclically within (hole, j]
+        if (((j - home) & mask) >= ((j - hole) & mask)) {
+            _table[hole] = _table[j];
+            hole = j;
+        }
+    }
+    _table[hole] = DRCEdge{nullptr, 0};
+    return true;
+}
+
+void DRCEdgeList::clear() noexcept {
+    if (spilled()) {
+        delete[] _table;
+        _table = nullptr;
+        _capacity = 0;
+    }
+    _size = 0;
+}
+
+void DRCEdgeList::insertCounted(DRCNode* node, RCInt count) noexcept {
+    const uint32_t mask = _capacity - 1;
+    uint32_t i = slotOf(node);
+    while (_table[i].node != nullptr) {
+        if (_table[i].node == node) {
+            _table[i].count += count;
+            return;
+        }
+        i = (i + 1) & mask;
+    }
+    _table[i] = DRCEdge{node, count};
+    ++_size;
+}
+
+void DRCEdgeList::rehash(uint32_t capacity) {
+    DRCEdge* table = new DRCEdge[capacity]();
+
+    // Swap in the new table, then re-insert the old edges
+    DRCNode* inlineEdges[InlineCapacity];
+    DRCEdge* oldTable = nullptr;
+    const uint32_t oldSize = _size;
+    const uint32_t oldCapacity = _capacity;
+    if (spilled()) {
+        oldTable = _table;
+    } else {
+        for (uint32_t i = 0; i < oldSize; ++i) {
+            inlineEdges[i] = _inline[i];
+        }
+    }
+    _table = table;
+    _capacity = capacity;
+    _size = 0;
+
+    if (oldTable == nullptr) {
+        for (uint32_t i = 0; i < oldSize; ++i) {
+            insertCounted(inlineEdges[i], 1);
+        }
+        return;
+    }
+    for (uint32_t i = 0; i < oldCapacity; ++i) {
+        if (oldTable[i].node != nullptr) {
+            insertCounted(oldTable[i].node, oldTable[i].count);
+        }
+    }
+    delete[] oldTable;
+}
+
+} // Spark::Runtime
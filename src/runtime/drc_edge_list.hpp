@@ -0,0 +1,164 @@
+#pragma once
+
+#include <cstdint>
+
+#include "rc.hpp"
+
+namespace Spark::Runtime {
+
+struct DRCNode;
+
+/**
+ * Represents a counted edge: a referencee and how many times it is referenced.
+ */
+struct DRCEdge {
+    DRCNode* node;
+    RCInt count;
+};
+
+/**
+ * Represents the outgoing edges of a DRC node.
+ * Up to `InlineCapacity` edges are stored inline (duplicates stored separately). Beyond that the list spills to a heap
+ * hash table of counted edges, so adding or removing an edge stays O(1) however wide the fan-out gets.
+ */
+class DRCEdgeList {
+public:
+    static constexpr uint32_t InlineCapacity = 4;
+
+private:
+    union {
+        DRCNode* _inline[InlineCapacity];
+        DRCEdge* _table;
+    };
+
+    /**
+     * Number of inline edges, or number of distinct referencees when spilled.
+     */
+    uint32_t _size = 0;
+
+    /**
+     * Capacity of the hash table (a power of two), 0 if the edges are inline.
+     */
+    uint32_t _capacity = 0;
+
+public:
+    DRCEdgeList() noexcept : _table(nullptr) { }
+
+    ~DRCEdgeList() noexcept {
+        clear();
+    }
+
+    DRCEdgeList(const DRCEdgeList& other) = delete;
+    DRCEdgeList& operator=(const DRCEdgeList& other) = delete;
+
+    DRCEdgeList(DRCEdgeList&& other) noexcept;
+    DRCEdgeList& operator=(DRCEdgeList&& other) noexcept;
+
+    /**
+     * Checks if there's no edge.
+     *
+     * @return true if there's no edge, false otherwise.
+     */
+    [[nodiscard]]
+    bool empty() const noexcept { return _size == 0; }
+
+    /**
+     * Checks if the edges have spilled to the heap as counted edges.
+     *
+     * @return true if spilled, false if the edges are inline.
+     */
+    [[nodiscard]]
+    bool spilled() const noexcept { return _capacity != 0; }
+
+    /**
+     * Adds one edge to @p node.
+     *
+     * @param node Referencee of the edge.
+     */
+    void add(DRCNode* node);
+
+    /**
+     * Removes one edge to @p node.
+     *
+     * @param node Referencee of the edge.
+     * @return true if an edge was removed, false if there's no edge to @p node.
+     */
+    bool remove(DRCNode* node) noexcept;
+
+    /**
+     * Removes every edge and releases the heap storage (if any).
+     */
+    void clear() noexcept;
+
+    /**
+     * Calls @p f with every referencee and the number of edges to it.
+     * Inline duplicates are reported separately with a count of 1.
+     *
+     * @param f Function to call as `f(DRCNode* node, RCInt count)`.
+     */
+    template <typename F>
+    void forEach(F&& f) const {
+        if (!spilled()) {
+            for (uint32_t i = 0; i < _size; ++i) {
+                f(_inline[i], RCInt{1});
+            }
+            return;
+        }
+        for (uint32_t i = 0; i < _capacity; ++i) {
+            if (_table[i].node != nullptr) {
+                f(_table[i].node, _table[i].count);
+            }
+        }
+    }
+
+    /**
+     * Advances a cursor over the edges, for iterations that can't use a callback (e.g. resumable DFS frames).
+     * Edges are reported the same way as `forEach`.
+     *
+     * @param cursor Cursor to advance, starts at 0.
+     * @param node Referencee of the next edge (written on success).
+     * @param count Number of edges to @p node (written on success).
+     * @return true if an edge was read, false if the cursor reached the end.
+     */
+    bool next(uint32_t& cursor, DRCNode*& node, RCInt& count) const noexcept {
+        if (!spilled()) {
+            if (cursor >= _size) {
+                return false;
+            }
+            node = _inline[cursor++];
+            count = 1;
+            return true;
+        }
+        while (cursor < _capacity) {
+            const DRCEdge& edge = _table[cursor++];
+            if (edge.node != nullptr) {
+                node = edge.node;
+                count = edge.count;
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    /**
+     * Gets the home slot of @p node in the hash table.
+     */
+    [[nodiscard]]
+    uint32_t slotOf(const DRCNode* node) const noexcept {
+        auto h = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(node) >> 4) * 0x9E3779B97F4A7C15ull;
+        return static_cast<uint32_t>(h >> 32) & (_capacity - 1);
+    }
+
+    /**
+     * Adds @p count edges to @p node in the hash table (which must have room).
+     */
+    void insertCounted(DRCNode* node, RCInt count) noexcept;
+
+    /**
+     * Moves the edges to a hash table of @p capacity slots.
+     */
+    void rehash(uint32_t capacity);
+};
+
+} // Spark::Runtime
@@ -0,0 +1,283 @@
+#include "heap_snapshot.hpp"
+
+#include <algorithm>
+#include <utility>
+
+namespace Spark::Runtime {
+
+namespace {
+    constexpr char Magic[8] = { 'S', 'P', 'K', 'H', 'E', 'A', 'P', '1' };
+
+    void put(std::ostream& out, uint64_t value, int bytes) {
+        char buffer[8];
+        for (int i = 0; i < bytes; ++i) {
+            buffer[i] = static_cast<char>(value >> (8 * i));
+        }
+        out.write(buffer, bytes);
+    }
+
+    template <typename T>
+    bool get(std::istream& in, T& value) {
+        unsigned char buffer[sizeof(T)];
+        if (!in.read(reinterpret_cast<char*>(buffer), sizeof(T))) {
+            return false;
+        }
+        uint64_t result = 0;
+        for (size_t i = 0; i < sizeof(T); ++i) {
+            result |= static_cast<uint64_t>(buffer[i]) << (8 * i);
+        }
+        value = static_cast<T>(result);
+        return true;
+    }
+
+    /**
+     * Adjacency lists in compressed form: the targets of node `i` are `targets[offsets[i]..offsets[i + 1]]`.
+     */
+    struct Adjacency {
+        std::vector<uint32_t> offsets;
+        std::vector<uint32_t> targets;
+
+        template <typename F>
+        void build(size_t nodeCount, size_t edgeCount, F&& forEachEdge) {
+            offsets.assign(nodeCount + 1, 0);
+            forEachEdge([&](uint32_t from, uint32_t) { ++offsets[from + 1]; });
+            for (size_t i = 0; i < nodeCount; ++i) {
+                offsets[i + 1] += offsets[i];
+            }
+            targets.resize(edgeCount);
+            std::vector<uint32_t> cursors(offsets.begin(), offsets.end() - 1);
+            forEachEdge([&](uint32_t from, uint32_t to) { targets[cursors[from]++] = to; });
+        }
+    };
+}
+
+void writeHeapSnapshot(std::ostream& out, const HeapSnapshot& snapshot) {
+    out.write(Magic, sizeof(Magic));
+    put(out, snapshot.objects.size(), 8);
+    for (const HeapSnapshot::Object& object : snapshot.objects) {
+        put(out, object.address, 8);
+        put(out, object.type, 4);
+        put(out, object.size, 4);
+        put(out, object.flags, 4);
+        put(out, object.refCount, 8);
+        put(out, object.internalRefCount, 8);
+    }
+    put(out, snapshot.edges.size(), 8);
+    for (const HeapSnapshot::Edge& edge : snapshot.edges) {
+        put(out, edge.from, 4);
+        put(out, edge.to, 4);
+        put(out, edge.count, 4);
+    }
+}
+
+bool readHeapSnapshot(std::istream& in, HeapSnapshot& snapshot) {
+    char magic[sizeof(Magic)];
+    if (!in.read(magic, sizeof(magic)) || !std::equal(magic, magic + sizeof(magic), Magic)) {
+        return false;
+    }
+
+    uint64_t objectCount;
+    if (!get(in, objectCount) || objectCount >= HeapAnalysis::Unreachable) {
+        return false;
+    }
+    snapshot.objects.clear();
+    for (uint64_t i = 0; i < objectCount; ++i) {
+        HeapSnapshot::Object object{};
+        if (!get(in, object.address) || !get(in, object.type) || !get(in, object.size) ||
+            !get(in, object.flags) || !get(in, object.refCount) || !get(in, object.internalRefCount)) {
+            return false;
+        }
+        snapshot.objects.push_back(object);
+    }
+
+    uint64_t edgeCount;
+    if (!get(in, edgeCount)) {
+        return false;
+    }
+    snapshot.edges.clear();
+    for (uint64_t i = 0; i < edgeCount; ++i) {
+        HeapSnapshot::Edge edge{};
+        if (!get(in, edge.from) || !get(in, edge.to) || !get(in, edge.count) ||
+            edge.from >= objectCount || edge.to >= objectCount) {
+            return false;
+        }
+        snapshot.edges.push_back(edge);
+    }
+    return true;
+}
+
+HeapAnalysis analyzeHeapSnapshot(const HeapSnapshot& snapshot) {
+    constexpr uint32_t Undefined = UINT32_MAX;
+
+    const auto n = static_cast<uint32_t>(snapshot.objects.size());
+    const std::vector<HeapSnapshot::Object>& objects = snapshot.objects;
+    const std::vector<HeapSnapshot::Edge>& edges = snapshot.edges;
+
+    // Node n is the virtual root, referencing every externally referenced object
+    size_t rootCount = 0;
+    for (const HeapSnapshot::Object& object : objects) {
+        rootCount += object.refCount > 0 ? 1 : 0;
+    }
+    auto forEachEdge = [&](auto&& f) {
+        for (uint32_t i = 0; i < n; ++i) {
+            if (objects[i].refCount > 0) {
+                f(n, i);
+            }
+        }
+        for (const HeapSnapshot::Edge& edge : edges) {
+            f(edge.from, edge.to);
+        }
+    };
+    Adjacency successors;
+    successors.build(n + 1, rootCount + edges.size(), forEachEdge);
+    Adjacency predecessors;
+    predecessors.build(n + 1, rootCount + edges.size(), [&](auto&& f) {
+        forEachEdge([&](uint32_t from, uint32_t to) { f(to, from); });
+    });
+
+    // Postorder of a DFS from the virtual root
+    std::vector<uint32_t> postorder;
+    std::vector<uint32_t> postIndex(n + 1, Undefined);
+    {
+        std::vector<uint8_t> seen(n + 1, 0);
+        std::vector<std::pair<uint32_t, uint32_t>> frames;
+        frames.emplace_back(n, successors.offsets[n]);
+        seen[n] = 1;
+        while (!frames.empty()) {
+            auto& [v, cursor] = frames.back();
+            if (cursor < successors.offsets[v + 1]) {
+                const uint32_t w = successors.targets[cursor++];
+                if (!seen[w]) {
+                    seen[w] = 1;
+                    frames.emplace_back(w, successors.offsets[w]);
+                }
+                continue;
+            }
+            postIndex[v] = static_cast<uint32_t>(postorder.size());
+            postorder.push_back(v);
+            frames.pop_back();
+        }
+    }
+
+    // Immediate dominators (Cooper, Harvey and Kennedy's iterative algorithm over the reverse postorder)
+    std::vector<uint32_t> idom(n + 1, Undefined);
+    idom[n] = n;
+    auto intersect = [&](uint32_t a, uint32_t b) {
+        while (a != b) {
+            while (postIndex[a] < postIndex[b]) {
+                a = idom[a];
+            }
+            while (postIndex[b] < postIndex[a]) {
+                b = idom[b];
+            }
+        }
+        return a;
+    };
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t i = postorder.size() - 1; i-- > 0;) {
+            const uint32_t v = postorder[i];
+            uint32_t newIdom = Undefined;
+            for (uint32_t j = predecessors.offsets[v]; j < predecessors.offsets[v + 1]; ++j) {
+                const uint32_t p = predecessors.targets[j];
+                if (idom[p] != Undefined) {
+                    newIdom = newIdom == Undefined ? p : intersect(p, newIdom);
+                }
+            }
+            if (idom[v] != newIdom) {
+                idom[v] = newIdom;
+                changed = true;
+            }
+        }
+    }
+
+    HeapAnalysis analysis;
+    analysis.dominators.resize(n);
+    analysis.retainedSizes.assign(n, 0);
+    std::vector<uint64_t> retained(n + 1, 0);
+    // Dominators finish after the objects they dominate
+    for (uint32_t v : postorder) {
+        if (v == n) {
+            continue;
+        }
+        retained[v] += objects[v].size;
+        retained[idom[v]] += retained[v];
+        analysis.retainedSizes[v] = retained[v];
+        analysis.dominators[v] = idom[v] == n ? HeapAnalysis::Root : idom[v];
+    }
+    analysis.reachableSize = retained[n];
+    for (uint32_t v = 0; v < n; ++v) {
+        if (postIndex[v] == Undefined) {
+            analysis.dominators[v] = HeapAnalysis::Unreachable;
+            analysis.unreachableSize += objects[v].size;
+            ++analysis.unreachableCount;
+        }
+    }
+
+    // Cycles are the strongly connected components with an internal edge (Tarjan's SCC)
+    std::vector<uint8_t> selfLoop(n, 0);
+    for (const HeapSnapshot::Edge& edge : edges) {
+        if (edge.from == edge.to) {
+            selfLoop[edge.from] = 1;
+        }
+    }
+    std::vector<uint32_t> index(n, Undefined);
+    std::vector<uint32_t> low(n, 0);
+    std::vector<uint8_t> onStack(n, 0);
+    std::vector<uint32_t> stack;
+    std::vector<std::pair<uint32_t, uint32_t>> frames;
+    uint32_t nextIndex = 0;
+    for (uint32_t start = 0; start < n; ++start) {
+        if (index[start] != Undefined) {
+            continue;
+        }
+        auto visit = [&](uint32_t v) {
+            index[v] = low[v] = nextIndex++;
+            stack.push_back(v);
+            onStack[v] = 1;
+            frames.emplace_back(v, successors.offsets[v]);
+        };
+        visit(start);
+        while (!frames.empty()) {
+            auto& [v, cursor] = frames.back();
+            if (cursor < successors.offsets[v + 1]) {
+                const uint32_t w = successors.targets[cursor++];
+                if (index[w] == Undefined) {
+                    visit(w);
+                } else if (onStack[w]) {
+                    low[v] = std::min(low[v], index[w]);
+                }
+                continue;
+            }
+
+            const uint32_t finished = v;
+            frames.pop_back();
+            if (!frames.empty()) {
+                low[frames.back().first] = std::min(low[frames.back().first], low[finished]);
+            }
+            if (low[finished] != index[finished]) {
+                continue;
+            }
+            HeapAnalysis::Cycle cycle;
+            uint32_t w;
+            do {
+                w = stack.back();
+                stack.pop_back();
+                onStack[w] = 0;
+                cycle.objects.push_back(w);
+                cycle.size += objects[w].size;
+            } while (w != finished);
+            if (cycle.objects.size() > 1 || selfLoop[finished]) {
+                analysis.cycles.push_back(std::move(cycle));
+            }
+        }
+    }
+    std::stable_sort(analysis.cycles.begin(), analysis.cycles.end(), [](const auto& a, const auto& b) {
+        return a.size > b.size;
+    });
+
+    return analysis;
+}
+
+} // Spark::Runtime
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+namespace Spark::Runtime {
+
+/**
+ * Snapshot of the objects of a thread and the DRC edges between them (see `Thread::heapSnapshot`).
+ */
+struct HeapSnapshot {
+    enum ObjectFlag : uint32_t {
+        /**
+         * The object uses double reference counting (RC objects have no edges in the snapshot).
+         */
+        DRCObject = 1 << 0,
+        /**
+         * The object is in the nursery (not promoted yet).
+         */
+        Young = 1 << 1,
+    };
+
+    struct Object {
+        uint64_t address;
+        /**
+         * Index of the type of the object, see `Type::index`.
+         */
+        uint32_t type;
+        /**
+         * Allocated size in bytes.
+         */
+        uint32_t size;
+        uint32_t flags;
+        /**
+         * External references (for RC objects, every reference).
+         */
+        uint64_t refCount;
+        /**
+         * References from DRC objects.
+         */
+        uint64_t internalRefCount;
+    };
+
+    struct Edge {
+        /**
+         * Indices of the owner and the referencee in `objects`.
+         */
+        uint32_t from;
+        uint32_t to;
+        /**
+         * Number of references.
+         */
+        uint32_t count;
+    };
+
+    std::vector<Object> objects;
+    std::vector<Edge> edges;
+};
+
+/**
+ * Writes a heap snapshot in its binary format: the magic `SPKHEAP1`, the object count, the objects, the edge count and
+ * the edges, every field in little-endian order with the width of `HeapSnapshot::Object` and `HeapSnapshot::Edge`
+ * (counts are 64-bit).
+ *
+ * @param out Stream to write to (opened in binary mode).
+ * @param snapshot Snapshot to write.
+ */
+void writeHeapSnapshot(std::ostream& out, const HeapSnapshot& snapshot);
+
+/**
+ * Reads a heap snapshot written by `writeHeapSnapshot`.
+ *
+ * @param in Stream to read from (opened in binary mode).
+ * @param snapshot Snapshot to read into.
+ * @return true if succeeded, false if the stream is not a valid heap snapshot.
+ */
+bool readHeapSnapshot(std::istream& in, HeapSnapshot& snapshot);
+
+/**
+ * What keeps the memory of a heap snapshot alive.
+ * Externally referenced objects are the roots of the heap. An object dominates another if every path from the roots to
+ * the other goes through it, and its retained size is the memory that would be freed with it (its own size plus the
+ * sizes of the objects it dominates).
+ */
+struct HeapAnalysis {
+    /**
+     * Value of `dominators` for roots (dominated by the virtual root of the heap).
+     */
+    static constexpr uint32_t Root = UINT32_MAX;
+
+    /**
+     * Value of `dominators` for objects unreachable from the roots (garbage not collected yet).
+     */
+    static constexpr uint32_t Unreachable = UINT32_MAX - 1;
+
+    /**
+     * Strongly connected component of more than one object (or an object referencing itself).
+     */
+    struct Cycle {
+        std::vector<uint32_t> objects;
+        uint64_t size = 0;
+    };
+
+    /**
+     * Immediate dominator of each object, indexed like `HeapSnapshot::objects`.
+     */
+    std::vector<uint32_t> dominators;
+
+    /**
+     * Retained size of each object in bytes, 0 for unreachable objects.
+     */
+    std::vector<uint64_t> retainedSizes;
+
+    /**
+     * Every cycle, largest (in bytes) first.
+     */
+    std::vector<Cycle> cycles;
+
+    uint64_t reachableSize = 0;
+    uint64_t unreachableSize = 0;
+    size_t unreachableCount = 0;
+};
+
+/**
+ * Computes the dominator tree, the retained sizes and the cycles of a heap snapshot.
+ *
+ * @param snapshot Snapshot to analyze.
+ * @return Analysis of the snapshot.
+ */
+HeapAnalysis analyzeHeapSnapshot(const HeapSnapshot& snapshot);
+
+} // Spark::Runtime
@@ -0,0 +1,98 @@
+﻿#include "nursery.hpp"
+
+#include <cstdlib>
+#include <utility>
+
+namespace Spark::Runtime {
+
+namespace {
+    constexpr size_t alignUp(size_t size) noexcept {
+        return (size + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t);
+    }
+}
+
+Nursery::~Nursery() noexcept {
+    std::free(_base);
+}
+
+Nursery::Nursery(Nursery&& other) noexcept
+    : _base(std::exchange(other._base, nullptr)),
+      _size(std::exchange(other._size, 0)),
+      _chunks(std::move(other._chunks)),
+      _freeChunks(std::move(other._freeChunks)),
+      _youngChunks(std::move(other._youngChunks)),
+      _current(std::exchange(other._current, NoChunk)) { }
+
+bool Nursery::reserve(size_t size) noexcept {
+    if (_base != nullptr) {
+        return true;
+    }
+    const size_t chunkCount = (size + ChunkSize - 1) / ChunkSize;
+    _base = static_cast<char*>(std::malloc(chunkCount * ChunkSize));
+    if (_base == nullptr) {
+        return false;
+    }
+    _size = chunkCount * ChunkSize;
+    _chunks.assign(chunkCount, ChunkInfo{});
+    // Handed out from the back, so in address order
+    for (size_t i = chunkCount; i-- > 0;) {
+        _freeChunks.push_back(static_cast<uint32_t>(i));
+    }
+    return true;
+}
+
+void* Nursery::alloc(size_t size, Kind kind) noexcept {
+    const size_t total = alignUp(sizeof(ObjectHeader) + size);
+    if (total > LargeSize) {
+        return nullptr;
+    }
+    if ((_current == NoChunk || ChunkSize - _chunks[_current].end < total) && !nextChunk()) {
+        return nullptr;
+    }
+
+    ChunkInfo& chunk = _chunks[_current];
+    auto* header = reinterpret_cast<ObjectHeader*>(chunkBase(_current) + chunk.end);
+    header->size = static_cast<uint32_t>(total);
+    header->kind = kind;
+    header->state = State::Young;
+    chunk.end += static_cast<uint32_t>(total);
+    chunk.live++;
+    if (!chunk.hasYoung) {
+        chunk.hasYoung = true;
+        _youngChunks.push_back(_current);
+    }
+    return header + 1;
+}
+
+void Nursery::free(void* p) noexcept {
+    headerOf(p)->state = State::Dead;
+    const auto index = static_cast<uint32_t>((static_cast<char*>(p) - _base) / ChunkSize);
+    if (--_chunks[index].live == 0 && index != _current) {
+        releaseChunk(index);
+    }
+}
+
+bool Nursery::nextChunk() noexcept {
+    if (_current != NoChunk) {
+        const uint32_t old = _current;
+        _current = NoChunk;
+        if (_chunks[old].live == 0) {
+            releaseChunk(old);
+        }
+    }
+    if (_freeChunks.empty()) {
+        return false;
+    }
+    _current = _freeChunks.back();
+    _freeChunks.pop_back();
+    return true;
+}
+
+void Nursery::releaseChunk(uint32_t index) noexcept {
+    ChunkInfo& chunk = _chunks[index];
+    chunk.youngBegin = 0;
+    chunk.end = 0;
+    _freeChunks.push_back(index);
+}
+
+} // Spark::Runtime
@@ -0,0 +1,206 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Spark::Runtime {
+
+/**
+ * Young space of a thread: a fixed range of memory, split in chunks, where new objects are bump-allocated.
+ * Objects never move. Dead objects are dropped one by one (a counter per chunk), and a chunk whose objects are all dead
+ * is reused as a whole. Objects that survive a minor collection are promoted in place, their chunk is reused once
+ * they die. Allocations fail once every chunk is in use, the caller then allocates elsewhere.
+ */
+class Nursery {
+public:
+    /**
+     * Size of a chunk in bytes.
+     */
+    static constexpr size_t ChunkSize = 64 * 1024;
+
+    /**
+     * Default size of a nursery in bytes.
+     */
+    static constexpr size_t DefaultSize = 16 * ChunkSize;
+
+    /**
+     * Largest allocation (with its header) served by the nursery.
+     */
+    static constexpr size_t LargeSize = ChunkSize / 4;
+
+    enum class Kind : uint8_t { RC, DRC };
+
+    enum class State : uint8_t { Young, Promoted, Dead };
+
+    /**
+     * Header preceding every allocation in the nursery, so that chunks can be walked.
+     */
+    struct alignas(std::max_align_t) ObjectHeader {
+        /**
+         * Size of the allocation in bytes, header included.
+         */
+        uint32_t size;
+        Kind kind;
+        State state;
+    };
+
+private:
+    struct ChunkInfo {
+        /**
+         * Number of objects that are not dead.
+         */
+        uint32_t live = 0;
+        /**
+         * Offset of the first object allocated since the last minor collection.
+         */
+        uint32_t youngBegin = 0;
+        /**
+         * Offset of the end of the last object.
+         */
+        uint32_t end = 0;
+        /**
+         * Whether the chunk is in `_youngChunks` (kept when the chunk is released, so a reused chunk is listed once).
+         */
+        bool hasYoung = false;
+    };
+
+    char* _base = nullptr;
+    size_t _size = 0;
+
+    std::vector<ChunkInfo> _chunks;
+    std::vector<uint32_t> _freeChunks;
+
+    /**
+     * Chunks that got objects since the last minor collection.
+     */
+    std::vector<uint32_t> _youngChunks;
+
+    /**
+     * Chunk objects are bump-allocated from, `NoChunk` if none.
+     */
+    uint32_t _current = NoChunk;
+
+    static constexpr uint32_t NoChunk = UINT32_MAX;
+
+public:
+    Nursery() noexcept = default;
+
+    ~Nursery() noexcept;
+
+    Nursery(const Nursery& other) = delete;
+    Nursery& operator=(const Nursery& other) = delete;
+
+    Nursery(Nursery&& other) noexcept;
+    Nursery& operator=(Nursery&& other) = delete;
+
+    /**
+     * Reserves the memory of the nursery (rounded up to whole chunks). Does nothing if already reserved.
+     *
+     * @param size Size of the nursery in bytes.
+     * @return true if the nursery is reserved, false if out of memory.
+     */
+    bool reserve(size_t size) noexcept;
+
+    /**
+     * Checks if the nursery has been reserved.
+     *
+     * @return true if the nursery has memory, false otherwise.
+     */
+    [[nodiscard]]
+    bool reserved() const noexcept { return _base != nullptr; }
+
+    /**
+     * Allocates a young object, aligned to `alignof(std::max_align_t)`.
+     *
+     * @param size Size of the object in bytes.
+     * @param kind Kind of the object, for walks.
+     * @return Pointer to the object, or nullptr if the nursery is full, not reserved or @p size is too large.
+     */
+    void* alloc(size_t size, Kind kind) noexcept;
+
+    /**
+     * Frees an object of the nursery, reusing its chunk if it was the last object alive in it.
+     *
+     * @param p Pointer to the object.
+     */
+    void free(void* p) noexcept;
+
+    /**
+     * Checks if a pointer points into the nursery.
+     *
+     * @param p Pointer to check.
+     * @return true if @p p points into the nursery, false otherwise.
+     */
+    [[nodiscard]]
+    bool contains(const void* p) const noexcept {
+        const char* c = static_cast<const char*>(p);
+        return c >= _base && c < _base + _size;
+    }
+
+    static ObjectHeader* headerOf(void* p) noexcept {
+        return static_cast<ObjectHeader*>(p) - 1;
+    }
+
+    /**
+     * Calls @p f with the header of every young object, oldest first.
+     *
+     * @param f Function to call as `f(ObjectHeader* header)`.
+     */
+    template <typename F>
+    void forEachYoung(F&& f) const {
+        for (uint32_t index : _youngChunks) {
+            const ChunkInfo& chunk = _chunks[index];
+            char* p = chunkBase(index) + chunk.youngBegin;
+            char* end = chunkBase(index) + chunk.end;
+            while (p < end) {
+                auto* header = reinterpret_cast<ObjectHeader*>(p);
+                p += header->size;
+                if (header->state == State::Young) {
+                    f(header);
+                }
+            }
+        }
+    }
+
+    /**
+     * Calls @p f with the header of every young object, oldest first, then considers them all old: @p f has to either
+     * promote (set its state to `Promoted`) or `free` each of them.
+     *
+     * @param f Function to call as `f(ObjectHeader* header)`.
+     */
+    template <typename F>
+    void collectYoung(F&& f) {
+        forEachYoung(f);
+        for (uint32_t index : _youngChunks) {
+            ChunkInfo& chunk = _chunks[index];
+            chunk.youngBegin = chunk.end;
+            chunk.hasYoung = false;
+        }
+        _youngChunks.clear();
+    }
+
+    /**
+     * Gets the number of chunks neither in use nor current.
+     *
+     * @return Number of free chunks.
+     */
+    [[nodiscard]]
+    size_t freeChunkCount() const noexcept { return _freeChunks.size(); }
+
+private:
+    char* chunkBase(uint32_t index) const noexcept {
+        return _base + static_cast<size_t>(index) * ChunkSize;
+    }
+
+    /**
+     * Makes a free chunk the current one.
+     *
+     * @return true if succeeded, false if every chunk is in use.
+     */
+    bool nextChunk() noexcept;
+
+    void releaseChunk(uint32_t index) noexcept;
+};
+
+} // Spark::Runtime
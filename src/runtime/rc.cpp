@@ -0,0 +1,56 @@
+#include "rc.hpp"
+
+#include <mutex>
+#include <unordered_map>
+
+namespace Spark::Runtime {
+
+namespace {
+    /**
+     * Counts past `RefCountOverflow` of the objects that reached it. Objects only get there with billions of references
+     * to them, so a single locked map is enough.
+     */
+    struct OverflowTable {
+        std::mutex mutex;
+        std::unordered_map<const RCHeader*, RCInt> counts;
+    };
+
+    OverflowTable& overflowTable() noexcept {
+        static OverflowTable table;
+        return table;
+    }
+}
+
+void incrementOverflowRefCount(const RCHeader* obj) noexcept {
+    OverflowTable& table = overflowTable();
+    std::lock_guard lock(table.mutex);
+    ++table.counts[obj];
+}
+
+bool decrementOverflowRefCount(const RCHeader* obj) noexcept {
+    OverflowTable& table = overflowTable();
+    std::lock_guard lock(table.mutex);
+    auto it = table.counts.find(obj);
+    if (it == table.counts.end()) {
+        return false;
+    }
+    if (--it->second == 0) {
+        table.counts.erase(it);
+    }
+    return true;
+}
+
+RCInt overflowRefCount(const RCHeader* obj) noexcept {
+    OverflowTable& table = overflowTable();
+    std::lock_guard lock(table.mutex);
+    auto it = table.counts.find(obj);
+    return it != table.counts.end() ? it->second : 0;
+}
+
+void clearOverflowRefCount(const RCHeader* obj) noexcept {
+    OverflowTable& table = overflowTable();
+    std::lock_guard lock(table.mutex);
+    table.counts.erase(obj);
+}
+
+} // Spark::Runtime
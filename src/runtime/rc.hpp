@@ -12,11 +12,85 @@ namespace Spark::Runtime {
 using RCInt = uintptr_t;
 
 /**
- * Represents the header of a Spark object that uses reference counting.
+ * Value of `RCHeader::refCount` past which the count continues in the overflow table.
+ */
+inline constexpr uint32_t RefCountOverflow = UINT32_MAX;
+
+/**
+ * Represents the header of a Spark object that uses reference counting (8 bytes).
  */
 struct RCHeader {
-    RCInt refCount;
-    const Type* type;
+    /**
+     * References held by the thread that allocated the object (the other threads count theirs separately, see
+     * `Thread::rcRetain`). Saturates at `RefCountOverflow`, use `incrementRefCount`/`decrementRefCount` unless the
+     * count is known to be small.
+     */
+    uint32_t refCount;
+    TypeRef type;
 };
 
+static_assert(sizeof(RCHeader) == 8);
+
+/**
+ * Adds one to the overflowed count of an object (its `refCount` is `RefCountOverflow`).
+ */
+void incrementOverflowRefCount(const RCHeader* obj) noexcept;
+
+/**
+ * Subtracts one from the overflowed count of an object (its `refCount` is `RefCountOverflow`).
+ *
+ * @return false if nothing is left in the overflow table (then `refCount` has to be decremented), true otherwise.
+ */
+bool decrementOverflowRefCount(const RCHeader* obj) noexcept;
+
+/**
+ * Gets the part of the count of an object in the overflow table.
+ */
+RCInt overflowRefCount(const RCHeader* obj) noexcept;
+
+/**
+ * Removes an object from the overflow table.
+ */
+void clearOverflowRefCount(const RCHeader* obj) noexcept;
+
+inline void incrementRefCount(RCHeader* obj) noexcept {
+    if (obj->refCount != RefCountOverflow) {
+        ++obj->refCount;
+        return;
+    }
+    incrementOverflowRefCount(obj);
+}
+
+/**
+ * Decrements the reference count of an object.
+ *
+ * @return true if the count reached 0, false otherwise.
+ */
+inline bool decrementRefCount(RCHeader* obj) noexcept {
+    if (obj->refCount == RefCountOverflow && decrementOverflowRefCount(obj)) {
+        return false;
+    }
+    return --obj->refCount == 0;
+}
+
+/**
+ * Gets the full reference count of an object, including its overflow.
+ */
+inline RCInt refCountOf(const RCHeader* obj) noexcept {
+    if (obj->refCount != RefCountOverflow) {
+        return obj->refCount;
+    }
+    return RefCountOverflow + overflowRefCount(obj);
+}
+
+/**
+ * Resets the reference count of an object to 0, dropping its overflow.
+ */
+inline void resetRefCount(RCHeader* obj) noexcept {
+    if (obj->refCount == RefCountOverflow) {
+        clearOverflowRefCount(obj);
+    }
+    obj->refCount = 0;
+}
+
 } // Spark::Runtime
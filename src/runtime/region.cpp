@@ -0,0 +1,105 @@
+#include "region.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace Spark::Runtime {
+
+namespace {
+    constexpr size_t alignUp(size_t size) noexcept {
+        return (size + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t);
+    }
+}
+
+Region::~Region() noexcept {
+    release();
+    std::free(_spare);
+}
+
+void* Region::alloc(const Type* type, size_t size, size_t offset) noexcept {
+    size = alignUp(size);
+    void* p;
+    if (size > LargeSize) {
+        p = allocChunk(size);
+    } else {
+        if (static_cast<size_t>(_bumpEnd - _bump) < size && !refill()) {
+            return nullptr;
+        }
+        p = _bump;
+        _bump += size;
+    }
+    if (p == nullptr) {
+        return nullptr;
+    }
+
+    ++_objectCount;
+    if (type->hasDestructor()) {
+        _finalizers.push_back(Finalizer{ static_cast<char*>(p) + offset, type });
+    }
+    return p;
+}
+
+void Region::release() noexcept {
+    for (auto it = _finalizers.rbegin(); it != _finalizers.rend(); ++it) {
+        it->type->destruct(it->obj);
+    }
+    _finalizers.clear();
+    _pins.clear();
+    _held.clear();
+
+    Chunk* chunk = _chunks;
+    while (chunk != nullptr) {
+        Chunk* next = chunk->next;
+        if (_spare == nullptr && chunk->size == ChunkSize) {
+            _spare = chunk;
+        } else {
+            std::free(chunk);
+        }
+        chunk = next;
+    }
+    _chunks = nullptr;
+    _bump = nullptr;
+    _bumpEnd = nullptr;
+    _objectCount = 0;
+}
+
+bool Region::unpin(DRCHeader* obj) noexcept {
+    auto it = std::find(_pins.rbegin(), _pins.rend(), obj);
+    if (it == _pins.rend()) {
+        return false;
+    }
+    *it = _pins.back();
+    _pins.pop_back();
+    return true;
+}
+
+void* Region::allocChunk(size_t size) noexcept {
+    Chunk* chunk = static_cast<Chunk*>(std::malloc(HeaderSize + size));
+    if (chunk == nullptr) {
+        return nullptr;
+    }
+    chunk->size = HeaderSize + size;
+    chunk->next = _chunks;
+    _chunks = chunk;
+    return reinterpret_cast<char*>(chunk) + HeaderSize;
+}
+
+bool Region::refill() noexcept {
+    Chunk* chunk = _spare;
+    if (chunk != nullptr) {
+        _spare = nullptr;
+        chunk->next = _chunks;
+        _chunks = chunk;
+        _bump = reinterpret_cast<char*>(chunk) + HeaderSize;
+    } else {
+        _bump = static_cast<char*>(allocChunk(ChunkSize - HeaderSize));
+        if (_bump == nullptr) {
+            _bumpEnd = nullptr;
+            return false;
+        }
+    }
+    _bumpEnd = _bump + (ChunkSize - HeaderSize);
+    return true;
+}
+
+} // Spark::Runtime
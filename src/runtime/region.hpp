@@ -0,0 +1,158 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "core/type.hpp"
+#include "drc.hpp"
+
+namespace Spark::Runtime {
+
+/**
+ * Region (arena) of short-lived Spark objects that all die together.
+ * Objects are bump-allocated from large chunks and never freed one by one: releasing the region runs the destructors
+ * of the objects whose type has one (in reverse allocation order) and frees every chunk at once. A chunk is kept for
+ * the next use of the region.
+ * The region also keeps track of the DRC objects outside of it that its objects reference (pins) and of its externally
+ * referenced objects (held), and counts the references into it from outside of it (escapes), see
+ * `Thread::RegionScope`.
+ */
+class Region {
+public:
+    /**
+     * Size of a regular chunk in bytes.
+     */
+    static constexpr size_t ChunkSize = 64 * 1024;
+
+    /**
+     * Largest allocation bump-allocated from a regular chunk, larger ones get a dedicated chunk.
+     */
+    static constexpr size_t LargeSize = ChunkSize / 4;
+
+private:
+    struct Chunk {
+        Chunk* next;
+        size_t size;
+    };
+
+    struct Finalizer {
+        void* obj;
+        const Type* type;
+    };
+
+    /**
+     * Offset of the first object in a chunk (the chunk header padded to the maximum fundamental alignment).
+     */
+    static constexpr size_t HeaderSize =
+        (sizeof(Chunk) + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t);
+
+    Chunk* _chunks = nullptr;
+
+    /**
+     * A regular chunk kept from the last release.
+     */
+    Chunk* _spare = nullptr;
+
+    char* _bump = nullptr;
+    char* _bumpEnd = nullptr;
+
+    std::vector<Finalizer> _finalizers;
+
+    std::vector<DRCHeader*> _pins;
+
+    std::vector<RCHeader*> _held;
+
+    size_t _objectCount = 0;
+    size_t _escapeCount = 0;
+
+public:
+    Region() noexcept = default;
+
+    ~Region() noexcept;
+
+    Region(const Region& other) = delete;
+    Region& operator=(const Region& other) = delete;
+
+    Region(Region&& other) = delete;
+    Region& operator=(Region&& other) = delete;
+
+    /**
+     * Allocates an object of @p type in this region, aligned to `alignof(std::max_align_t)`.
+     * The destructor of the type (if any) runs when the region is released.
+     *
+     * @param type Type of the object.
+     * @param size Size of the allocation in bytes (at least the size of the type).
+     * @param offset Offset of the object in the allocation, i.e. where the destructor is called.
+     * @return Pointer to the allocation, or nullptr if out of memory.
+     */
+    void* alloc(const Type* type, size_t size, size_t offset = 0) noexcept;
+
+    /**
+     * Runs the destructors of the objects of this region and frees them all.
+     * Pins and held objects must have been handled (see `pins` and `held`) as they're dropped.
+     */
+    void release() noexcept;
+
+    /**
+     * Gets the number of objects allocated in this region since it was last released.
+     *
+     * @return Number of objects.
+     */
+    [[nodiscard]]
+    size_t objectCount() const noexcept { return _objectCount; }
+
+    /**
+     * Gets the DRC objects outside of this region referenced by its objects, once per reference.
+     * Each pin holds an external reference to the object until the region is released.
+     *
+     * @return DRC objects pinned by this region.
+     */
+    [[nodiscard]]
+    std::vector<DRCHeader*>& pins() noexcept { return _pins; }
+
+    /**
+     * Drops one pin of a DRC object.
+     *
+     * @param obj Pinned DRC object.
+     * @return true if a pin was dropped, false if @p obj is not pinned.
+     */
+    bool unpin(DRCHeader* obj) noexcept;
+
+    /**
+     * Gets the objects of this region that have external references (e.g. from handles), by their RC header.
+     * Those still referenced when the region is released escape it.
+     *
+     * @return Externally referenced objects of this region.
+     */
+    [[nodiscard]]
+    std::vector<RCHeader*>& held() noexcept { return _held; }
+
+    /**
+     * Gets the number of references from outside of this region to objects in it seen since it was created: from
+     * objects outside of it, and external references still held when it's released. Such references dangle once the
+     * region is released.
+     *
+     * @return Number of escapes.
+     */
+    [[nodiscard]]
+    size_t escapeCount() const noexcept { return _escapeCount; }
+
+    void recordEscape() noexcept { ++_escapeCount; }
+
+private:
+    /**
+     * Allocates a chunk with @p size usable bytes and links it to the region.
+     *
+     * @return Pointer to the usable bytes of the chunk, or nullptr if out of memory.
+     */
+    void* allocChunk(size_t size) noexcept;
+
+    /**
+     * Makes a new regular chunk (the spare one if any) the bump region.
+     *
+     * @return true if succeeded, false if out of memory.
+     */
+    bool refill() noexcept;
+};
+
+} // Spark::Runtime
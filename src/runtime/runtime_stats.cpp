@@ -0,0 +1,38 @@
+#include "runtime_stats.hpp"
+
+#include <limits>
+
+namespace Spark::Runtime {
+
+void writeChromeTrace(std::ostream& out, const std::vector<const CleanupTracer*>& tracers) {
+    using Micros = std::chrono::duration<double, std::micro>;
+
+    auto origin = std::chrono::steady_clock::time_point::max();
+    for (const CleanupTracer* tracer : tracers) {
+        for (const CleanupEvent& event : tracer->events()) {
+            if (event.start < origin) {
+                origin = event.start;
+            }
+        }
+    }
+
+    out << "{\"traceEvents\":[";
+    bool first = true;
+    for (const CleanupTracer* tracer : tracers) {
+        for (const CleanupEvent& event : tracer->events()) {
+            if (!first) {
+                out << ',';
+            }
+            first = false;
+            out << "{\"name\":\"" << (event.kind == CleanupEvent::Kind::Cleanup ? "cleanup" : "cleanup step") << '"'
+                << ",\"cat\":\"drc\",\"ph\":\"X\",\"pid\":0"
+                << ",\"tid\":" << tracer->tid()
+                << ",\"ts\":" << Micros(event.start - origin).count()
+                << ",\"dur\":" << Micros(event.duration).count()
+                << ",\"args\":{\"visited\":" << event.visited << ",\"collected\":" << event.collected << "}}";
+        }
+    }
+    out << "],\"displayTimeUnit\":\"ns\"}";
+}
+
+} // Spark::Runtime
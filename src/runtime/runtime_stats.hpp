@@ -0,0 +1,287 @@
+﻿#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <ostream>
+#include <vector>
+
+#include "core/type.hpp"
+
+namespace Spark::Runtime {
+
+/**
+ * Whether the runtime collects statistics and cleanup traces (defined by the `SPARK_RUNTIME_STATS` build option).
+ * When disabled every recording call compiles to nothing, and the statistics stay zero.
+ */
+#ifdef SPARK_RUNTIME_STATS
+inline constexpr bool StatsEnabled = true;
+#else
+inline constexpr bool StatsEnabled = false;
+#endif
+
+/**
+ * Represents a histogram of sizes in power-of-two buckets.
+ * Bucket 0 counts zeros, bucket i counts sizes in [2^(i-1), 2^i).
+ */
+struct SizeHistogram {
+    static constexpr size_t BucketCount = 33;
+
+    std::array<uint64_t, BucketCount> buckets{};
+
+    void add(size_t size) noexcept {
+        size_t bucket = 0;
+        while (size != 0 && bucket < BucketCount - 1) {
+            size >>= 1;
+            ++bucket;
+        }
+        ++buckets[bucket];
+    }
+
+    /**
+     * Gets the number of sizes recorded.
+     *
+     * @return Number of sizes recorded.
+     */
+    [[nodiscard]]
+    uint64_t count() const noexcept {
+        uint64_t n = 0;
+        for (uint64_t b : buckets) {
+            n += b;
+        }
+        return n;
+    }
+};
+
+/**
+ * Statistics of a DRC graph.
+ */
+struct DRCStats {
+    uint64_t retains = 0;
+    uint64_t releases = 0;
+
+    /**
+     * Number of cleanups run (synchronous or incremental ones that finished).
+     */
+    uint64_t cleanups = 0;
+
+    /**
+     * Number of cleanups that found nothing to collect, or were cancelled by a conflicting mutation.
+     */
+    uint64_t abortedCleanups = 0;
+
+    uint64_t collectedNodes = 0;
+
+    /**
+     * Number of cleanups that went parallel (see `DRC::setParallelCleanup`).
+     */
+    uint64_t parallelCleanups = 0;
+
+    /**
+     * Number of nodes visited per cleanup.
+     */
+    SizeHistogram traversalSizes;
+
+    /**
+     * Gets the fraction of cleanups that were aborted.
+     *
+     * @return Abort rate in [0, 1], 0 if no cleanup was run.
+     */
+    [[nodiscard]]
+    double abortRate() const noexcept {
+        return cleanups == 0 ? 0.0 : static_cast<double>(abortedCleanups) / static_cast<double>(cleanups);
+    }
+};
+
+/**
+ * Allocation statistics of a Spark type.
+ */
+struct TypeStats {
+    /**
+     * Serial of the counted type (see `Type::serial`).
+     */
+    uint64_t typeSerial = 0;
+    uint64_t allocations = 0;
+    uint64_t frees = 0;
+};
+
+/**
+ * Allocation statistics of a thread.
+ * Live bytes include the bookkeeping of the objects: the link of RC objects and the DRC node (with its edge list if
+ * the type isn't traced) of DRC objects in the graph.
+ */
+struct ThreadStats {
+    /**
+     * Statistics of the types, indexed by `Type::index`. A type reusing the index of a destroyed one starts from zero.
+     */
+    std::vector<TypeStats> types;
+
+    uint64_t allocations = 0;
+    uint64_t frees = 0;
+    size_t bytesLive = 0;
+    size_t bytesPeak = 0;
+
+    /**
+     * Gets the statistics of a type.
+     *
+     * @param type Type to query.
+     * @return Statistics of @p type, zero if none of its objects were counted.
+     */
+    [[nodiscard]]
+    TypeStats typeStats(const Type* type) const noexcept {
+        if (type->index() < types.size() && types[type->index()].typeSerial == type->serial()) {
+            return types[type->index()];
+        }
+        return TypeStats{ type->serial() };
+    }
+
+    void recordAlloc(const Type* type, size_t size) noexcept {
+        if constexpr (StatsEnabled) {
+            if (TypeStats* stats = entryOf(type)) {
+                ++stats->allocations;
+            }
+            ++allocations;
+            recordBytes(size);
+        }
+    }
+
+    void recordFree(const Type* type, size_t size) noexcept {
+        if constexpr (StatsEnabled) {
+            if (TypeStats* stats = entryOf(type)) {
+                ++stats->frees;
+            }
+            ++frees;
+            bytesLive -= size;
+        }
+    }
+
+    /**
+     * Records bookkeeping allocated for a live object (e.g. the DRC node of a promoted young object).
+     */
+    void recordBytes(size_t size) noexcept {
+        if constexpr (StatsEnabled) {
+            bytesLive += size;
+            if (bytesLive > bytesPeak) {
+                bytesPeak = bytesLive;
+            }
+        }
+    }
+
+private:
+    /**
+     * Gets the entry of a type, resetting it if it counted a destroyed type with the same index.
+     *
+     * @return Entry of @p type, nullptr if out of memory (the type then goes uncounted).
+     */
+    TypeStats* entryOf(const Type* type) noexcept {
+        const uint32_t index = type->index();
+        if (index >= types.size()) {
+            try {
+                types.resize(index + 1);
+            } catch (const std::bad_alloc&) {
+                return nullptr;
+            }
+        }
+        TypeStats& stats = types[index];
+        if (stats.typeSerial != type->serial()) {
+            stats = TypeStats{ type->serial() };
+        }
+        return &stats;
+    }
+};
+
+/**
+ * Represents a cleanup pause recorded by a `CleanupTracer`.
+ */
+struct CleanupEvent {
+    enum class Kind {
+        /**
+         * Synchronous cleanup from a node (`DRC::tryCleanup`).
+         */
+        Cleanup,
+        /**
+         * Step of an incremental cleanup (`DRC::stepCleanup`).
+         */
+        Step,
+    };
+
+    Kind kind;
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::duration duration;
+    size_t visited;
+    size_t collected;
+};
+
+/**
+ * Records cleanup pauses of the DRC graphs it's attached to (see `DRC::setTracer`), to be exported as a Chrome trace.
+ * Not thread-safe, attach a tracer per thread.
+ */
+class CleanupTracer {
+private:
+    std::vector<CleanupEvent> _events;
+
+    uint32_t _tid;
+
+public:
+    /**
+     * Constructs a tracer.
+     *
+     * @param tid Thread ID of the recorded events in the trace.
+     */
+    explicit CleanupTracer(uint32_t tid = 0) noexcept : _tid(tid) { }
+
+    void record(const CleanupEvent& event) {
+        _events.push_back(event);
+    }
+
+    [[nodiscard]]
+    const std::vector<CleanupEvent>& events() const noexcept { return _events; }
+
+    [[nodiscard]]
+    uint32_t tid() const noexcept { return _tid; }
+
+    void clear() noexcept { _events.clear(); }
+};
+
+/**
+ * Writes the events of tracers as a Chrome trace (the JSON object format of chrome://tracing and Perfetto).
+ * Each pause is a complete event, timestamps are relative to the earliest event.
+ *
+ * @param out Stream to write to.
+ * @param tracers Tracers to export.
+ */
+void writeChromeTrace(std::ostream& out, const std::vector<const CleanupTracer*>& tracers);
+
+/**
+ * A scope that measures a cleanup pause for a tracer (does nothing if the tracer is nullptr or stats are disabled).
+ */
+class CleanupTraceScope {
+private:
+    CleanupTracer* _tracer;
+    CleanupEvent _event;
+
+public:
+    CleanupTraceScope(CleanupTracer* tracer, CleanupEvent::Kind kind) noexcept
+        : _tracer(StatsEnabled ? tracer : nullptr), _event{ kind, {}, {}, 0, 0 } {
+        if (_tracer != nullptr) {
+            _event.start = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~CleanupTraceScope() {
+        if (_tracer != nullptr) {
+            _event.duration = std::chrono::steady_clock::now() - _event.start;
+            _tracer->record(_event);
+        }
+    }
+
+    CleanupTraceScope(const CleanupTraceScope& other) = delete;
+    CleanupTraceScope& operator=(const CleanupTraceScope& other) = delete;
+
+    void setVisited(size_t visited) noexcept { _event.visited = visited; }
+    void setCollected(size_t collected) noexcept { _event.collected = collected; }
+};
+
+} // Spark::Runtime
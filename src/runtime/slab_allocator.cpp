@@ -0,0 +1,174 @@
+#include "slab_allocator.hpp"
+
+#include <cstdlib>
+#include <limits>
+#include <utility>
+
+namespace Spark::Runtime {
+
+namespace {
+    /**
+     * Granularity of the size class lookup table.
+     */
+    constexpr size_t LookupGranularity = 16;
+
+    /**
+     * Computes the size class of @p size without the lookup table.
+     * Classes 0-15 are 16 bytes apart (16 - 256), then every power of two is split into four classes (320 - 4096).
+     */
+    constexpr size_t computeSizeClass(size_t size) noexcept {
+        if (size <= 256) {
+            return size == 0 ? 0 : (size - 1) / 16;
+        }
+        size_t s = size - 1;
+        size_t log2 = 0;
+        while ((s >> (log2 + 1)) != 0) {
+            ++log2;
+        }
+        size_t step = size_t{1} << (log2 - 2);
+        return 16 + (log2 - 8) * 4 + (s - (size_t{1} << log2)) / step;
+    }
+
+    constexpr std::array<uint8_t, SlabAllocator::MaxSlabSize / LookupGranularity> makeSizeClassTable() noexcept {
+        std::array<uint8_t, SlabAllocator::MaxSlabSize / LookupGranularity> table{};
+        for (size_t i = 0; i < table.size(); ++i) {
+            table[i] = static_cast<uint8_t>(computeSizeClass((i + 1) * LookupGranularity));
+        }
+        return table;
+    }
+
+    /**
+     * Maps `(size - 1) / 16` to its size class for sizes up to `SlabAllocator::MaxSlabSize`.
+     */
+    constexpr std::array<uint8_t, SlabAllocator::MaxSlabSize / LookupGranularity> sizeClassTable = makeSizeClassTable();
+
+    static_assert(computeSizeClass(SlabAllocator::MaxSlabSize) == SlabAllocator::SizeClassCount - 1);
+}
+
+SlabAllocator::~SlabAllocator() noexcept {
+    releasePages();
+}
+
+SlabAllocator::SlabAllocator(SlabAllocator&& other) noexcept
+    : _classes(std::exchange(other._classes, {})),
+      _pages(std::exchange(other._pages, nullptr)),
+      _pageCount(std::exchange(other._pageCount, 0)) { }
+
+SlabAllocator& SlabAllocator::operator=(SlabAllocator&& other) noexcept {
+    if (this != &other) {
+        releasePages();
+        _classes = std::exchange(other._classes, {});
+        _pages = std::exchange(other._pages, nullptr);
+        _pageCount = std::exchange(other._pageCount, 0);
+    }
+    return *this;
+}
+
+void* SlabAllocator::alloc(size_t size) noexcept {
+    if (size > MaxSlabSize) {
+        return allocLarge(size);
+    }
+
+    size_t sizeClass = sizeClassOf(size);
+    SizeClass& cls = _classes[sizeClass];
+
+    // Reuse a freed block first
+    if (cls.freeList != nullptr) {
+        FreeBlock* block = cls.freeList;
+        cls.freeList = block->next;
+        return block;
+    }
+
+    // Carve a new block from the current page
+    if (cls.bump == cls.bumpEnd && !refill(sizeClass)) {
+        return nullptr;
+    }
+    void* block = cls.bump;
+    cls.bump += blockSizeOf(sizeClass);
+    return block;
+}
+
+void SlabAllocator::free(void* ptr) noexcept {
+    if (ptr == nullptr) {
+        return;
+    }
+
+    PageHeader* page = pageOf(ptr);
+    if (page->sizeClass == LargeClass) {
+        std::free(page);
+        return;
+    }
+
+    FreeBlock* block = static_cast<FreeBlock*>(ptr);
+    SizeClass& cls = _classes[page->sizeClass];
+    block->next = cls.freeList;
+    cls.freeList = block;
+}
+
+size_t SlabAllocator::sizeClassOf(size_t size) noexcept {
+    if (size > MaxSlabSize) {
+        return SizeClassCount;
+    }
+    return size == 0 ? 0 : sizeClassTable[(size - 1) / LookupGranularity];
+}
+
+size_t SlabAllocator::blockSizeOf(size_t sizeClass) noexcept {
+    if (sizeClass < 16) {
+        return (sizeClass + 1) * 16;
+    }
+    size_t group = (sizeClass - 16) / 4;
+    size_t index = (sizeClass - 16) % 4;
+    return (size_t{256} << group) + (index + 1) * (size_t{64} << group);
+}
+
+bool SlabAllocator::refill(size_t sizeClass) noexcept {
+    void* mem = std::aligned_alloc(PageSize, PageSize);
+    if (mem == nullptr) {
+        return false;
+    }
+
+    PageHeader* page = static_cast<PageHeader*>(mem);
+    page->next = _pages;
+    page->sizeClass = sizeClass;
+    _pages = page;
+    ++_pageCount;
+
+    size_t blockSize = blockSizeOf(sizeClass);
+    size_t blockCount = (PageSize - HeaderSize) / blockSize;
+    SizeClass& cls = _classes[sizeClass];
+    cls.bump = static_cast<char*>(mem) + HeaderSize;
+    cls.bumpEnd = cls.bump + blockCount * blockSize;
+    return true;
+}
+
+void* SlabAllocator::allocLarge(size_t size) noexcept {
+    if (size > std::numeric_limits<size_t>::max() - HeaderSize - PageSize) {
+        return nullptr;
+    }
+
+    // std::aligned_alloc requires the size to be a multiple of the alignment
+    size_t total = (HeaderSize + size + PageSize - 1) / PageSize * PageSize;
+    void* mem = std::aligned_alloc(PageSize, total);
+    if (mem == nullptr) {
+        return nullptr;
+    }
+
+    PageHeader* page = static_cast<PageHeader*>(mem);
+    page->next = nullptr;
+    page->sizeClass = LargeClass;
+    return static_cast<char*>(mem) + HeaderSize;
+}
+
+void SlabAllocator::releasePages() noexcept {
+    PageHeader* page = _pages;
+    while (page != nullptr) {
+        PageHeader* next = page->next;
+        std::free(page);
+        page = next;
+    }
+    _pages = nullptr;
+    _pageCount = 0;
+    _classes = {};
+}
+
+} // Spark::Runtime
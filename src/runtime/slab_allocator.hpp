@@ -0,0 +1,156 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace Spark::Runtime {
+
+/**
+ * Size-class slab allocator.
+ * Small allocations are served from per-size-class free lists carved out of large pages, larger ones get a dedicated
+ * run of pages. Every page starts with a header recording its size class, so `free` finds the size class of a block by
+ * masking its address down to the page boundary.
+ * Satisfies the same `alloc`/`free` interface as `DefaultAllocator` and is not thread-safe (one instance per thread):
+ * blocks must be freed through the allocator that allocated them. Objects deleted by other threads are handed back to
+ * the thread that allocated them (see `Thread::deleteRCObject`), which frees them here.
+ */
+class SlabAllocator {
+public:
+    /**
+     * Size and alignment of a slab page in bytes.
+     */
+    static constexpr size_t PageSize = 64 * 1024;
+
+    /**
+     * Largest allocation size served from a size class, anything larger gets dedicated pages.
+     */
+    static constexpr size_t MaxSlabSize = 4096;
+
+    /**
+     * Number of size classes.
+     */
+    static constexpr size_t SizeClassCount = 32;
+
+private:
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    struct PageHeader {
+        PageHeader* next;
+        size_t sizeClass;
+    };
+
+    struct SizeClass {
+        FreeBlock* freeList = nullptr;
+        char* bump = nullptr;
+        char* bumpEnd = nullptr;
+    };
+
+    /**
+     * Size class index used for pages that hold a single large allocation.
+     */
+    static constexpr size_t LargeClass = SizeClassCount;
+
+    /**
+     * Offset of the first block in a page (the page header padded to the maximum fundamental alignment).
+     */
+    static constexpr size_t HeaderSize =
+        (sizeof(PageHeader) + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t);
+
+    std::array<SizeClass, SizeClassCount> _classes{};
+
+    /**
+     * Intrusive list of every slab page owned by this allocator.
+     */
+    PageHeader* _pages = nullptr;
+
+    size_t _pageCount = 0;
+
+public:
+    SlabAllocator() noexcept = default;
+
+    ~SlabAllocator() noexcept;
+
+    SlabAllocator(const SlabAllocator& other) = delete;
+    SlabAllocator& operator=(const SlabAllocator& other) = delete;
+
+    SlabAllocator(SlabAllocator&& other) noexcept;
+    SlabAllocator& operator=(SlabAllocator&& other) noexcept;
+
+    /**
+     * Allocates a block of at least @p size bytes aligned to `alignof(std::max_align_t)`.
+     *
+     * @param size Size of the block in bytes.
+     * @return Pointer to the allocated block, or nullptr if out of memory.
+     */
+    void* alloc(size_t size) noexcept;
+
+    /**
+     * Frees a block previously allocated by this allocator (does nothing if @p ptr is nullptr).
+     *
+     * @param ptr Pointer to the block to free.
+     */
+    void free(void* ptr) noexcept;
+
+    /**
+     * Gets the number of slab pages currently owned by this allocator (excluding pages of large allocations).
+     *
+     * @return Number of slab pages.
+     */
+    [[nodiscard]]
+    size_t pageCount() const noexcept { return _pageCount; }
+
+    /**
+     * Gets the size class index that serves allocations of @p size bytes.
+     *
+     * @param size Size of the allocation in bytes.
+     * @return Size class index, or `SizeClassCount` if @p size is too large to be served from a size class.
+     */
+    [[nodiscard]]
+    static size_t sizeClassOf(size_t size) noexcept;
+
+    /**
+     * Gets the block size of a size class.
+     *
+     * @param sizeClass Size class index.
+     * @return Block size of the size class in bytes.
+     */
+    [[nodiscard]]
+    static size_t blockSizeOf(size_t sizeClass) noexcept;
+
+private:
+    /**
+     * Allocates a new slab page and makes it the bump region of a size class.
+     *
+     * @param sizeClass Size class index to refill.
+     * @return true if succeeded, false if out of memory.
+     */
+    bool refill(size_t sizeClass) noexcept;
+
+    /**
+     * Allocates a dedicated run of pages for a large allocation.
+     *
+     * @param size Size of the allocation in bytes.
+     * @return Pointer to the allocated block, or nullptr if out of memory.
+     */
+    static void* allocLarge(size_t size) noexcept;
+
+    /**
+     * Gets the header of the page that contains @p ptr.
+     *
+     * @param ptr Pointer to a block allocated by a slab allocator.
+     * @return Header of the page containing the block.
+     */
+    static PageHeader* pageOf(void* ptr) noexcept {
+        return reinterpret_cast<PageHeader*>(reinterpret_cast<uintptr_t>(ptr) & ~(uintptr_t{PageSize} - 1));
+    }
+
+    /**
+     * Frees every page owned by this allocator.
+     */
+    void releasePages() noexcept;
+};
+
+} // Spark::Runtime
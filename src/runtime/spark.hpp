@@ -1,6 +1,10 @@
 #pragma once
 
+#include <memory>
+#include <unordered_set>
+
 #include "allocator.hpp"
+#include "cycle_collector.hpp"
 #include "thread.hpp"
 
 namespace Spark::Runtime {
@@ -12,10 +16,26 @@ private:
 
     std::unordered_set<Thread<Allocator>*> _threads;
 
+    /**
+     * Background cycle collector shared by every thread, nullptr if threads collect their own cycles.
+     */
+    std::unique_ptr<CycleCollector<Allocator>> _collector;
+
 public:
-    explicit Spark(Allocator allocator = {}) noexcept : _allocator(std::move(allocator)) { }
+    /**
+     * Constructs a Spark context.
+     *
+     * @param allocator Allocator of the context.
+     * @param backgroundCollector Whether to collect the cycles of every thread on a dedicated collector thread.
+     */
+    explicit Spark(Allocator allocator = {}, bool backgroundCollector = false)
+        : _allocator(std::move(allocator)),
+          _collector(backgroundCollector ? std::make_unique<CycleCollector<Allocator>>() : nullptr) { }
 
     ~Spark() noexcept {
+        if (_collector != nullptr) {
+            _collector->stop();
+        }
         for (Thread<Allocator>* th : _threads) {
             delete th;
         }
@@ -24,13 +44,19 @@ public:
     Spark(const Spark& other) = delete;
     Spark& operator=(const Spark& other) = delete;
 
-    Spark(Spark&& other) noexcept {
-        // TODO
-    }
-
-    Spark& operator=(Spark&& other) noexcept {
-        // TODO
-        return *this;
+    Spark(Spark&& other) = delete;
+    Spark& operator=(Spark&& other) = delete;
+
+    /**
+     * Creates a new thread owned by this context (attached to the background cycle collector, if any).
+     *
+     * @param allocator Allocator of the thread's objects.
+     * @return Pointer to the new thread.
+     */
+    Thread<Allocator>* newThread(Allocator allocator = {}) {
+        auto* th = new Thread<Allocator>(std::move(allocator), _collector.get());
+        _threads.insert(th);
+        return th;
     }
 };
 
@@ -1,9 +1,27 @@
-#pragma once
+﻿#pragma once
 
-#include <unordered_set>
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
 
 #include "core/type.hpp"
+#include "cycle_collector.hpp"
 #include "drc.hpp"
+#include "heap_snapshot.hpp"
+#include "nursery.hpp"
+#include "region.hpp"
+#include "runtime_stats.hpp"
 
 namespace Spark::Runtime {
 
@@ -13,69 +31,1525 @@ namespace Spark::Runtime {
 template <typename Allocator>
 class Thread {
 private:
+    /**
+     * Number of nodes an incremental cleanup processes between two checks of the time budget.
+     */
+    static constexpr size_t IncrementalQuantum = 64;
+
+    /**
+     * Default number of buffered candidate roots that hands the thread over to the background cycle collector.
+     */
+    static constexpr size_t DefaultCollectorThreshold = 256;
+
+    /**
+     * Flags and unit of `RCLink::sharedRefCount`: the count is kept above the two flag bits.
+     */
+    static constexpr int64_t SharedMerged = 1;
+    static constexpr int64_t SharedQueued = 2;
+    static constexpr int64_t SharedFlags = SharedMerged | SharedQueued;
+    static constexpr int64_t SharedOne = 4;
+
+    /**
+     * Value of `RCLink::index` for young RC objects, which are not registered.
+     */
+    static constexpr uint32_t YoungIndex = UINT32_MAX;
+
+    static constexpr uint32_t ThreadTableChunkBits = 8;
+    static constexpr uint32_t ThreadTableChunkSize = 1 << ThreadTableChunkBits;
+    static constexpr uint32_t ThreadTableChunkCount = 1 << 8;
+
+    /**
+     * Maximum number of threads alive at once (index 0 is reserved for region objects).
+     */
+    static constexpr uint32_t ThreadTableCapacity = ThreadTableChunkSize * ThreadTableChunkCount - 1;
+
+    struct RCLink;
+
+    /**
+     * Part of a thread that other threads reach through the thread table (by `RCLink::owner`). It outlives the thread
+     * while other threads still reference RC objects of the thread (see `~Thread`).
+     */
+    struct Inbox {
+        /**
+         * Allocator and nursery of a destroyed thread, kept to free the RC objects other threads still referenced.
+         */
+        struct Orphanage {
+            Allocator allocator;
+            Nursery nursery;
+            /**
+             * Number of objects left.
+             */
+            size_t count;
+
+            Orphanage(Allocator&& allocator, Nursery&& nursery, size_t count) noexcept
+                : allocator(std::move(allocator)), nursery(std::move(nursery)), count(count) { }
+        };
+
+        /**
+         * Index of the thread in the thread table.
+         */
+        uint32_t index = 0;
+
+        /**
+         * Lock-free stack of RC objects of the thread destructed by other threads, to be freed by the thread.
+         * `_closedInbox` once the thread is destroyed: other threads then free the objects into the orphanage.
+         */
+        std::atomic<RCLink*> remoteRCObjects = nullptr;
+
+        /**
+         * RC objects of the thread whose shared count went negative, to have their counts merged by the thread.
+         * An object is queued at most once until it's merged, so other threads rarely take `mutex`.
+         */
+        std::vector<RCLink*> mergeRCObjects;
+        std::atomic<bool> mergePending = false;
+
+        /**
+         * Guards `mergeRCObjects` and `orphanage`.
+         */
+        std::mutex mutex;
+
+        std::optional<Orphanage> orphanage;
+    };
+
+    /**
+     * Chunks of the table of the inboxes of the threads (using this allocator), indexed by `_index`. Chunks never
+     * move, so lookups don't lock.
+     */
+    static inline std::atomic<Inbox*>* _threadTable[ThreadTableChunkCount] = { };
+
+    /**
+     * Registration side of the thread table (see `_threadTable`).
+     */
+    class ThreadTable {
+    private:
+        std::mutex _mutex;
+
+        /**
+         * Next never used index.
+         */
+        uint32_t _next = 1;
+
+        /**
+         * Indices of destroyed threads, to be reused.
+         */
+        std::vector<uint32_t> _free;
+
+    public:
+        static ThreadTable& instance() noexcept {
+            static ThreadTable table;
+            return table;
+        }
+
+        ~ThreadTable() noexcept {
+            for (std::atomic<Inbox*>*& chunk : _threadTable) {
+                delete[] chunk;
+                chunk = nullptr;
+            }
+        }
+
+        static void set(uint32_t index, Inbox* inbox) noexcept {
+            _threadTable[index >> ThreadTableChunkBits][index & (ThreadTableChunkSize - 1)]
+                .store(inbox, std::memory_order_relaxed);
+        }
+
+        /**
+         * Registers a new thread.
+         *
+         * @return Inbox of the thread, with its index.
+         */
+        Inbox* add() {
+            auto inbox = std::make_unique<Inbox>();
+            std::lock_guard lock(_mutex);
+            uint32_t index;
+            if (!_free.empty()) {
+                index = _free.back();
+                _free.pop_back();
+            } else {
+                if (_next > ThreadTableCapacity) {
+                    throw std::length_error("too many Spark threads");
+                }
+                std::atomic<Inbox*>*& chunk = _threadTable[_next >> ThreadTableChunkBits];
+                if (chunk == nullptr) {
+                    chunk = new std::atomic<Inbox*>[ThreadTableChunkSize]();
+                }
+                index = _next++;
+            }
+            inbox->index = index;
+            set(index, inbox.get());
+            return inbox.release();
+        }
+
+        /**
+         * Unregisters a destroyed thread whose objects are all freed, deleting its inbox.
+         */
+        void remove(Inbox* inbox) noexcept {
+            {
+                std::lock_guard lock(_mutex);
+                set(inbox->index, nullptr);
+                _free.push_back(inbox->index);
+            }
+            delete inbox;
+        }
+    };
+
+    /**
+     * Default number of freed objects a type pool keeps per kind of object.
+     */
+    static constexpr size_t DefaultPoolCapacity = 32;
+
+    static constexpr uint32_t PoolChunkBits = 6;
+    static constexpr uint32_t PoolChunkSize = 1 << PoolChunkBits;
+
+    friend class CycleCollector<Allocator>;
+
+    /**
+     * Locks the DRC graph of a thread against its background cycle collector (does nothing without one).
+     */
+    class GraphLock {
+    private:
+        std::mutex* _mutex;
+
+    public:
+        explicit GraphLock(Thread* th) noexcept : _mutex(th->_collector != nullptr ? &th->_graphMutex : nullptr) {
+            if (_mutex != nullptr) {
+                _mutex->lock();
+            }
+        }
+
+        ~GraphLock() noexcept {
+            if (_mutex != nullptr) {
+                _mutex->unlock();
+            }
+        }
+
+        GraphLock(const GraphLock& other) = delete;
+        GraphLock& operator=(const GraphLock& other) = delete;
+    };
+
+    /**
+     * Prefix of every RC object allocation, registering the object in the thread that allocated it (16 bytes).
+     */
+    struct alignas(std::max_align_t) RCLink {
+        /**
+         * Index of the thread that allocated the object (see `inboxOf`), 0 if it's allocated in a region.
+         */
+        uint32_t owner;
+        /**
+         * Index of the object in `_rcObjects` of the owner, `YoungIndex` if it's young.
+         */
+        uint32_t index;
+        union {
+            /**
+             * References counted by threads other than the owner (in units of `SharedOne`, may be negative), with
+             * the `SharedMerged` and `SharedQueued` flags. Once merged, the owner counts here as well: the 64 bits
+             * hold up to 2^61 references, beyond any owner count (`RCHeader::refCount` with its overflow) that fits
+             * in memory.
+             */
+            std::atomic<int64_t> sharedRefCount = 0;
+            /**
+             * Next object in the remote delete list of the owner, once destructed.
+             */
+            RCLink* next;
+        };
+    };
+
+    static_assert(sizeof(RCLink) == 16);
+
+    /**
+     * Value of `Inbox::remoteRCObjects` once the thread is destroyed.
+     */
+    static inline RCLink _closedInbox;
+
+    Inbox* _inbox;
+
+    /**
+     * Index of this thread in the thread table.
+     */
+    uint32_t _index;
+
     Allocator _allocator;
 
     /**
-     * Set of every allocated Spark RC objects of this thread.
+     * Every allocated Spark RC object of this thread (DRC objects are found through the DRC graph).
      */
-    std::unordered_set<RCHeader*> _rcObjects;
+    std::vector<RCLink*> _rcObjects;
 
     /**
-     * Set of every allocated Spark DRC objects of this thread.
+     * Objects taken from `Inbox::mergeRCObjects` by the last merge (kept for its capacity).
      */
-    std::unordered_set<DRCHeader*> _drcObjects;
+    std::vector<RCLink*> _mergeBatch;
 
     /**
      * Double reference object graph.
      */
     DRC _drc;
 
+    /**
+     * Background cycle collector of the thread's Spark context, nullptr if cycles are collected on this thread.
+     */
+    CycleCollector<Allocator>* _collector;
+
+    /**
+     * Guards the DRC graph, `_collectorQueued` and `_collected` while a background cycle collector is attached.
+     */
+    std::mutex _graphMutex;
+
+    /**
+     * Whether the thread is queued to (or being processed by) the background cycle collector.
+     */
+    bool _collectorQueued = false;
+
+    /**
+     * Next thread in the queue of the background cycle collector.
+     */
+    Thread* _collectorNext = nullptr;
+
+    /**
+     * Number of buffered candidate roots that hands the thread over to the background cycle collector.
+     */
+    size_t _collectorThreshold = DefaultCollectorThreshold;
+
+    /**
+     * DRC objects found to be garbage by the background cycle collector, already removed from the graph.
+     */
+    std::deque<DRCHeader*> _collected;
+
+    /**
+     * DRC objects to destruct and free once the graph is unlocked.
+     */
+    std::vector<DRCHeader*> _freeCache;
+
+    /**
+     * Garbage found by incremental cleanups, still in the DRC graph until it's freed (a batch per quantum of a safe
+     * point).
+     */
+    std::deque<DRCNode*> _garbage;
+
+    ThreadStats _stats;
+
+    /**
+     * Region objects are allocated in while `_regionDepth` is non-zero.
+     */
+    Region _region;
+
+    size_t _regionDepth = 0;
+
+    /**
+     * Young space new objects are allocated in, if reserved (see `useNursery`).
+     */
+    Nursery _nursery;
+
+    /**
+     * Value of `DRCHeader::node` for young DRC objects, which are not in the DRC graph.
+     */
+    static inline DRCNode _youngNode;
+
+    /**
+     * Free list of recycled allocations of one size, linked through their first bytes.
+     */
+    struct PoolList {
+        struct Block {
+            Block* next;
+        };
+
+        Block* head = nullptr;
+        size_t count = 0;
+
+        void push(void* p) noexcept {
+            auto* block = static_cast<Block*>(p);
+            block->next = head;
+            head = block;
+            ++count;
+        }
+
+        void* pop() noexcept {
+            Block* block = head;
+            if (block != nullptr) {
+                head = block->next;
+                --count;
+            }
+            return block;
+        }
+    };
+
+    /**
+     * Allocations of freed objects of a type, kept for the next objects of the type.
+     */
+    struct TypePool {
+        /**
+         * Serial of the type the pool is for (indices of destroyed types get reused, see `Type::serial`).
+         */
+        uint64_t typeSerial = 0;
+        size_t capacity = DefaultPoolCapacity;
+        PoolList rc;
+        PoolList drc;
+    };
+
+    /**
+     * Chunks of the type pools, indexed by `Type::index`. A chunk is only allocated once one of its types frees or
+     * configures objects, so a thread using a few types with large indices doesn't hold pools for all the indices
+     * below.
+     */
+    std::vector<std::unique_ptr<TypePool[]>> _pools;
+
+    void (*_regionEscapeHandler)(DRCHeader* owner, RCHeader* referencee) = nullptr;
+
 public:
-    explicit Thread(Allocator allocator = {}) noexcept : _allocator(std::move(allocator)) { }
+    /**
+     * Called when an object outside of a region references an object in it (the reference dangles once the region is
+     * released), with the DRC object outside of the region (nullptr for an external reference still held when the
+     * region is released) and the RC header of the region object (`DRCHeader::rcHeader` for DRC objects).
+     */
+    using RegionEscapeHandler = void (*)(DRCHeader* owner, RCHeader* referencee);
 
+    /**
+     * Allocates the objects of a thread in its region for the lifetime of the scope.
+     * Region objects skip all the bookkeeping: RC objects are not registered, DRC objects get no DRC node (`node` is
+     * nullptr) and references between them are not tracked, deleting them does nothing. When the outermost scope
+     * ends, the destructors of the region objects run and their memory is released in one shot.
+     * A region object referencing a DRC object outside of the region pins it (as an external reference) until the
+     * region is released. A DRC object outside of the region referencing a region object is an escape: it's counted
+     * (`Region::escapeCount`) and reported to the escape handler of the thread, if any. External references to region
+     * objects are counted as well (only by their thread), and the ones still held when the region is released (e.g.
+     * by returned handles) are escapes too. Nested scopes share the region of the outermost one.
+     */
+    class RegionScope {
+    private:
+        Thread* _th;
+
+    public:
+        explicit RegionScope(Thread* th) noexcept : _th(th) {
+            ++_th->_regionDepth;
+        }
+
+        ~RegionScope() noexcept {
+            if (--_th->_regionDepth == 0) {
+                releaseRegion(_th);
+            }
+        }
+
+        RegionScope(const RegionScope& other) = delete;
+        RegionScope& operator=(const RegionScope& other) = delete;
+    };
+
+    /**
+     * Constructs a thread.
+     *
+     * @param allocator Allocator of the thread's objects.
+     * @param collector Background cycle collector to hand candidate roots over to, nullptr to collect cycles on this
+     *                  thread. Its DRC graph is then locked on every mutation.
+     * @throws std::length_error if `ThreadTableCapacity` threads are alive already.
+     */
+    explicit Thread(Allocator allocator = {}, CycleCollector<Allocator>* collector = nullptr)
+        : _inbox(ThreadTable::instance().add()), _index(_inbox->index), _allocator(std::move(allocator)),
+          _collector(collector) {
+        if (_collector != nullptr) {
+            _drc.setCandidateThreshold(std::numeric_limits<size_t>::max());
+        }
+    }
+
+    /**
+     * Destroys a thread with its objects.
+     * The references of the thread die with it, including the ones it moved to other threads without retaining them
+     * (other threads have to release those before). RC objects retained by other threads outlive the thread: they're
+     * freed with their last release, into the allocator and nursery of the thread, which are kept (and its index
+     * reserved) until then.
+     */
     ~Thread() noexcept {
-        for (RCHeader* obj : _rcObjects) {
+        _region.release();
+        std::unique_lock lock(_inbox->mutex);
+        freeRCObjects(this, _inbox->remoteRCObjects.exchange(&_closedInbox, std::memory_order_acquire));
+        _inbox->mergeRCObjects.clear();
+        size_t orphans = 0;
+        _nursery.collectYoung([&orphans](Nursery::ObjectHeader* header) {
+            void* p = header + 1;
+            if (header->kind == Nursery::Kind::RC) {
+                if (orphanRCObject(static_cast<RCLink*>(p))) {
+                    header->state = Nursery::State::Promoted;
+                    ++orphans;
+                    return;
+                }
+                RCHeader* obj = objectOf(static_cast<RCLink*>(p));
+                obj->type->destruct(obj);
+            } else {
+                DRCHeader* obj = static_cast<DRCHeader*>(p);
+                obj->rcHeader.type->destruct(obj);
+            }
+        });
+        for (RCLink* link : _rcObjects) {
+            if (orphanRCObject(link)) {
+                ++orphans;
+                continue;
+            }
+            RCHeader* obj = objectOf(link);
             obj->type->destruct(obj);
-            _allocator.free(obj);
+            freeMemory(this, link);
         }
-        for (DRCHeader* obj : _drcObjects) {
+        _drc.forEachObject([this](DRCHeader* obj) {
             obj->rcHeader.type->destruct(obj);
-            _allocator.free(obj);
+            freeMemory(this, obj);
+        });
+        // Garbage not freed yet is still in the DRC graph, only the detached objects are left
+        _freeCache.insert(_freeCache.end(), _collected.begin(), _collected.end());
+        for (DRCHeader* obj : _freeCache) {
+            obj->rcHeader.type->destruct(obj);
+            freeMemory(this, obj);
+        }
+        for (const std::unique_ptr<TypePool[]>& chunk : _pools) {
+            if (chunk != nullptr) {
+                for (uint32_t i = 0; i < PoolChunkSize; ++i) {
+                    flushPool(this, chunk[i]);
+                }
+            }
         }
+        if (orphans > 0) {
+            _inbox->orphanage.emplace(std::move(_allocator), std::move(_nursery), orphans);
+            return;
+        }
+        lock.unlock();
+        ThreadTable::instance().remove(_inbox);
+    }
+
+    /**
+     * Sets how many freed objects of a type a thread keeps for reuse, per kind of object (RC or DRC). Freed objects
+     * past that go back to the allocator.
+     *
+     * @param th Thread to configure.
+     * @param type Type of the objects.
+     * @param capacity Number of objects to keep, 0 to disable recycling for the type.
+     * @throws std::bad_alloc if the pool of the type can't be allocated.
+     */
+    static void setPoolCapacity(Thread* th, const Type* type, size_t capacity) {
+        TypePool& pool = createPool(th, type);
+        pool.capacity = capacity;
+        trimPool(th, pool.rc, capacity);
+        trimPool(th, pool.drc, capacity);
+    }
+
+    /**
+     * Preallocates RC objects of a type, so that the next @p n allocations of the type are served from its pool (the
+     * capacity of the pool grows to @p n if needed).
+     *
+     * @param th Thread to allocate for.
+     * @param type Type of the objects.
+     * @param n Number of objects.
+     * @throws std::bad_alloc if the pool of the type can't be allocated.
+     */
+    static void reserveRCObjects(Thread* th, const Type* type, size_t n) {
+        reservePool(th, createPool(th, type), &TypePool::rc, sizeof(RCLink) + type->size(), n);
+    }
+
+    /**
+     * Preallocates DRC objects of a type, see `reserveRCObjects`.
+     *
+     * @param th Thread to allocate for.
+     * @param type Type of the objects.
+     * @param n Number of objects.
+     * @throws std::bad_alloc if the pool of the type can't be allocated.
+     */
+    static void reserveDRCObjects(Thread* th, const Type* type, size_t n) {
+        reservePool(th, createPool(th, type), &TypePool::drc, type->size(), n);
+    }
+
+    /**
+     * Reserves a nursery for a thread: its new objects are then bump-allocated in the nursery, without being
+     * registered (RC objects) or added to the DRC graph (DRC objects) while they're young. Young RC objects are freed
+     * as usual, young DRC objects join the graph once they reference or get referenced by another DRC object.
+     * `nurseryCollect` ends the youth of the objects at a safe point. When the nursery is full, objects are allocated
+     * with the allocator of the thread.
+     *
+     * @param th Thread to configure, that hasn't used its nursery yet.
+     * @param size Size of the nursery in bytes.
+     * @return true if the thread has a nursery, false if out of memory.
+     */
+    static bool useNursery(Thread* th, size_t size = Nursery::DefaultSize) noexcept {
+        return th->_nursery.reserve(size);
+    }
+
+    /**
+     * Runs a minor collection at a safe point of a thread, where every reference to its DRC objects is counted.
+     * Young DRC objects that are not referenced are garbage (nothing in the graph can reference them) and are freed
+     * right away, the other young objects are promoted in place: RC objects get registered and DRC objects join the
+     * DRC graph. Memory of the nursery is reused as its objects die.
+     *
+     * @param th Thread at a safe point.
+     */
+    static void nurseryCollect(Thread* th) noexcept {
+        th->_nursery.collectYoung([th](Nursery::ObjectHeader* header) {
+            void* p = header + 1;
+            if (header->kind == Nursery::Kind::RC) {
+                auto* link = static_cast<RCLink*>(p);
+                link->index = th->_rcObjects.size();
+                th->_rcObjects.push_back(link);
+                header->state = Nursery::State::Promoted;
+                return;
+            }
+
+            auto* obj = static_cast<DRCHeader*>(p);
+            if (obj->rcHeader.refCount == 0) {
+                // Young objects have no DRC node
+                th->_stats.recordFree(obj->rcHeader.type, obj->rcHeader.type->size());
+                obj->rcHeader.type->destruct(obj);
+                th->_nursery.free(obj);
+            } else {
+                promoteDRCObject(th, obj);
+            }
+        });
     }
 
     static RCHeader* newRCObject(Thread* th, const Type* type) noexcept {
-        RCHeader* obj = reinterpret_cast<RCHeader*>(th->_allocator.alloc(type->size()));
+        if (th->_regionDepth > 0) {
+            void* p = th->_region.alloc(type, sizeof(RCLink) + type->size(), sizeof(RCLink));
+            RCLink* link = new (p) RCLink{ 0, 0, { 0 } };
+            RCHeader* obj = objectOf(link);
+            obj->refCount = 0;
+            obj->type = type;
+            return obj;
+        }
+
+        if (th->_inbox->mergePending.load(std::memory_order_relaxed)) {
+            mergeRCObjects(th);
+        }
+        if (th->_inbox->remoteRCObjects.load(std::memory_order_relaxed) != nullptr) {
+            freeRemoteRCObjects(th);
+        }
+
+        RCLink* link;
+        TypePool* pool = poolOf(th, type);
+        void* p = pool != nullptr ? pool->rc.pop() : nullptr;
+        if (p == nullptr && (p = th->_nursery.alloc(sizeof(RCLink) + type->size(), Nursery::Kind::RC)) != nullptr) {
+            link = new (p) RCLink{ th->_index, YoungIndex, { 0 } };
+        } else {
+            if (p == nullptr) {
+                p = th->_allocator.alloc(sizeof(RCLink) + type->size());
+            }
+            link = new (p) RCLink{ th->_index, static_cast<uint32_t>(th->_rcObjects.size()), { 0 } };
+            th->_rcObjects.push_back(link);
+        }
+        th->_stats.recordAlloc(type, sizeof(RCLink) + type->size());
+
+        RCHeader* obj = objectOf(link);
         obj->refCount = 0;
         obj->type = type;
-        th->_rcObjects.insert(obj);
         return obj;
     }
 
+    /**
+     * Destructs and frees an RC object.
+     * The object may have been allocated by another thread, it's then destructed right away and handed back to the
+     * allocating thread, which frees it in a batch with its own allocator at its next allocation (or it's freed right
+     * away if that thread is destroyed).
+     *
+     * @param th Thread that deletes the object.
+     * @param obj RC object to delete.
+     */
     static void deleteRCObject(Thread* th, RCHeader* obj) noexcept {
-        obj->type->destruct(obj);
-        th->_allocator.free(obj);
+        RCLink* link = linkOf(obj);
+        if (link->owner == 0) {
+            // Region objects die with their region
+            return;
+        }
+
+        const Type* type = obj->type;
+        type->destruct(obj);
+        if (link->owner != th->_index) {
+            Inbox* owner = inboxOf(link->owner);
+            RCLink* next = owner->remoteRCObjects.load(std::memory_order_relaxed);
+            do {
+                if (next == &_closedInbox) {
+                    freeOrphan(owner, link);
+                    return;
+                }
+                link->next = next;
+            } while (!owner->remoteRCObjects.compare_exchange_weak(next, link, std::memory_order_release,
+                                                                   std::memory_order_relaxed));
+            return;
+        }
+
+        th->_stats.recordFree(type, sizeof(RCLink) + type->size());
+        unregisterRCObject(th, link);
+        recycleMemory(th, type, &TypePool::rc, link);
+    }
+
+    /**
+     * Retains an RC object (biased reference counting).
+     * The thread that allocated the object counts its references with plain arithmetic on `RCHeader::refCount`, other
+     * threads count theirs on an atomic shared count, so an object can be shared across the threads of a Spark
+     * context while its owner doesn't pay for atomic operations. Region objects are counted by their thread only.
+     *
+     * @param th Thread that retains the object.
+     * @param obj RC object to retain.
+     */
+    static void rcRetain(Thread* th, RCHeader* obj) noexcept {
+        RCLink* link = linkOf(obj);
+        if (link->owner == 0) {
+            retainRegionObject(th, obj);
+            return;
+        }
+        if (link->owner == th->_index && (link->sharedRefCount.load(std::memory_order_relaxed) & SharedMerged) == 0) {
+            incrementRefCount(obj);
+            return;
+        }
+        link->sharedRefCount.fetch_add(SharedOne, std::memory_order_relaxed);
+    }
+
+    /**
+     * Releases an RC object, deleting it with its last reference.
+     * When the owner drops its last reference, it merges its count into the shared one and the object dies with the
+     * last shared reference. A shared count going negative means that the owner's references have moved to other
+     * threads: the object is queued to its owner, which merges the counts at its next safe point (`rcSafePoint`).
+     *
+     * @param th Thread that releases the object.
+     * @param obj RC object to release.
+     */
+    static void rcRelease(Thread* th, RCHeader* obj) noexcept {
+        RCLink* link = linkOf(obj);
+        if (link->owner == 0) {
+            releaseRegionObject(th, obj);
+            return;
+        }
+        if (link->owner == th->_index && (link->sharedRefCount.load(std::memory_order_relaxed) & SharedMerged) == 0) {
+            if (decrementRefCount(obj)) {
+                int64_t shared = link->sharedRefCount.fetch_or(SharedMerged, std::memory_order_acq_rel);
+                // A queued object is deleted when its merge is processed
+                if (shared == 0) {
+                    deleteRCObject(th, obj);
+                }
+            }
+            return;
+        }
+
+        int64_t shared = link->sharedRefCount.load(std::memory_order_relaxed);
+        int64_t desired;
+        do {
+            desired = shared - SharedOne;
+            if ((desired & SharedMerged) == 0 && (desired & ~SharedFlags) < 0) {
+                desired |= SharedQueued;
+            }
+        } while (!link->sharedRefCount.compare_exchange_weak(shared, desired, std::memory_order_acq_rel,
+                                                             std::memory_order_relaxed));
+
+        if (desired == SharedMerged) {
+            deleteRCObject(th, obj);
+        } else if ((desired & SharedQueued) != 0 && (shared & SharedQueued) == 0) {
+            Inbox* owner = inboxOf(link->owner);
+            std::lock_guard lock(owner->mutex);
+            owner->mergeRCObjects.push_back(link);
+            owner->mergePending.store(true, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * Merges the counts of the RC objects queued to this thread by `rcRelease` (deleting the dead ones) and frees the
+     * RC objects of this thread deleted by other threads. Also done at every RC object allocation.
+     *
+     * @param th Thread at a safe point.
+     */
+    static void rcSafePoint(Thread* th) noexcept {
+        mergeRCObjects(th);
+        freeRemoteRCObjects(th);
     }
 
     static DRCHeader* newDRCObject(Thread* th, const Type* type) noexcept {
-        DRCHeader* obj = static_cast<DRCHeader*>(th->_allocator.alloc(type->size()));
+        DRCHeader* obj;
+        bool young = false;
+        if (th->_regionDepth > 0) {
+            obj = static_cast<DRCHeader*>(th->_region.alloc(type, type->size()));
+        } else {
+            TypePool* pool = poolOf(th, type);
+            obj = static_cast<DRCHeader*>(pool != nullptr ? pool->drc.pop() : nullptr);
+            if (obj == nullptr) {
+                obj = static_cast<DRCHeader*>(th->_nursery.alloc(type->size(), Nursery::Kind::DRC));
+                young = obj != nullptr;
+            }
+            if (obj == nullptr) {
+                obj = static_cast<DRCHeader*>(th->_allocator.alloc(type->size()));
+            }
+        }
         obj->rcHeader.refCount = 0;
         obj->rcHeader.type = type;
+        // Stores read the old value of traced fields (and the DRC graph reads them)
+        for (size_t offset : type->drcFields()) {
+            *fieldOf(obj, offset) = nullptr;
+        }
+        if (th->_regionDepth > 0) {
+            obj->node = nullptr;
+            return obj;
+        }
+
+        if (young) {
+            th->_stats.recordAlloc(type, type->size());
+            obj->node = &_youngNode;
+            return obj;
+        }
+        th->_stats.recordAlloc(type, type->size() + nodeSize(type));
+        GraphLock lock(th);
         obj->node = th->_drc.add(obj);
-        th->_drcObjects.insert(obj);
         return obj;
     }
 
     static void drcRetainDRC(Thread* th, DRCHeader* owner, DRCHeader* referencee) noexcept {
+        promoteIfYoung(th, owner);
+        promoteIfYoung(th, referencee);
+        if (owner->node == nullptr || referencee->node == nullptr) {
+            retainAcrossRegion(th, owner, referencee);
+            return;
+        }
+        GraphLock lock(th);
         th->_drc.retain(owner->node, referencee->node);
     }
 
     static void drcReleaseDRC(Thread* th, DRCHeader* owner, DRCHeader* referencee) noexcept {
-        const std::vector<DRCNode*>& toDelete = th->_drc.release(owner->node, referencee->node);
+        promoteIfYoung(th, owner);
+        promoteIfYoung(th, referencee);
+        if (owner->node == nullptr || referencee->node == nullptr) {
+            releaseAcrossRegion(th, owner, referencee);
+            return;
+        }
+        {
+            GraphLock lock(th);
+            detachDRCObjects(th, th->_drc.release(owner->node, referencee->node));
+            if (th->_collector != nullptr) {
+                handOverCandidates(th, false);
+            }
+        }
+        freeDRCObjects(th);
+    }
+
+    /**
+     * Stores a DRC reference into a DRC field of a DRC object, retaining the new referencee and releasing the old
+     * one. This is how the fields of traced objects (see `Type::drcFields`) are written, so that the graph sees the
+     * field and the reference counts change together.
+     *
+     * @param th Thread of the owner.
+     * @param owner DRC object that owns the field.
+     * @param offset Offset of the field in @p owner.
+     * @param referencee DRC object to store, nullptr to clear the field.
+     */
+    static void drcStoreDRC(Thread* th, DRCHeader* owner, size_t offset, DRCHeader* referencee) noexcept {
+        promoteIfYoung(th, owner);
+        promoteIfYoung(th, referencee);
+        DRCHeader** field = fieldOf(owner, offset);
+        DRCHeader* old = *field;
+        if (old == referencee) {
+            return;
+        }
+        if (owner->node == nullptr) {
+            // Region objects are never traversed
+            *field = referencee;
+            if (referencee != nullptr) {
+                drcRetainDRC(th, owner, referencee);
+            }
+            if (old != nullptr) {
+                drcReleaseDRC(th, owner, old);
+            }
+            return;
+        }
+
+        {
+            GraphLock lock(th);
+            *field = referencee;
+            if (referencee != nullptr) {
+                if (referencee->node != nullptr) {
+                    th->_drc.retain(owner->node, referencee->node);
+                } else {
+                    recordRegionEscape(th, owner, &referencee->rcHeader);
+                }
+            }
+        }
+        if (old != nullptr) {
+            drcReleaseDRC(th, owner, old);
+        }
+    }
+
+    /**
+     * Adds an external reference to a DRC object.
+     *
+     * @param th Thread of the object.
+     * @param obj DRC object to retain.
+     */
+    static void drcRetain(Thread* th, DRCHeader* obj) noexcept {
+        if (obj->node == nullptr) {
+            retainRegionObject(th, &obj->rcHeader);
+            return;
+        }
+        GraphLock lock(th);
+        incrementRefCount(&obj->rcHeader);
+    }
+
+    /**
+     * Drops an external reference to a DRC object. If it was the last one, the object is cleaned up from right away
+     * when it's definitely unreachable, otherwise it's buffered as a candidate root like on `drcReleaseDRC`.
+     * Young objects are left to the next minor collection.
+     *
+     * @param th Thread of the object.
+     * @param obj DRC object to release.
+     */
+    static void drcRelease(Thread* th, DRCHeader* obj) noexcept {
+        if (obj->node == nullptr) {
+            releaseRegionObject(th, &obj->rcHeader);
+            return;
+        }
+        if (obj->node == &_youngNode) {
+            decrementRefCount(&obj->rcHeader);
+            return;
+        }
+        unpinDRCObject(th, obj);
+        freeDRCObjects(th);
+    }
+
+    /**
+     * Creates a weak reference to a DRC object.
+     * Weak references are kept in a side table: they don't count as references in the DRC graph, so they don't keep
+     * the object alive nor form cycles, and they read nullptr once the object has been deleted. Use them for back
+     * pointers and caches instead of strong references that would need a cycle collection to be reclaimed.
+     *
+     * @param th Thread of the object.
+     * @param obj DRC object to weakly reference.
+     * @return Weak reference to release with `drcWeakRelease`, nullptr for region objects (which die with the region).
+     */
+    static DRCWeakRef* drcWeakRef(Thread* th, DRCHeader* obj) noexcept {
+        promoteIfYoung(th, obj);
+        if (obj->node == nullptr) {
+            return nullptr;
+        }
+        GraphLock lock(th);
+        return th->_drc.weakRetain(obj->node);
+    }
+
+    /**
+     * Releases a weak reference created by `drcWeakRef`.
+     *
+     * @param th Thread of the object.
+     * @param ref Weak reference to release.
+     */
+    static void drcWeakRelease(Thread* th, DRCWeakRef* ref) noexcept {
+        GraphLock lock(th);
+        th->_drc.weakRelease(ref);
+    }
+
+    /**
+     * Upgrades a weak reference to a strong one.
+     * The object may be unreachable but not collected yet (e.g. a buffered cycle), the new external reference then
+     * makes it reachable again.
+     *
+     * @param th Thread of the object.
+     * @param ref Weak reference to upgrade.
+     * @return Object with an external reference added (to drop with `drcRelease`), nullptr if it has been deleted or
+     *         is being deleted by an incremental cleanup.
+     */
+    static DRCHeader* drcWeakUpgrade(Thread* th, DRCWeakRef* ref) noexcept {
+        GraphLock lock(th);
+        DRCHeader* obj = th->_drc.weakUpgrade(ref);
+        if (obj != nullptr) {
+            incrementRefCount(&obj->rcHeader);
+        }
+        return obj;
+    }
+
+    /**
+     * Gets the allocation statistics of a thread (all zero unless built with `SPARK_RUNTIME_STATS`).
+     *
+     * @param th Thread to query.
+     * @return Allocation statistics of the thread.
+     */
+    static const ThreadStats& stats(Thread* th) noexcept {
+        return th->_stats;
+    }
+
+    /**
+     * Takes a snapshot of the objects of a thread and of the DRC edges between them, e.g. to be written with
+     * `writeHeapSnapshot` and analyzed offline by `sparkheap`. Region objects are not included.
+     *
+     * @param th Thread to snapshot.
+     * @return Heap snapshot of the thread.
+     */
+    static HeapSnapshot heapSnapshot(Thread* th) noexcept {
+        HeapSnapshot snapshot;
+        auto addRCObject = [&](RCLink* link, uint32_t flags) {
+            RCHeader* obj = objectOf(link);
+            const int64_t shared = link->sharedRefCount.load(std::memory_order_relaxed) & ~SharedFlags;
+            const int64_t refCount = static_cast<int64_t>(refCountOf(obj)) + shared / SharedOne;
+            snapshot.objects.push_back(HeapSnapshot::Object{
+                reinterpret_cast<uintptr_t>(obj), obj->type.index(),
+                static_cast<uint32_t>(sizeof(RCLink) + obj->type->size()), flags,
+                static_cast<uint64_t>(std::max<int64_t>(refCount, 0)), 0 });
+        };
+        auto addDRCObject = [&](DRCHeader* obj, uint32_t flags, RCInt internalRefCount) {
+            snapshot.objects.push_back(HeapSnapshot::Object{
+                reinterpret_cast<uintptr_t>(obj), obj->rcHeader.type.index(),
+                static_cast<uint32_t>(obj->rcHeader.type->size()), HeapSnapshot::DRCObject | flags,
+                refCountOf(&obj->rcHeader), internalRefCount });
+        };
+
+        for (RCLink* link : th->_rcObjects) {
+            addRCObject(link, 0);
+        }
+        th->_nursery.forEachYoung([&](Nursery::ObjectHeader* header) {
+            if (header->kind == Nursery::Kind::RC) {
+                addRCObject(reinterpret_cast<RCLink*>(header + 1), HeapSnapshot::Young);
+            } else {
+                addDRCObject(reinterpret_cast<DRCHeader*>(header + 1), HeapSnapshot::Young, 0);
+            }
+        });
+
+        GraphLock lock(th);
+        std::unordered_map<const DRCHeader*, uint32_t> indices;
+        th->_drc.forEachObject([&](DRCHeader* obj) {
+            indices.emplace(obj, static_cast<uint32_t>(snapshot.objects.size()));
+            addDRCObject(obj, 0, obj->node->internalRefCount);
+        });
+        th->_drc.forEachObject([&](DRCHeader* obj) {
+            const uint32_t from = indices.at(obj);
+            DRC::forEachEdge(obj->node, [&](DRCNode* referencee, RCInt count) {
+                snapshot.edges.push_back(HeapSnapshot::Edge{
+                    from, indices.at(referencee->obj), static_cast<uint32_t>(count) });
+            });
+        });
+        return snapshot;
+    }
+
+    /**
+     * Gets the statistics of the DRC graph of a thread (all zero unless built with `SPARK_RUNTIME_STATS`).
+     * With a background cycle collector, the statistics keep changing while it's working on the thread.
+     *
+     * @param th Thread to query.
+     * @return Statistics of the DRC graph.
+     */
+    static const DRCStats& drcStats(Thread* th) noexcept {
+        return th->_drc.stats();
+    }
+
+    /**
+     * Sets the handler called on references from outside the region of a thread into it.
+     *
+     * @param th Thread to configure.
+     * @param handler Handler to call, nullptr to only count escapes.
+     */
+    static void setRegionEscapeHandler(Thread* th, RegionEscapeHandler handler) noexcept {
+        th->_regionEscapeHandler = handler;
+    }
+
+    /**
+     * Gets the region of a thread, e.g. to query its escapes.
+     *
+     * @param th Thread to query.
+     * @return Region of the thread.
+     */
+    static const Region& region(Thread* th) noexcept {
+        return th->_region;
+    }
+
+    /**
+     * Sets the tracer that records the cleanup pauses of a thread, including the steps the background cycle
+     * collector runs on it.
+     *
+     * @param th Thread to trace.
+     * @param tracer Tracer to record to, nullptr to stop tracing.
+     */
+    static void setCleanupTracer(Thread* th, CleanupTracer* tracer) noexcept {
+        GraphLock lock(th);
+        th->_drc.setTracer(tracer);
+    }
+
+    /**
+     * Sets the number of buffered candidate roots that triggers a cycle collection (0 to clean up on every release).
+     * With a background cycle collector, it's the number of candidate roots that hands the thread over to it instead.
+     *
+     * @param th Thread to configure.
+     * @param threshold Candidate root buffer threshold.
+     * @see DRC::setCandidateThreshold
+     */
+    static void drcSetCandidateThreshold(Thread* th, size_t threshold) noexcept {
+        GraphLock lock(th);
+        if (th->_collector != nullptr) {
+            th->_collectorThreshold = threshold;
+        } else {
+            th->_drc.setCandidateThreshold(threshold);
+        }
+    }
+
+    /**
+     * Enables parallel cleanups of the DRC subgraphs of this thread larger than @p threshold nodes.
+     *
+     * @param th Thread to configure.
+     * @param threshold Number of nodes that makes a cleanup parallel, 0 to disable parallel cleanups.
+     * @param workers Number of worker threads, 0 for one per hardware thread.
+     * @see DRC::setParallelCleanup
+     */
+    static void drcSetParallelCleanup(Thread* th, size_t threshold, size_t workers = 0) noexcept {
+        GraphLock lock(th);
+        th->_drc.setParallelCleanup(threshold, workers);
+    }
+
+    /**
+     * Collects garbage cycles from every buffered candidate root on this thread, e.g. at a safe point of the thread.
+     *
+     * @param th Thread to collect.
+     */
+    static void drcCollectCycles(Thread* th) noexcept {
+        freeGarbage(th, SIZE_MAX);
+        {
+            GraphLock lock(th);
+            detachDRCObjects(th, th->_drc.collectCandidates());
+        }
+        freeDRCObjects(th);
+    }
+
+    /**
+     * Collects garbage cycles incrementally at a safe point of the thread, for at most (about) @p budget of time.
+     * Cleanups run from buffered candidate roots and resume where they left off at the next safe point, so setting a
+     * large candidate threshold and calling this regularly bounds the pause times of cycle collection. The garbage they
+     * find is destructed and freed in batches within the budget as well.
+     * With a background cycle collector, this only hands the buffered candidate roots over to it and frees the garbage
+     * it has found so far (within the budget).
+     *
+     * @param th Thread to collect.
+     * @param budget Time budget of the safe point.
+     * @return true if every candidate root has been processed, false if there's work left.
+     */
+    static bool drcSafePoint(Thread* th, std::chrono::nanoseconds budget) noexcept {
+        const auto deadline = std::chrono::steady_clock::now() + budget;
+        if (th->_collector != nullptr) {
+            bool done;
+            bool more;
+            {
+                GraphLock lock(th);
+                handOverCandidates(th, true);
+                done = !th->_collectorQueued;
+            }
+            do {
+                {
+                    GraphLock lock(th);
+                    more = takeCollected(th, IncrementalQuantum);
+                }
+                freeDRCObjects(th);
+            } while (more && std::chrono::steady_clock::now() < deadline);
+            return done && !more;
+        }
+
+        do {
+            if (!th->_garbage.empty()) {
+                freeGarbage(th, IncrementalQuantum);
+                continue;
+            }
+            if (!th->_drc.cleanupInProgress()) {
+                DRCNode* candidate = th->_drc.takeCandidate();
+                if (candidate == nullptr) {
+                    return true;
+                }
+                th->_drc.startCleanup(candidate);
+            }
+            if (th->_drc.stepCleanup(IncrementalQuantum) == DRC::CleanupStatus::Collected) {
+                th->_drc.takeCleanupResult(th->_garbage);
+            }
+        } while (std::chrono::steady_clock::now() < deadline);
+        return !th->_drc.cleanupInProgress() && th->_drc.candidateCount() == 0 &&
+               th->_garbage.empty();
+    }
+
+private:
+    static RCHeader* objectOf(RCLink* link) noexcept {
+        return reinterpret_cast<RCHeader*>(link + 1);
+    }
+
+    static RCLink* linkOf(RCHeader* obj) noexcept {
+        return reinterpret_cast<RCLink*>(obj) - 1;
+    }
+
+    /**
+     * Gets the inbox of a thread by its index in the thread table (see `RCLink::owner`).
+     */
+    static Inbox* inboxOf(uint32_t index) noexcept {
+        return _threadTable[index >> ThreadTableChunkBits][index & (ThreadTableChunkSize - 1)].load(
+            std::memory_order_relaxed);
+    }
+
+    /**
+     * Gets the size of the DRC node of an object of a type (spilled edge tables aside), for the statistics.
+     */
+    static size_t nodeSize(const Type* type) noexcept {
+        return sizeof(DRCNode) + (type->traced() ? 0 : sizeof(DRCEdgeList));
+    }
+
+    /**
+     * Frees the memory of an object, from the nursery or the allocator.
+     */
+    static void freeMemory(Thread* th, void* p) noexcept {
+        if (th->_nursery.contains(p)) {
+            th->_nursery.free(p);
+        } else {
+            th->_allocator.free(p);
+        }
+    }
+
+    /**
+     * Gets the pool of a type without allocating, resetting it if it was used by a destroyed type with the same index.
+     *
+     * @return Pool of the type, nullptr if its chunk isn't allocated yet.
+     */
+    static TypePool* poolOf(Thread* th, const Type* type) noexcept {
+        const uint32_t index = type->index();
+        const uint32_t chunk = index >> PoolChunkBits;
+        if (chunk >= th->_pools.size() || th->_pools[chunk] == nullptr) {
+            return nullptr;
+        }
+        TypePool& pool = th->_pools[chunk][index & (PoolChunkSize - 1)];
+        if (pool.typeSerial != type->serial()) {
+            flushPool(th, pool);
+            pool.capacity = DefaultPoolCapacity;
+            pool.typeSerial = type->serial();
+        }
+        return &pool;
+    }
+
+    /**
+     * Gets the pool of a type, allocating its chunk if needed.
+     *
+     * @throws std::bad_alloc if the chunk can't be allocated.
+     */
+    static TypePool& createPool(Thread* th, const Type* type) {
+        const uint32_t chunk = type->index() >> PoolChunkBits;
+        if (chunk >= th->_pools.size()) {
+            th->_pools.resize(chunk + 1);
+        }
+        if (th->_pools[chunk] == nullptr) {
+            th->_pools[chunk] = std::make_unique<TypePool[]>(PoolChunkSize);
+        }
+        return *poolOf(th, type);
+    }
+
+    static void trimPool(Thread* th, PoolList& list, size_t capacity) noexcept {
+        while (list.count > capacity) {
+            th->_allocator.free(list.pop());
+        }
+    }
+
+    static void flushPool(Thread* th, TypePool& pool) noexcept {
+        trimPool(th, pool.rc, 0);
+        trimPool(th, pool.drc, 0);
+    }
+
+    static void reservePool(Thread* th, TypePool& pool, PoolList TypePool::* kind, size_t size, size_t n) noexcept {
+        PoolList& list = pool.*kind;
+        if (pool.capacity < n) {
+            pool.capacity = n;
+        }
+        while (list.count < n) {
+            void* p = th->_allocator.alloc(size);
+            if (p == nullptr) {
+                return;
+            }
+            list.push(p);
+        }
+    }
+
+    /**
+     * Frees the memory of a destructed object: to the nursery, its type pool (if not full) or the allocator.
+     */
+    static void recycleMemory(Thread* th, const Type* type, PoolList TypePool::* kind, void* p) noexcept {
+        if (th->_nursery.contains(p)) {
+            th->_nursery.free(p);
+            return;
+        }
+        TypePool* pool = poolOf(th, type);
+        if (pool == nullptr) {
+            try {
+                pool = &createPool(th, type);
+            } catch (const std::bad_alloc&) {
+                th->_allocator.free(p);
+                return;
+            }
+        }
+        PoolList& list = pool->*kind;
+        if (list.count < pool->capacity) {
+            list.push(p);
+        } else {
+            th->_allocator.free(p);
+        }
+    }
+
+    /**
+     * Adds a young DRC object to the DRC graph.
+     */
+    static void promoteDRCObject(Thread* th, DRCHeader* obj) noexcept {
+        Nursery::headerOf(obj)->state = Nursery::State::Promoted;
+        th->_stats.recordBytes(nodeSize(obj->rcHeader.type));
+        GraphLock lock(th);
+        obj->node = th->_drc.add(obj);
+    }
+
+    static void promoteIfYoung(Thread* th, DRCHeader* obj) noexcept {
+        if (obj != nullptr && obj->node == &_youngNode) {
+            promoteDRCObject(th, obj);
+        }
+    }
+
+    static DRCHeader** fieldOf(DRCHeader* obj, size_t offset) noexcept {
+        return reinterpret_cast<DRCHeader**>(reinterpret_cast<char*>(obj) + offset);
+    }
+
+    /**
+     * Removes an RC object from the registry of its thread (swapping the last one into its place), if registered.
+     */
+    static void unregisterRCObject(Thread* th, RCLink* link) noexcept {
+        if (link->index == YoungIndex) {
+            return;
+        }
+        RCLink* last = th->_rcObjects.back();
+        th->_rcObjects[link->index] = last;
+        last->index = link->index;
+        th->_rcObjects.pop_back();
+    }
+
+    /**
+     * Merges the owner counts of the RC objects queued to a thread into their shared counts, deleting the dead ones.
+     */
+    static void mergeRCObjects(Thread* th) noexcept {
+        if (!th->_inbox->mergePending.load(std::memory_order_relaxed)) {
+            return;
+        }
+        {
+            std::lock_guard lock(th->_inbox->mutex);
+            th->_mergeBatch.swap(th->_inbox->mergeRCObjects);
+            th->_inbox->mergePending.store(false, std::memory_order_relaxed);
+        }
+        for (RCLink* link : th->_mergeBatch) {
+            RCHeader* obj = objectOf(link);
+            const auto biased = static_cast<int64_t>(refCountOf(obj));
+            resetRefCount(obj);
+
+            int64_t shared = link->sharedRefCount.load(std::memory_order_relaxed);
+            int64_t desired;
+            do {
+                // Already merged if the owner dropped its last reference in the meantime (then biased is 0)
+                desired = ((shared + biased * SharedOne) | SharedMerged) & ~SharedQueued;
+            } while (!link->sharedRefCount.compare_exchange_weak(shared, desired, std::memory_order_acq_rel,
+                                                                 std::memory_order_relaxed));
+            if (desired == SharedMerged) {
+                deleteRCObject(th, obj);
+            }
+        }
+        th->_mergeBatch.clear();
+    }
+
+    /**
+     * Unregisters and frees the RC objects of a thread deleted by other threads.
+     */
+    static void freeRemoteRCObjects(Thread* th) noexcept {
+        freeRCObjects(th, th->_inbox->remoteRCObjects.exchange(nullptr, std::memory_order_acquire));
+    }
+
+    /**
+     * Unregisters and frees a list of destructed RC objects of a thread (see `Inbox::remoteRCObjects`).
+     */
+    static void freeRCObjects(Thread* th, RCLink* link) noexcept {
+        while (link != nullptr) {
+            RCHeader* obj = objectOf(link);
+            RCLink* next = link->next;
+            th->_stats.recordFree(obj->type, sizeof(RCLink) + obj->type->size());
+            unregisterRCObject(th, link);
+            recycleMemory(th, obj->type, &TypePool::rc, link);
+            link = next;
+        }
+    }
+
+    /**
+     * Checks if an RC object of a thread being destroyed is still referenced by other threads, leaving it to them
+     * (merged, without the references of the thread). The object is being deleted by another thread if its shared
+     * count is merged and 0.
+     *
+     * @return true if the object is left to other threads, false if it's to be destructed with the thread.
+     */
+    static bool orphanRCObject(RCLink* link) noexcept {
+        int64_t shared = link->sharedRefCount.load(std::memory_order_relaxed);
+        do {
+            if ((shared & SharedMerged) != 0) {
+                return true;
+            }
+            if ((shared & ~SharedFlags) <= 0) {
+                return false;
+            }
+        } while (!link->sharedRefCount.compare_exchange_weak(shared, (shared | SharedMerged) & ~SharedQueued,
+                                                             std::memory_order_acq_rel, std::memory_order_relaxed));
+        return true;
+    }
+
+    /**
+     * Frees a destructed RC object of a destroyed thread, unregistering the thread with its last object.
+     */
+    static void freeOrphan(Inbox* inbox, RCLink* link) noexcept {
+        bool last;
+        {
+            std::lock_guard lock(inbox->mutex);
+            typename Inbox::Orphanage& orphanage = *inbox->orphanage;
+            if (orphanage.nursery.contains(link)) {
+                orphanage.nursery.free(link);
+            } else {
+                orphanage.allocator.free(link);
+            }
+            last = --orphanage.count == 0;
+        }
+        if (last) {
+            ThreadTable::instance().remove(inbox);
+        }
+    }
+
+    /**
+     * Removes deleted DRC nodes from the graph (with the graph locked), keeping their objects to be freed by
+     * `freeDRCObjects`. Garbage found by the background cycle collector is taken over as well.
+     */
+    static void detachDRCObjects(Thread* th, const std::vector<DRCNode*>& toDelete) noexcept {
         for (DRCNode* node : toDelete) {
-            DRCHeader* obj = node->obj;
-            node->obj->rcHeader.type->destruct(obj);
-            th->_allocator.free(obj);
+            th->_freeCache.push_back(node->obj);
+            th->_drc.remove(node);
+        }
+        takeCollected(th, SIZE_MAX);
+    }
+
+    /**
+     * Takes at most @p limit objects of the garbage found by the background cycle collector to be freed by
+     * `freeDRCObjects` (with the graph locked).
+     *
+     * @return true if there's garbage left.
+     */
+    static bool takeCollected(Thread* th, size_t limit) noexcept {
+        for (; limit > 0 && !th->_collected.empty(); --limit) {
+            th->_freeCache.push_back(th->_collected.back());
+            th->_collected.pop_back();
+        }
+        return !th->_collected.empty();
+    }
+
+    /**
+     * Destructs and frees the detached DRC objects (with the graph unlocked).
+     */
+    static void freeDRCObjects(Thread* th) noexcept {
+        for (DRCHeader* obj : th->_freeCache) {
+            const Type* type = obj->rcHeader.type;
+            th->_stats.recordFree(type, type->size() + nodeSize(type));
+            type->destruct(obj);
+            recycleMemory(th, type, &TypePool::drc, obj);
+        }
+        th->_freeCache.clear();
+    }
+
+    /**
+     * Removes at most @p limit nodes of the garbage found by incremental cleanups from the DRC graph, then destructs and
+     * frees their objects.
+     */
+    static void freeGarbage(Thread* th, size_t limit) noexcept {
+        for (; limit > 0 && !th->_garbage.empty(); --limit) {
+            DRCNode* node = th->_garbage.front();
+            th->_garbage.pop_front();
+            th->_freeCache.push_back(node->obj);
+            th->_drc.remove(node);
+        }
+        freeDRCObjects(th);
+    }
+
+    /**
+     * Retains a reference from or to a region object (at least one of them has no DRC node).
+     */
+    static void retainAcrossRegion(Thread* th, DRCHeader* owner, DRCHeader* referencee) noexcept {
+        if (owner->node == nullptr && referencee->node != nullptr) {
+            // The region holds the referencee until it's released
+            GraphLock lock(th);
+            incrementRefCount(&referencee->rcHeader);
+            th->_region.pins().push_back(referencee);
+        } else if (owner->node != nullptr) {
+            recordRegionEscape(th, owner, &referencee->rcHeader);
+        }
+    }
+
+    static void recordRegionEscape(Thread* th, DRCHeader* owner, RCHeader* referencee) noexcept {
+        th->_region.recordEscape();
+        if (th->_regionEscapeHandler != nullptr) {
+            th->_regionEscapeHandler(owner, referencee);
+        }
+    }
+
+    /**
+     * Releases a reference from or to a region object (at least one of them has no DRC node).
+     */
+    static void releaseAcrossRegion(Thread* th, DRCHeader* owner, DRCHeader* referencee) noexcept {
+        if (owner->node == nullptr && referencee->node != nullptr && th->_region.unpin(referencee)) {
+            unpinDRCObject(th, referencee);
+            freeDRCObjects(th);
+        }
+    }
+
+    /**
+     * Drops an external reference to a DRC object (from the mutator or a region pin). The last one makes the object a
+     * candidate root, cleaned up from as the candidate threshold, safe points or the cycle collector decide.
+     */
+    static void unpinDRCObject(Thread* th, DRCHeader* obj) noexcept {
+        GraphLock lock(th);
+        if (decrementRefCount(&obj->rcHeader)) {
+            detachDRCObjects(th, th->_drc.releaseExternal(obj->node));
+            if (th->_collector != nullptr) {
+                handOverCandidates(th, false);
+            }
+        }
+    }
+
+    /**
+     * Adds an external reference to a region object, tracking it in the region until its last one is dropped.
+     */
+    static void retainRegionObject(Thread* th, RCHeader* obj) noexcept {
+        if (refCountOf(obj) == 0) {
+            th->_region.held().push_back(obj);
+        }
+        incrementRefCount(obj);
+    }
+
+    /**
+     * Drops an external reference to a region object (it still dies with the region).
+     */
+    static void releaseRegionObject(Thread* th, RCHeader* obj) noexcept {
+        if (!decrementRefCount(obj)) {
+            return;
+        }
+        // Handles are mostly dropped in the reverse order they were taken
+        std::vector<RCHeader*>& held = th->_region.held();
+        auto it = std::find(held.rbegin(), held.rend(), obj);
+        assert(it != held.rend() && "unbalanced release of a region object");
+        if (it == held.rend()) {
+            return;
+        }
+        *it = held.back();
+        held.pop_back();
+    }
+
+    /**
+     * Releases the region of a thread, then the objects it pinned.
+     * The region objects still externally referenced are reported as escapes first.
+     */
+    static void releaseRegion(Thread* th) noexcept {
+        for (RCHeader* obj : th->_region.held()) {
+            resetRefCount(obj);
+            recordRegionEscape(th, nullptr, obj);
+        }
+        th->_region.held().clear();
+
+        std::vector<DRCHeader*> pins = std::move(th->_region.pins());
+        th->_region.pins().clear();
+        th->_region.release();
+        for (DRCHeader* obj : pins) {
+            unpinDRCObject(th, obj);
+        }
+        freeDRCObjects(th);
+    }
+
+    /**
+     * Queues the thread to the background cycle collector if it has enough candidate roots (with the graph locked).
+     *
+     * @param force Whether to hand over any number of candidate roots.
+     */
+    static void handOverCandidates(Thread* th, bool force) noexcept {
+        const size_t count = th->_drc.candidateCount();
+        if (!th->_collectorQueued && count > 0 && (force || count >= th->_collectorThreshold)) {
+            th->_collector->enqueue(th);
         }
     }
 };
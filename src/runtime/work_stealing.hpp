@@ -0,0 +1,127 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace Spark::Runtime {
+
+/**
+ * Reusable barrier for a fixed number of threads (`std::barrier` is C++20).
+ */
+class Barrier {
+private:
+    std::mutex _mutex;
+    std::condition_variable _released;
+    size_t _count;
+    size_t _waiting = 0;
+    size_t _generation = 0;
+
+public:
+    explicit Barrier(size_t count) noexcept : _count(count) { }
+
+    Barrier(const Barrier& other) = delete;
+    Barrier& operator=(const Barrier& other) = delete;
+
+    /**
+     * Blocks until every thread arrived, everything done before arriving happens before everything done after.
+     */
+    void arriveAndWait() noexcept {
+        std::unique_lock<std::mutex> lock(_mutex);
+        const size_t generation = _generation;
+        if (++_waiting == _count) {
+            _waiting = 0;
+            ++_generation;
+            _released.notify_all();
+            return;
+        }
+        _released.wait(lock, [&] { return _generation != generation; });
+    }
+};
+
+/**
+ * Frontier of a graph traversal shared by a fixed number of workers.
+ * Each worker pushes to and pops from the back of its own queue, and steals from the front of the others' when it runs
+ * out of work. The traversal is over once every pushed item has been processed (see `drain`).
+ *
+ * @tparam T Type of the items.
+ */
+template <typename T>
+class WorkStealingFrontier {
+private:
+    struct alignas(64) Queue {
+        std::mutex mutex;
+        std::deque<T> items;
+    };
+
+    std::unique_ptr<Queue[]> _queues;
+    size_t _workerCount;
+
+    /**
+     * Number of items pushed but not processed yet.
+     */
+    std::atomic<size_t> _pending = 0;
+
+public:
+    explicit WorkStealingFrontier(size_t workerCount)
+        : _queues(std::make_unique<Queue[]>(workerCount)), _workerCount(workerCount) { }
+
+    WorkStealingFrontier(const WorkStealingFrontier& other) = delete;
+    WorkStealingFrontier& operator=(const WorkStealingFrontier& other) = delete;
+
+    void push(size_t worker, T item) {
+        _pending.fetch_add(1, std::memory_order_relaxed);
+        Queue& queue = _queues[worker];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.items.push_back(item);
+    }
+
+    /**
+     * Processes items with @p f as `f(T item)` (which may push more) until the traversal is over.
+     *
+     * @param worker Index of the calling worker.
+     */
+    template <typename F>
+    void drain(size_t worker, F&& f) {
+        T item;
+        while (true) {
+            if (pop(worker, item)) {
+                f(item);
+                _pending.fetch_sub(1, std::memory_order_acq_rel);
+            } else if (_pending.load(std::memory_order_acquire) == 0) {
+                return;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+private:
+    bool pop(size_t worker, T& item) {
+        {
+            Queue& queue = _queues[worker];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (!queue.items.empty()) {
+                item = queue.items.back();
+                queue.items.pop_back();
+                return true;
+            }
+        }
+        for (size_t i = 1; i < _workerCount; ++i) {
+            Queue& queue = _queues[(worker + i) % _workerCount];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (!queue.items.empty()) {
+                item = queue.items.front();
+                queue.items.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+} // Spark::Runtime
@@ -26,6 +26,21 @@ TEST(NameValueInternerTest, Deduplication) {
     EXPECT_NE(x1, y);
 }
 
+TEST(NameValueInternerTest, Identifiers) {
+    NameValueInterner interner;
+
+    std::string name = "x";
+    auto x1 = interner.internIdentifier(name);
+    name = "y";
+    auto y = interner.internIdentifier(name);
+    auto x2 = interner.internIdentifier("x");
+
+    EXPECT_EQ(x1, x2);
+    EXPECT_EQ(x1, interner.intern(NameValue::identifier("x")));
+    EXPECT_NE(x1, y);
+    EXPECT_EQ(x1.str(), "x");
+}
+
 TEST(NameValueInternerTest, SpecialNames) {
     NameValueInterner interner;
 
@@ -0,0 +1,114 @@
+﻿#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "frontend/lexer.hpp"
+
+using namespace Spark;
+using namespace Spark::FrontEnd;
+
+namespace {
+    struct LexedToken {
+        TokenType type;
+        TokenValue value;
+        yy::parser::location_type loc;
+    };
+
+    std::vector<LexedToken> lexWith(SourceBuffer srcbuf, LexerBackend backend, std::vector<Error>& errors,
+                                    std::vector<std::string>& lexemes) {
+        Lexer lexer(std::move(srcbuf), backend);
+        std::vector<LexedToken> tokens;
+        while (true) {
+            yy::parser::semantic_type semanticType;
+            yy::parser::location_type loc;
+            auto type = static_cast<TokenType>(yylex(&semanticType, &loc, lexer));
+            const TokenValue& value = semanticType.as<TokenValue>();
+            tokens.push_back(LexedToken{type, value, loc});
+            lexemes.emplace_back(value.lexeme);
+            if (type == TokenType::EndOfFile) {
+                break;
+            }
+        }
+        errors = lexer.errors();
+        return tokens;
+    }
+
+    /**
+     * Checks that both backends produce the same tokens, locations and errors.
+     */
+    void differentialTest(const SourceBuffer& srcbuf, std::string_view name) {
+        std::vector<Error> flexErrors;
+        std::vector<Error> directErrors;
+        std::vector<std::string> flexLexemes;
+        std::vector<std::string> directLexemes;
+        std::vector<LexedToken> flex = lexWith(srcbuf, LexerBackend::Flex, flexErrors, flexLexemes);
+        std::vector<LexedToken> direct = lexWith(srcbuf, LexerBackend::Direct, directErrors, directLexemes);
+
+        ASSERT_EQ(flex.size(), direct.size()) << name;
+        for (size_t i = 0; i < flex.size(); ++i) {
+            ASSERT_EQ(flex[i].type, direct[i].type) << name << ", token " << i;
+            ASSERT_EQ(flexLexemes[i], directLexemes[i]) << name << ", token " << i;
+            ASSERT_EQ(flex[i].value.start, direct[i].value.start) << name << ", token " << i;
+            ASSERT_EQ(flex[i].value.end, direct[i].value.end) << name << ", token " << i;
+            ASSERT_EQ(flex[i].loc.begin.line, direct[i].loc.begin.line) << name << ", token " << i;
+            ASSERT_EQ(flex[i].loc.begin.column, direct[i].loc.begin.column) << name << ", token " << i;
+            ASSERT_EQ(flex[i].loc.end.line, direct[i].loc.end.line) << name << ", token " << i;
+            ASSERT_EQ(flex[i].loc.end.column, direct[i].loc.end.column) << name << ", token " << i;
+        }
+
+        ASSERT_EQ(flexErrors.size(), directErrors.size()) << name;
+        for (size_t i = 0; i < flexErrors.size(); ++i) {
+            EXPECT_EQ(flexErrors[i].message, directErrors[i].message) << name << ", error " << i;
+            EXPECT_EQ(flexErrors[i].start, directErrors[i].start) << name << ", error " << i;
+            EXPECT_EQ(flexErrors[i].end, directErrors[i].end) << name << ", error " << i;
+        }
+    }
+}
+
+TEST(DirectLexerTest, DataFiles) {
+    size_t count = 0;
+    for (const auto& entry : std::filesystem::directory_iterator(SPARK_TEST_DATA_DIR)) {
+        if (entry.path().extension() == ".spark") {
+            differentialTest(SourceBuffer::fromFile(entry.path().string()), entry.path().filename().string());
+            ++count;
+        }
+    }
+    EXPECT_GT(count, 0);
+}
+
+TEST(DirectLexerTest, EdgeCases) {
+    const char* sources[] = {
+        "", " ", "\r", "\r\r", "\r \t\r\n", " \r\n", "\r\n\r", "\n\r\n\r",
+        "1.5 _1.5 _.5 1..5 1. 1.x ..5 0b101 0b2 0o17 0o8 0x_ 0xFF_ff 0b1.5 12_3.4_ __x _ _. 0B1 0O7 0X9",
+        "...< ..< ... .. . !== != ! === => == = ?\?= ?? ?! ? -> -= - += + |> || |= | && &= & ^= ^ %= % ~ <= < >= >",
+        "//", "// comment\r\nx", "//*x", "/=/*/", "/**/", "/* * / ** \r\n \r \n */ */", "/* unterminated\n*",
+        "\"\"", "''", "'\"'", "\"'\"", "\"a\\nb\\tc\\rd\\\\e\\\"f\\'g\"", "\"\\q\\\r\"", "\"\\\n\"", "\"\\",
+        "\"unterminated\r\nx", "\"unterminated\rx", "'unterminated", "\"x\\q", "\"esc\\n\nx\"",
+        "\"\"\"a\"b''c\r\n\\n\r\"\"\"x", "'''\"\"\"'''", "\"\"\"\"\"\"\"\"", "''''", "\"\"\"unterminated\r\n", "'''\\",
+        "#`\\\x01\xC3\xA9", "@foo.bar $x", "a\tb  c\r\rd",
+    };
+    for (const char* source : sources) {
+        differentialTest(SourceBuffer(std::string_view(source)), source);
+    }
+}
+
+TEST(DirectLexerTest, Fuzz) {
+    const char* fragments[] = {
+        "a", "Z", "_", "let", "end", "0", "1", "9", "b", "o", "x", "f", ".", "..", "..<", "/", "*", "//", "/*",
+        "*/", "\"", "'", "\\", "\\n", "\\q", "\r", "\n", "\r\n", " ", "\t", "=", "!", "?", "<", ">", "+", "-", "|",
+        "&", "^", "%", "~", ",", ";", "(", ")", "[", "]", "{", "}", "@", "$", "#", "\xC3\xA9",
+        "\"\"\"", "'''",
+    };
+    std::mt19937 rng(20241018);
+    for (int round = 0; round < 2000; ++round) {
+        std::string source;
+        const size_t count = rng() % 40;
+        for (size_t i = 0; i < count; ++i) {
+            source += fragments[rng() % std::size(fragments)];
+        }
+        differentialTest(SourceBuffer(std::string_view(source)), source);
+    }
+}
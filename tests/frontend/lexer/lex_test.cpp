@@ -13,7 +13,7 @@ static void lexTest(std::string_view source, const std::vector<TT>& expectedType
     std::string s = std::string{source};
     s.erase(std::remove(s.begin(), s.end(), '\r'), s.end());
     std::istringstream iss{s};
-    auto [actualToks, _, diagnostics] = Lexer::lexAll(iss);
+    auto [actualToks, srcbuf, diagnostics, lexemes] = Lexer::lexAll(iss);
 
     EXPECT_EQ(actualToks.size(), expectedTypes.size()) << "Number of tokens mismatched\n";
     for (size_t i = 0; i < actualToks.size(); ++i) {
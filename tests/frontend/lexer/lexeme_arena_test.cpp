@@ -0,0 +1,32 @@
+﻿#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "frontend/lexer/lexeme_arena.hpp"
+
+using namespace Spark::FrontEnd;
+
+TEST(LexemeArenaTest, StoreTest) {
+    LexemeArena arena;
+    EXPECT_EQ(arena.store(""), "");
+
+    // Lexemes keep their address as more are stored, large ones included
+    std::vector<std::string> expected;
+    std::vector<std::string_view> stored;
+    for (size_t i = 0; i < 2000; ++i) {
+        expected.push_back(std::string(i % 7 == 0 ? i * 3 : i % 13, static_cast<char>('a' + i % 26)));
+        stored.push_back(arena.store(expected.back()));
+        EXPECT_NE(stored.back().data(), expected.back().data());
+    }
+
+    // Moving the arena doesn't move the lexemes
+    LexemeArena moved(std::move(arena));
+    moved.store("foo");
+    for (size_t i = 0; i < expected.size(); ++i) {
+        EXPECT_EQ(stored[i], expected[i]);
+    }
+
+    // A moved-from arena is empty but usable
+    EXPECT_EQ(arena.store("bar"), "bar");
+}
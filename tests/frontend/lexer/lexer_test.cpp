@@ -13,7 +13,7 @@ static void lexTest(std::string_view source, const std::vector<Token>& expected)
     std::string s = std::string{source};
     s.erase(std::remove(s.begin(), s.end(), '\r'), s.end());
     std::istringstream iss{s};
-    auto [actualToks, _, diagnostics] = Lexer::lexAll(iss);
+    auto [actualToks, srcbuf, diagnostics, lexemes] = Lexer::lexAll(iss);
 
     EXPECT_EQ(actualToks.size(), expected.size()) << "Number of tokens mismatched\n";
     for (size_t i = 0; i < actualToks.size(); ++i) {
@@ -438,6 +438,32 @@ TEST(LexerTest, StringTests) {
         {TT::String, "...", 1, 1},
         {TT::Integer, "123", 1, 6}
     });
+
+    // Long string spanning lines, taken as is
+    source = "\"\"\"a \"b\" 'c' \\n\nd\"\"\"x";
+    lexTest(source, {
+        {TT::String, "a \"b\" 'c' \\n\nd", 1, 1},
+        {TT::Identifier, "x", 2, 5}
+    });
+
+    // Long string closed by its own delimiter only
+    source = R"('''..."""...'''"...")";
+    lexTest(source, {
+        {TT::String, "...\"\"\"...", 1, 1},
+        {TT::String, "...", 1, 16}
+    });
+
+    // Empty long string
+    source = R"("""""")";
+    lexTest(source, {
+        {TT::String, "", 1, 1}
+    });
+
+    // Unterminated long string
+    source = "'''...\n...";
+    lexTest(source, {
+        {TT::String, "...\n...", 1, 1}
+    });
 }
 
 TEST(LexerTest, AnnotationAndUpvalueTests) {
@@ -498,3 +524,17 @@ TEST(LexerTest, AnnotationAndUpvalueTests) {
         {TT::Identifier, "bar", 1, 7}
     });
 }
+
+TEST(LexerTest, LexemesOutliveMoves) {
+    // A short source and its lexemes stay in place when the result is moved
+    std::istringstream iss{"x = \"a\\nb\""};
+    LexResult result = Lexer::lexAll(iss);
+    const char* text = result.srcbuf.text().data();
+    LexResult moved = std::move(result);
+    result = LexResult();
+    EXPECT_EQ(moved.srcbuf.text().data(), text);
+    ASSERT_EQ(moved.tokens.size(), 3);
+    EXPECT_EQ(moved.tokens[0].lexeme, "x");
+    EXPECT_EQ(moved.tokens[1].lexeme, "=");
+    EXPECT_EQ(moved.tokens[2].lexeme, "a\nb");
+}
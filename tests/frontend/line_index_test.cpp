@@ -0,0 +1,53 @@
+﻿#include <gtest/gtest.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "frontend/line_index.hpp"
+
+using namespace Spark::FrontEnd;
+
+static const LineScanner scanners[] = { LineScanner::Scalar, LineScanner::SSE2, LineScanner::AVX2 };
+
+TEST(LineIndexTest, Newlines) {
+    for (LineScanner scanner : scanners) {
+        if (!isLineScannerSupported(scanner)) {
+            continue;
+        }
+        std::vector<uint32_t> starts;
+        appendLineStarts("a\r\nb\nc\rd\r\ne\n\r\nf\r", 0, starts, scanner);
+        EXPECT_EQ(starts, (std::vector<uint32_t>{ 3, 5, 7, 10, 12, 14, 16 }));
+
+        starts.clear();
+        appendLineStarts("a\nb\nc", 2, starts, scanner);
+        EXPECT_EQ(starts, (std::vector<uint32_t>{ 4 }));
+    }
+}
+
+TEST(LineIndexTest, ScannersAgree) {
+    ASSERT_TRUE(isLineScannerSupported(bestLineScanner()));
+
+    // Newlines at every offset within and across vector boundaries
+    std::mt19937 rng(42);
+    const char alphabet[] = { 'a', 'b', ' ', '\n', '\r' };
+    for (size_t size : { 0, 1, 15, 16, 17, 31, 32, 33, 63, 64, 65, 200, 1000 }) {
+        for (int round = 0; round < 20; ++round) {
+            std::string src(size, 'x');
+            for (char& c : src) {
+                c = alphabet[rng() % sizeof(alphabet)];
+            }
+            const size_t beginIndex = size == 0 ? 0 : rng() % size;
+            std::vector<uint32_t> expected;
+            appendLineStarts(src, beginIndex, expected, LineScanner::Scalar);
+            for (LineScanner scanner : scanners) {
+                if (!isLineScannerSupported(scanner)) {
+                    continue;
+                }
+                std::vector<uint32_t> starts;
+                appendLineStarts(src, beginIndex, starts, scanner);
+                EXPECT_EQ(starts, expected) << "size " << size << ", scanner " << static_cast<int>(scanner);
+            }
+        }
+    }
+}
@@ -1,7 +1,13 @@
 ﻿#include <gtest/gtest.h>
 
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <fstream>
 #include <string>
 #include <string_view>
+#include <thread>
 
 #include "frontend/source_buffer.hpp"
 
@@ -98,3 +104,104 @@ TEST(SourceBufferTest, NoNewline) {
         "foobar"
     });
 }
+
+TEST(SourceBufferTest, LoadMore) {
+    SourceBuffer srcbuf("foo\nba");
+    std::istringstream iss("r\r");
+    srcbuf.load(iss);
+    ASSERT_EQ(srcbuf.lineNum(), 3);
+    EXPECT_EQ(srcbuf.getLine(2), "bar");
+
+    // The CR and the LF make a single CRLF
+    iss = std::istringstream("\nbaz");
+    srcbuf.load(iss);
+    ASSERT_EQ(srcbuf.lineNum(), 3);
+    EXPECT_EQ(srcbuf.getLine(1), "foo");
+    EXPECT_EQ(srcbuf.getLine(2), "bar");
+    EXPECT_EQ(srcbuf.getLine(3), "baz");
+    EXPECT_EQ(srcbuf.get({2, 1}, {3, 1}), "bar\r\nb");
+
+    EXPECT_THROW((void) srcbuf.getLine(0), std::out_of_range);
+    EXPECT_THROW((void) srcbuf.getLine(4), std::out_of_range);
+}
+
+namespace {
+    /**
+     * Temporary file removed when going out of scope.
+     */
+    class TempFile {
+    private:
+        std::string _path;
+
+    public:
+        explicit TempFile(std::string_view content) {
+            char tmpl[] = "/tmp/sparkXXXXXX";
+            int fd = mkstemp(tmpl);
+            _path = tmpl;
+            close(fd);
+            std::ofstream(_path, std::ios::binary) << content;
+        }
+
+        ~TempFile() {
+            std::remove(_path.c_str());
+        }
+
+        [[nodiscard]]
+        const std::string& path() const noexcept { return _path; }
+    };
+}
+
+TEST(SourceBufferTest, FromFile) {
+    TempFile file("\xEF\xBB\xBF" "foo\r\nbar\n");
+    SourceBuffer srcbuf = SourceBuffer::fromFile(file.path());
+    EXPECT_EQ(srcbuf.text(), "foo\r\nbar\n");
+    ASSERT_EQ(srcbuf.lineNum(), 3);
+    EXPECT_EQ(srcbuf.getLine(1), "foo");
+    EXPECT_EQ(srcbuf.getLine(2), "bar");
+    EXPECT_EQ(srcbuf.get({1, 2}, {2, 1}), "oo\r\nb");
+
+    // Copies share the mapping
+    SourceBuffer copy = srcbuf;
+    srcbuf = SourceBuffer();
+    EXPECT_EQ(copy.getLine(2), "bar");
+
+    // Loading more copies the mapped source first
+    std::istringstream iss("baz");
+    copy.load(iss);
+    ASSERT_EQ(copy.lineNum(), 3);
+    EXPECT_EQ(copy.getLine(1), "foo");
+    EXPECT_EQ(copy.getLine(3), "baz");
+}
+
+TEST(SourceBufferTest, FromFifo) {
+    // Files that can't be mapped are read, skipping the BOM as well
+    char dir[] = "/tmp/sparkXXXXXX";
+    ASSERT_NE(mkdtemp(dir), nullptr);
+    const std::string path = std::string(dir) + "/fifo";
+    ASSERT_EQ(mkfifo(path.c_str(), 0600), 0);
+    std::thread writer([&] { std::ofstream(path, std::ios::binary) << "\xEF\xBB\xBF" "foo\r\nbar"; });
+    SourceBuffer srcbuf = SourceBuffer::fromFile(path);
+    writer.join();
+    std::remove(path.c_str());
+    rmdir(dir);
+
+    EXPECT_EQ(srcbuf.text(), "foo\r\nbar");
+    ASSERT_EQ(srcbuf.lineNum(), 2);
+    EXPECT_EQ(srcbuf.getLine(1), "foo");
+    EXPECT_EQ(srcbuf.getLine(2), "bar");
+}
+
+TEST(SourceBufferTest, FromFileSentinels) {
+    // The mapped source is followed by 2 zero bytes whatever its size
+    const auto pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    for (size_t size : { size_t{0}, size_t{1}, pageSize - 2, pageSize - 1, pageSize, 2 * pageSize + 1 }) {
+        TempFile file(std::string(size, 'a'));
+        SourceBuffer srcbuf = SourceBuffer::fromFile(file.path());
+        std::string_view text = srcbuf.text();
+        ASSERT_EQ(text.size(), size);
+        EXPECT_EQ(text.data()[size], '\0') << size;
+        EXPECT_EQ(text.data()[size + 1], '\0') << size;
+    }
+
+    EXPECT_THROW(SourceBuffer::fromFile("/nonexistent/file.spark"), std::system_error);
+}
@@ -0,0 +1,100 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+
+#include "runtime/spark.hpp"
+#include "test_utils.hpp"
+
+using Spark::Type;
+using Spark::Runtime::DRCHeader;
+using Spark::Tests::countDestruct;
+using Spark::Tests::DefaultThread;
+using Spark::Tests::destructed;
+
+namespace {
+    /**
+     * Hands the candidate roots over at safe points until the collector is done, then frees what it found.
+     */
+    bool waitForCollector(DefaultThread* th) {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (!DefaultThread::drcSafePoint(th, std::chrono::nanoseconds(0))) {
+            if (std::chrono::steady_clock::now() > deadline) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Makes a garbage cycle of two objects that's a candidate root (it was referenced by @p root).
+     */
+    void makeGarbageCycle(DefaultThread* th, DRCHeader* root, const Type* type) {
+        DRCHeader* a = DefaultThread::newDRCObject(th, type);
+        DRCHeader* b = DefaultThread::newDRCObject(th, type);
+        DefaultThread::drcRetainDRC(th, a, b);
+        DefaultThread::drcRetainDRC(th, b, a);
+        DefaultThread::drcRetainDRC(th, root, a);
+        DefaultThread::drcReleaseDRC(th, root, a);
+    }
+}
+
+TEST(CycleCollectorTest, CollectsCycles) {
+    Type type(sizeof(DRCHeader), countDestruct);
+    Spark::Runtime::Spark<> spark({}, true);
+    DefaultThread* th = spark.newThread();
+    DefaultThread::drcSetCandidateThreshold(th, 8);
+
+    DRCHeader* root = DefaultThread::newDRCObject(th, &type);
+    root->rcHeader.refCount = 1;
+
+    destructed = 0;
+    for (size_t i = 0; i < 100; ++i) {
+        makeGarbageCycle(th, root, &type);
+    }
+    ASSERT_TRUE(waitForCollector(th));
+    EXPECT_EQ(destructed, 200);
+}
+
+TEST(CycleCollectorTest, KeepsLiveObjects) {
+    Type type(sizeof(DRCHeader), countDestruct);
+    Spark::Runtime::Spark<> spark({}, true);
+    DefaultThread* th = spark.newThread();
+    DefaultThread::drcSetCandidateThreshold(th, 0);
+
+    DRCHeader* root = DefaultThread::newDRCObject(th, &type);
+    root->rcHeader.refCount = 1;
+
+    // Live ring that keeps becoming a candidate root while the collector runs
+    DRCHeader* a = DefaultThread::newDRCObject(th, &type);
+    DRCHeader* b = DefaultThread::newDRCObject(th, &type);
+    DefaultThread::drcRetainDRC(th, a, b);
+    DefaultThread::drcRetainDRC(th, b, a);
+    DefaultThread::drcRetainDRC(th, root, a);
+
+    destructed = 0;
+    for (size_t i = 0; i < 2000; ++i) {
+        DefaultThread::drcRetainDRC(th, root, a);
+        DefaultThread::drcReleaseDRC(th, root, a);
+        makeGarbageCycle(th, root, &type);
+    }
+    ASSERT_TRUE(waitForCollector(th));
+    EXPECT_EQ(destructed, 4000);
+
+    // The ring is still alive
+    DefaultThread::drcReleaseDRC(th, root, a);
+    ASSERT_TRUE(waitForCollector(th));
+    EXPECT_EQ(destructed, 4002);
+}
+
+TEST(CycleCollectorTest, StopsWithPendingWork) {
+    Type type(sizeof(DRCHeader));
+    Spark::Runtime::Spark<> spark({}, true);
+    DefaultThread* th = spark.newThread();
+    DefaultThread::drcSetCandidateThreshold(th, 1);
+
+    DRCHeader* root = DefaultThread::newDRCObject(th, &type);
+    root->rcHeader.refCount = 1;
+    for (size_t i = 0; i < 1000; ++i) {
+        makeGarbageCycle(th, root, &type);
+    }
+}
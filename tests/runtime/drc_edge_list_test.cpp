@@ -0,0 +1,93 @@
+#include <map>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "runtime/drc.hpp"
+
+using Spark::Runtime::DRCEdgeList;
+using Spark::Runtime::DRCNode;
+using Spark::Runtime::RCInt;
+
+static std::map<DRCNode*, RCInt> countEdges(const DRCEdgeList& edges) {
+    std::map<DRCNode*, RCInt> counts;
+    edges.forEach([&](DRCNode* node, RCInt count) {
+        counts[node] += count;
+    });
+    return counts;
+}
+
+TEST(DRCEdgeListTest, Inline) {
+    DRCNode nodes[3];
+    DRCEdgeList edges;
+    EXPECT_TRUE(edges.empty());
+
+    edges.add(&nodes[0]);
+    edges.add(&nodes[1]);
+    edges.add(&nodes[1]);
+    EXPECT_FALSE(edges.spilled());
+    EXPECT_EQ(countEdges(edges), (std::map<DRCNode*, RCInt>{ { &nodes[0], 1 }, { &nodes[1], 2 } }));
+
+    EXPECT_FALSE(edges.remove(&nodes[2]));
+    EXPECT_TRUE(edges.remove(&nodes[1]));
+    EXPECT_EQ(countEdges(edges), (std::map<DRCNode*, RCInt>{ { &nodes[0], 1 }, { &nodes[1], 1 } }));
+    EXPECT_TRUE(edges.remove(&nodes[0]));
+    EXPECT_TRUE(edges.remove(&nodes[1]));
+    EXPECT_TRUE(edges.empty());
+}
+
+TEST(DRCEdgeListTest, Spill) {
+    DRCNode nodes[DRCEdgeList::InlineCapacity + 1];
+    DRCEdgeList edges;
+    for (DRCNode& node : nodes) {
+        edges.add(&node);
+    }
+    edges.add(&nodes[0]);
+    EXPECT_TRUE(edges.spilled());
+
+    std::map<DRCNode*, RCInt> counts = countEdges(edges);
+    EXPECT_EQ(counts.size(), std::size(nodes));
+    EXPECT_EQ(counts[&nodes[0]], 2);
+
+    // Moving keeps the edges
+    DRCEdgeList moved(std::move(edges));
+    EXPECT_TRUE(edges.empty());
+    EXPECT_EQ(countEdges(moved), counts);
+
+    moved.clear();
+    EXPECT_TRUE(moved.empty());
+    EXPECT_FALSE(moved.spilled());
+}
+
+TEST(DRCEdgeListTest, RandomAgainstReference) {
+    // Random retains and releases over a wide fan-out agree with a reference multiset
+    std::vector<DRCNode> nodes(200);
+    DRCEdgeList edges;
+    std::map<DRCNode*, RCInt> expected;
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<size_t> pick(0, nodes.size() - 1);
+    for (size_t i = 0; i < 20000; ++i) {
+        DRCNode* node = &nodes[pick(rng)];
+        if (rng() % 3 != 0) {
+            edges.add(node);
+            ++expected[node];
+        } else {
+            bool exists = expected.count(node) > 0;
+            EXPECT_EQ(edges.remove(node), exists);
+            if (exists && --expected[node] == 0) {
+                expected.erase(node);
+            }
+        }
+    }
+    EXPECT_EQ(countEdges(edges), expected);
+
+    // Drain everything
+    for (auto& [node, count] : expected) {
+        for (RCInt i = 0; i < count; ++i) {
+            EXPECT_TRUE(edges.remove(node));
+        }
+        EXPECT_FALSE(edges.remove(node));
+    }
+    EXPECT_TRUE(edges.empty());
+}
@@ -1,6 +1,8 @@
-#include <gmock/gmock.h>
+﻿#include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <random>
+
 #include "runtime/drc.hpp"
 
 using ::testing::UnorderedElementsAreArray;
@@ -8,9 +10,10 @@ using ::testing::UnorderedElementsAreArray;
 using Spark::Runtime::DRC;
 using Spark::Runtime::DRCNode;
 using Spark::Runtime::DRCHeader;
+using Spark::Runtime::DRCWeakRef;
 using Spark::Runtime::RCInt;
 
-DRCHeader newObj(RCInt externalRefCount) {
+DRCHeader newObj(uint32_t externalRefCount) {
     return DRCHeader { .node = nullptr, .rcHeader = { .refCount = externalRefCount, .type = nullptr } };
 }
 
@@ -28,6 +31,36 @@ TEST(DRCTest, Add) {
     EXPECT_EQ(b->obj, &objB);
 }
 
+TEST(DRCTest, WeakRefs) {
+    // a <-> b where b -> a is weak, so dropping a collects both without a cycle
+    DRC drc;
+    DRCHeader objA = newObj(0); DRCNode* a = objA.node = drc.add(&objA);
+    DRCHeader objB = newObj(0); DRCNode* b = objB.node = drc.add(&objB);
+    drc.retain(a, b);
+    DRCWeakRef* ref = drc.weakRetain(a);
+    EXPECT_EQ(drc.weakRetain(a), ref);
+    EXPECT_EQ(ref->obj, &objA);
+    EXPECT_EQ(a->internalRefCount, 0);
+
+    std::vector<DRCNode*> expected = { a, b };
+    EXPECT_THAT(drc.tryCleanup(a), UnorderedElementsAreArray(expected));
+    drc.remove(a);
+    drc.remove(b);
+    EXPECT_EQ(ref->obj, nullptr);
+
+    // The entry outlives its object until its last weak reference is released
+    drc.weakRelease(ref);
+    EXPECT_EQ(drc.weakRefCount(), 1);
+    drc.weakRelease(ref);
+    EXPECT_EQ(drc.weakRefCount(), 0);
+
+    // Releasing every weak reference to a live object detaches the entry
+    DRCHeader objC = newObj(1); DRCNode* c = objC.node = drc.add(&objC);
+    drc.weakRelease(drc.weakRetain(c));
+    EXPECT_EQ(c->weak, nullptr);
+    EXPECT_EQ(drc.weakRefCount(), 0);
+}
+
 TEST(DRCTest, RetainSingleExternallyReferencedNode) {
     // One node gets collected if it's not externally referenced
     DRC drc;
@@ -201,3 +234,600 @@ TEST(DRCTest, ExampleCase6) {
 
     EXPECT_TRUE(drc.tryCleanup(a).empty());
 }
+
+TEST(DRCTest, RemoveRecyclesNode) {
+    DRC drc;
+    DRCHeader objA = newObj(0); DRCNode* a = drc.add(&objA);
+    DRCHeader objB = newObj(0); DRCNode* b = drc.add(&objB);
+    drc.retain(a, b);
+    EXPECT_EQ(drc.tryCleanup(a).size(), 2);
+
+    drc.remove(a);
+    drc.remove(b);
+    EXPECT_EQ(drc.nodeCount(), 0);
+
+    // Removed storage is reused with a clean state
+    DRCHeader objC = newObj(0); DRCNode* c = drc.add(&objC);
+    EXPECT_EQ(drc.nodeCount(), 1);
+    EXPECT_TRUE(c == a || c == b);
+    EXPECT_EQ(c->obj, &objC);
+    EXPECT_EQ(c->internalRefCount, 0);
+    EXPECT_TRUE(c->referencees->empty());
+}
+
+TEST(DRCTest, StableAddresses) {
+    // Node addresses survive growing the pool
+    DRC drc;
+    std::vector<DRCHeader> objs(10000, newObj(0));
+    std::vector<DRCNode*> nodes;
+    for (DRCHeader& obj : objs) {
+        nodes.push_back(drc.add(&obj));
+    }
+    EXPECT_EQ(drc.nodeCount(), objs.size());
+    for (size_t i = 0; i < objs.size(); ++i) {
+        EXPECT_EQ(nodes[i]->obj, &objs[i]);
+    }
+}
+
+TEST(DRCTest, BufferedReleaseDefersCycle) {
+    // h -> a <-> b, then h releases a: the cycle is only collected from the candidate buffer
+    DRC drc;
+    drc.setCandidateThreshold(16);
+    DRCHeader objH = newObj(1); DRCNode* h = drc.add(&objH);
+    DRCHeader objA = newObj(0); DRCNode* a = drc.add(&objA);
+    DRCHeader objB = newObj(0); DRCNode* b = drc.add(&objB);
+    drc.retain(h, a);
+    drc.retain(a, b);
+    drc.retain(b, a);
+
+    EXPECT_TRUE(drc.release(h, a).empty());
+    EXPECT_EQ(drc.candidateCount(), 1);
+
+    std::vector<DRCNode*> expected = { a, b };
+    EXPECT_THAT(drc.collectCandidates(), UnorderedElementsAreArray(expected));
+    EXPECT_EQ(drc.candidateCount(), 0);
+}
+
+TEST(DRCTest, BufferedReleaseImmediateWhenUnreachable) {
+    // h -> a -> b: releasing a leaves it with no reference at all, so it's collected right away
+    DRC drc;
+    drc.setCandidateThreshold(16);
+    DRCHeader objH = newObj(1); DRCNode* h = drc.add(&objH);
+    DRCHeader objA = newObj(0); DRCNode* a = drc.add(&objA);
+    DRCHeader objB = newObj(0); DRCNode* b = drc.add(&objB);
+    drc.retain(h, a);
+    drc.retain(a, b);
+
+    std::vector<DRCNode*> expected = { a, b };
+    EXPECT_THAT(drc.release(h, a), UnorderedElementsAreArray(expected));
+    EXPECT_EQ(drc.candidateCount(), 0);
+}
+
+TEST(DRCTest, BufferedCandidateReReferenced) {
+    // A candidate that gets referenced again is dropped from the buffer
+    DRC drc;
+    drc.setCandidateThreshold(16);
+    DRCHeader objH = newObj(1); DRCNode* h = drc.add(&objH);
+    DRCHeader objA = newObj(0); DRCNode* a = drc.add(&objA);
+    DRCHeader objB = newObj(0); DRCNode* b = drc.add(&objB);
+    drc.retain(h, a);
+    drc.retain(a, b);
+    drc.retain(b, a);
+
+    EXPECT_TRUE(drc.release(h, a).empty());
+    drc.retain(h, a);
+    EXPECT_EQ(drc.candidateCount(), 0);
+    EXPECT_TRUE(drc.collectCandidates().empty());
+
+    // Externally referenced candidates are skipped
+    EXPECT_TRUE(drc.release(h, a).empty());
+    objA.rcHeader.refCount = 1;
+    EXPECT_TRUE(drc.collectCandidates().empty());
+    EXPECT_EQ(drc.candidateCount(), 0);
+}
+
+TEST(DRCTest, BufferedThreshold) {
+    // Three separate cycles hanging off h, the third release reaches the threshold and collects all of them
+    DRC drc;
+    drc.setCandidateThreshold(3);
+    DRCHeader objH = newObj(1); DRCNode* h = drc.add(&objH);
+    std::vector<DRCHeader> objs(6, newObj(0));
+    std::vector<DRCNode*> nodes;
+    for (DRCHeader& obj : objs) {
+        nodes.push_back(drc.add(&obj));
+    }
+    for (size_t i = 0; i < nodes.size(); i += 2) {
+        drc.retain(h, nodes[i]);
+        drc.retain(nodes[i], nodes[i + 1]);
+        drc.retain(nodes[i + 1], nodes[i]);
+    }
+
+    EXPECT_TRUE(drc.release(h, nodes[0]).empty());
+    EXPECT_TRUE(drc.release(h, nodes[2]).empty());
+    EXPECT_THAT(drc.release(h, nodes[4]), UnorderedElementsAreArray(nodes));
+    EXPECT_EQ(drc.candidateCount(), 0);
+}
+
+TEST(DRCTest, BufferedCandidatesInSameCycle) {
+    // Two candidates in the same garbage cycle are collected once
+    DRC drc;
+    drc.setCandidateThreshold(16);
+    DRCHeader objH = newObj(1); DRCNode* h = drc.add(&objH);
+    DRCHeader objA = newObj(0); DRCNode* a = drc.add(&objA);
+    DRCHeader objB = newObj(0); DRCNode* b = drc.add(&objB);
+    drc.retain(h, a);
+    drc.retain(h, b);
+    drc.retain(a, b);
+    drc.retain(b, a);
+
+    EXPECT_TRUE(drc.release(h, a).empty());
+    EXPECT_TRUE(drc.release(h, b).empty());
+    EXPECT_EQ(drc.candidateCount(), 2);
+
+    std::vector<DRCNode*> expected = { a, b };
+    EXPECT_THAT(drc.collectCandidates(), UnorderedElementsAreArray(expected));
+}
+
+static std::vector<DRCNode*> cleanupIncrementally(DRC& drc, DRCNode* from, size_t budget) {
+    drc.startCleanup(from);
+    DRC::CleanupStatus status;
+    while ((status = drc.stepCleanup(budget)) == DRC::CleanupStatus::Pending) { }
+    if (status == DRC::CleanupStatus::Aborted) {
+        return {};
+    }
+    return { drc.cleanupResult().begin(), drc.cleanupResult().end() };
+}
+
+TEST(DRCTest, IncrementalExampleCases) {
+    // Same results as ExampleCase1, ExampleCase2 and ExampleCase6 with the smallest budget
+    {
+        DRC drc;
+        DRCHeader objA = newObj(0); DRCNode* a = drc.add(&objA);
+        DRCHeader objB = newObj(0); DRCNode* b = drc.add(&objB);
+        DRCHeader objC = newObj(0); DRCNode* c = drc.add(&objC);
+        DRCHeader objD = newObj(0); DRCNode* d = drc.add(&objD);
+        DRCHeader objE = newObj(0); DRCNode* e = drc.add(&objE);
+        DRCHeader objF = newObj(0); DRCNode* f = drc.add(&objF);
+        drc.retain(a, b); drc.retain(a, c); drc.retain(a, e);
+        drc.retain(b, c); drc.retain(b, d);
+        drc.retain(c, b);
+        drc.retain(d, a); drc.retain(d, f);
+        std::vector<DRCNode*> expected = { a, b, c, d, e, f };
+        EXPECT_THAT(cleanupIncrementally(drc, a, 1), UnorderedElementsAreArray(expected));
+        EXPECT_FALSE(drc.cleanupInProgress());
+    }
+    {
+        DRC drc;
+        DRCHeader objA = newObj(0); DRCNode* a = drc.add(&objA);
+        DRCHeader objB = newObj(0); DRCNode* b = drc.add(&objB);
+        DRCHeader objC = newObj(0); DRCNode* c = drc.add(&objC);
+        DRCHeader objD = newObj(0); DRCNode* d = drc.add(&objD);
+        DRCHeader objE = newObj(1); DRCNode* e = drc.add(&objE);
+        drc.retain(a, b);
+        drc.retain(b, c); drc.retain(b, d); drc.retain(b, e);
+        drc.retain(c, a);
+        drc.retain(d, a); drc.retain(d, b);
+        std::vector<DRCNode*> expected = { a, b, c, d };
+        EXPECT_THAT(cleanupIncrementally(drc, a, 1), UnorderedElementsAreArray(expected));
+        EXPECT_EQ(e->internalRefCount, 0);
+    }
+    {
+        DRC drc;
+        DRCHeader objA = newObj(0); DRCNode* a = drc.add(&objA);
+        DRCHeader objB = newObj(0); DRCNode* b = drc.add(&objB);
+        DRCHeader objC = newObj(0); DRCNode* c = drc.add(&objC);
+        DRCHeader objD = newObj(0); DRCNode* d = drc.add(&objD);
+        DRCHeader objE = newObj(1); DRCNode* e = drc.add(&objE);
+        DRCHeader objF = newObj(0); DRCNode* f = drc.add(&objF);
+        drc.retain(a, b); drc.retain(a, c);
+        drc.retain(b, d);
+        drc.retain(c, e);
+        drc.retain(d, a); drc.retain(d, c);
+        drc.retain(e, a); drc.retain(e, f);
+        drc.retain(f, b);
+        EXPECT_TRUE(cleanupIncrementally(drc, a, 1).empty());
+        EXPECT_EQ(a->internalRefCount, 2);
+    }
+}
+
+TEST(DRCTest, IncrementalKeepsSharedSubgraph) {
+    // [a] -> x -> y, l -> x with l externally referenced: only a is garbage
+    DRC drc;
+    DRCHeader objA = newObj(0); DRCNode* a = drc.add(&objA);
+    DRCHeader objX = newObj(0); DRCNode* x = drc.add(&objX);
+    DRCHeader objY = newObj(0); DRCNode* y = drc.add(&objY);
+    DRCHeader objL = newObj(1); DRCNode* l = drc.add(&objL);
+    drc.retain(a, x);
+    drc.retain(x, y);
+    drc.retain(l, x);
+
+    std::vector<DRCNode*> expected = { a };
+    EXPECT_THAT(cleanupIncrementally(drc, a, 2), UnorderedElementsAreArray(expected));
+    EXPECT_EQ(x->internalRefCount, 1);
+    EXPECT_EQ(y->internalRefCount, 1);
+}
+
+TEST(DRCTest, IncrementalRetainDuringMark) {
+    // [a] <-> b, h retains b while a is being marked: nothing is garbage anymore
+    DRC drc;
+    DRCHeader objH = newObj(1); DRCNode* h = drc.add(&objH);
+    DRCHeader objA = newObj(0); DRCNode* a = drc.add(&objA);
+    DRCHeader objB = newObj(0); DRCNode* b = drc.add(&objB);
+    drc.retain(a, b);
+    drc.retain(b, a);
+
+    drc.startCleanup(a);
+    EXPECT_EQ(drc.stepCleanup(1), DRC::CleanupStatus::Pending);
+    drc.retain(h, b);
+    DRC::CleanupStatus status;
+    while ((status = drc.stepCleanup(1)) == DRC::CleanupStatus::Pending) { }
+    EXPECT_EQ(status, DRC::CleanupStatus::Aborted);
+    EXPECT_EQ(a->internalRefCount, 1);
+    EXPECT_EQ(b->internalRefCount, 2);
+}
+
+TEST(DRCTest, IncrementalReleaseDuringMark) {
+    // [a] <-> b, h -> b, h releases b while a is being marked: the cycle becomes garbage
+    DRC drc;
+    drc.setCandidateThreshold(16);
+    DRCHeader objH = newObj(1); DRCNode* h = drc.add(&objH);
+    DRCHeader objA = newObj(0); DRCNode* a = drc.add(&objA);
+    DRCHeader objB = newObj(0); DRCNode* b = drc.add(&objB);
+    drc.retain(a, b);
+    drc.retain(b, a);
+    drc.retain(h, b);
+
+    drc.startCleanup(a);
+    EXPECT_EQ(drc.stepCleanup(1), DRC::CleanupStatus::Pending);
+    EXPECT_TRUE(drc.release(h, b).empty());
+    DRC::CleanupStatus status;
+    while ((status = drc.stepCleanup(1)) == DRC::CleanupStatus::Pending) { }
+    EXPECT_EQ(status, DRC::CleanupStatus::Collected);
+    std::vector<DRCNode*> expected = { a, b };
+    EXPECT_THAT(drc.cleanupResult(), UnorderedElementsAreArray(expected));
+}
+
+TEST(DRCTest, IncrementalMutationAfterMarkCancels) {
+    // A retain on a traversed node after marking cancels the cleanup and buffers its starting node again
+    DRC drc;
+    DRCHeader objH = newObj(1); DRCNode* h = drc.add(&objH);
+    DRCHeader objA = newObj(0); DRCNode* a = drc.add(&objA);
+    DRCHeader objB = newObj(0); DRCNode* b = drc.add(&objB);
+    drc.retain(a, b);
+    drc.retain(b, a);
+
+    drc.startCleanup(a);
+    EXPECT_EQ(drc.stepCleanup(2), DRC::CleanupStatus::Pending); // Marked both nodes
+    drc.retain(h, b);
+    EXPECT_FALSE(drc.cleanupInProgress());
+    EXPECT_EQ(drc.stepCleanup(1), DRC::CleanupStatus::Aborted);
+    EXPECT_EQ(drc.candidateCount(), 1);
+    EXPECT_EQ(drc.takeCandidate(), a);
+}
+
+TEST(DRCTest, IncrementalWeakUpgrade) {
+    // [a] <-> b with a weakly referenced: upgrading a at any step of the cleanup keeps the cycle alive
+    for (size_t steps = 0; steps < 6; ++steps) {
+        DRC drc;
+        DRCHeader objA = newObj(0); DRCNode* a = objA.node = drc.add(&objA);
+        DRCHeader objB = newObj(0); DRCNode* b = objB.node = drc.add(&objB);
+        drc.retain(a, b);
+        drc.retain(b, a);
+        DRCWeakRef* ref = drc.weakRetain(a);
+
+        drc.startCleanup(a);
+        for (size_t i = 0; i < steps; ++i) {
+            EXPECT_EQ(drc.stepCleanup(1), DRC::CleanupStatus::Pending) << steps;
+        }
+        ASSERT_EQ(drc.weakUpgrade(ref), &objA) << steps;
+        objA.rcHeader.refCount++;
+        DRC::CleanupStatus status;
+        while ((status = drc.stepCleanup(1)) == DRC::CleanupStatus::Pending) { }
+        EXPECT_NE(status, DRC::CleanupStatus::Collected) << steps;
+        EXPECT_EQ(ref->obj, &objA) << steps;
+        EXPECT_EQ(a->internalRefCount, 1) << steps;
+        EXPECT_EQ(b->internalRefCount, 1) << steps;
+        drc.weakRelease(ref);
+    }
+
+    // Once the cycle is being dropped it's garbage, so its weak references can't be upgraded anymore
+    DRC drc;
+    DRCHeader objA = newObj(0); DRCNode* a = objA.node = drc.add(&objA);
+    DRCHeader objB = newObj(0); DRCNode* b = objB.node = drc.add(&objB);
+    drc.retain(a, b);
+    drc.retain(b, a);
+    DRCWeakRef* ref = drc.weakRetain(a);
+    drc.startCleanup(a);
+    EXPECT_EQ(drc.stepCleanup(6), DRC::CleanupStatus::Pending); // Marked, scanned and collected both nodes
+    EXPECT_EQ(drc.weakUpgrade(ref), nullptr);
+    EXPECT_EQ(drc.stepCleanup(2), DRC::CleanupStatus::Collected);
+    std::vector<DRCNode*> expected = { a, b };
+    EXPECT_THAT(drc.cleanupResult(), UnorderedElementsAreArray(expected));
+    EXPECT_EQ(ref->obj, nullptr);
+}
+
+TEST(DRCTest, IncrementalStepsAreBounded) {
+    // A ring of n garbage nodes, each referencing l (externally referenced): no step does more than its budget, including
+    // dropping the edges of the garbage to l
+    constexpr size_t n = 1000;
+    DRC drc;
+    DRCHeader objL = newObj(1); DRCNode* l = drc.add(&objL);
+    std::vector<DRCHeader> objs(n, newObj(0));
+    std::vector<DRCNode*> ring;
+    for (DRCHeader& obj : objs) {
+        ring.push_back(drc.add(&obj));
+    }
+    for (size_t i = 0; i < n; ++i) {
+        drc.retain(ring[i], ring[(i + 1) % n]);
+        drc.retain(ring[i], l);
+    }
+
+    constexpr size_t budget = 8;
+    drc.startCleanup(ring[0]);
+    size_t steps = 1;
+    RCInt previous = l->internalRefCount;
+    DRC::CleanupStatus status;
+    while ((status = drc.stepCleanup(budget)) == DRC::CleanupStatus::Pending) {
+        EXPECT_LE(previous - l->internalRefCount, budget);
+        previous = l->internalRefCount;
+        ++steps;
+    }
+    ASSERT_EQ(status, DRC::CleanupStatus::Collected);
+    EXPECT_LE(previous - l->internalRefCount, budget);
+    EXPECT_EQ(l->internalRefCount, 0);
+    EXPECT_EQ(drc.cleanupResult().size(), n);
+    // Marking, scanning, collecting and dropping each visit every node of the ring
+    EXPECT_GE(steps, 4 * n / budget);
+}
+
+TEST(DRCTest, KeepsSharedSubgraph) {
+    // [a] -> x -> y, l -> x with l externally referenced: only a is garbage, x and y survive through l
+    DRC drc;
+    DRCHeader objA = newObj(0); DRCNode* a = drc.add(&objA);
+    DRCHeader objX = newObj(0); DRCNode* x = drc.add(&objX);
+    DRCHeader objY = newObj(0); DRCNode* y = drc.add(&objY);
+    DRCHeader objL = newObj(1); DRCNode* l = drc.add(&objL);
+    drc.retain(a, x);
+    drc.retain(x, y);
+    drc.retain(l, x);
+
+    std::vector<DRCNode*> expected = { a };
+    EXPECT_THAT(drc.tryCleanup(a), UnorderedElementsAreArray(expected));
+    EXPECT_EQ(x->internalRefCount, 1);
+    EXPECT_EQ(y->internalRefCount, 1);
+}
+
+TEST(DRCTest, AbortKeepsCounts) {
+    // Same graph as ExampleCase6, internal counts are untouched when nothing is collected
+    DRC drc;
+    DRCHeader objA = newObj(0); DRCNode* a = drc.add(&objA);
+    DRCHeader objB = newObj(0); DRCNode* b = drc.add(&objB);
+    DRCHeader objC = newObj(0); DRCNode* c = drc.add(&objC);
+    DRCHeader objD = newObj(0); DRCNode* d = drc.add(&objD);
+    DRCHeader objE = newObj(1); DRCNode* e = drc.add(&objE);
+    DRCHeader objF = newObj(0); DRCNode* f = drc.add(&objF);
+    drc.retain(a, b); drc.retain(a, c);
+    drc.retain(b, d);
+    drc.retain(c, e);
+    drc.retain(d, a); drc.retain(d, c);
+    drc.retain(e, a); drc.retain(e, f);
+    drc.retain(f, b);
+
+    EXPECT_TRUE(drc.tryCleanup(a).empty());
+    std::vector<RCInt> counts = { a->internalRefCount, b->internalRefCount, c->internalRefCount,
+                                  d->internalRefCount, e->internalRefCount, f->internalRefCount };
+    EXPECT_EQ(counts, (std::vector<RCInt>{ 2, 2, 2, 1, 1, 1 }));
+}
+
+TEST(DRCTest, RandomGraphsAgreeWithIncremental) {
+    // Synchronous and incremental cleanups find the same garbage on random graphs
+    std::mt19937 rng(7);
+    for (size_t round = 0; round < 200; ++round) {
+        const size_t n = 2 + rng() % 30;
+        std::vector<DRCHeader> objs(n, newObj(0));
+        for (DRCHeader& obj : objs) {
+            obj.rcHeader.refCount = rng() % 8 == 0 ? 1 : 0;
+        }
+        objs[0].rcHeader.refCount = 0;
+
+        auto build = [&](DRC& drc) {
+            std::mt19937 edgeRng(static_cast<uint32_t>(round));
+            std::vector<DRCNode*> nodes;
+            for (DRCHeader& obj : objs) {
+                nodes.push_back(drc.add(&obj));
+            }
+            const size_t edges = edgeRng() % (3 * n);
+            for (size_t i = 0; i < edges; ++i) {
+                drc.retain(nodes[edgeRng() % n], nodes[edgeRng() % n]);
+            }
+            return nodes;
+        };
+
+        DRC syncDRC;
+        std::vector<DRCNode*> syncNodes = build(syncDRC);
+        std::vector<size_t> syncResult;
+        for (DRCNode* node : syncDRC.tryCleanup(syncNodes[0])) {
+            syncResult.push_back(static_cast<size_t>(node->obj - objs.data()));
+        }
+
+        DRC incDRC;
+        std::vector<DRCNode*> incNodes = build(incDRC);
+        std::vector<size_t> incResult;
+        for (DRCNode* node : cleanupIncrementally(incDRC, incNodes[0], 3)) {
+            incResult.push_back(static_cast<size_t>(node->obj - objs.data()));
+        }
+
+        EXPECT_THAT(syncResult, UnorderedElementsAreArray(incResult)) << "round " << round;
+        for (size_t i = 0; i < n; ++i) {
+            EXPECT_EQ(syncNodes[i]->internalRefCount, incNodes[i]->internalRefCount) << "round " << round;
+        }
+    }
+}
+
+namespace {
+    /**
+     * DRC object of a traced type with up to 4 DRC references.
+     */
+    struct TracedObj {
+        DRCHeader header;
+        DRCHeader* fields[4];
+    };
+
+    Spark::Type tracedType(sizeof(TracedObj), {
+        offsetof(TracedObj, fields) + 0 * sizeof(DRCHeader*),
+        offsetof(TracedObj, fields) + 1 * sizeof(DRCHeader*),
+        offsetof(TracedObj, fields) + 2 * sizeof(DRCHeader*),
+        offsetof(TracedObj, fields) + 3 * sizeof(DRCHeader*),
+    });
+
+    TracedObj newTracedObj(uint32_t externalRefCount) {
+        TracedObj obj { newObj(externalRefCount), { nullptr, nullptr, nullptr, nullptr } };
+        obj.header.rcHeader.type = &tracedType;
+        return obj;
+    }
+}
+
+TEST(DRCTest, TracedEdges) {
+    // root -> a <-> b, edges are only in the fields
+    DRC drc;
+    TracedObj objRoot = newTracedObj(1); DRCNode* root = objRoot.header.node = drc.add(&objRoot.header);
+    TracedObj objA = newTracedObj(0); DRCNode* a = objA.header.node = drc.add(&objA.header);
+    TracedObj objB = newTracedObj(0); DRCNode* b = objB.header.node = drc.add(&objB.header);
+    EXPECT_TRUE(a->traced);
+
+    objRoot.fields[0] = &objA.header; drc.retain(root, a);
+    objA.fields[2] = &objB.header; drc.retain(a, b);
+    objB.fields[1] = &objA.header; drc.retain(b, a);
+    // Traced nodes carry no edge list
+    EXPECT_EQ(a->referencees, nullptr);
+
+    // Still referenced by b
+    objB.fields[1] = nullptr;
+    EXPECT_TRUE(drc.release(b, a).empty());
+    objB.fields[1] = &objA.header; drc.retain(b, a);
+
+    objRoot.fields[0] = nullptr;
+    std::vector<DRCNode*> expected = { a, b };
+    EXPECT_THAT(drc.release(root, a), UnorderedElementsAreArray(expected));
+}
+
+TEST(DRCTest, RandomGraphsTracedAgreeWithStored) {
+    // Traced and stored edges find the same garbage on random graphs, synchronously and incrementally
+    std::mt19937 rng(11);
+    for (size_t round = 0; round < 200; ++round) {
+        const size_t n = 2 + rng() % 30;
+        std::vector<TracedObj> objs(n, newTracedObj(0));
+        for (TracedObj& obj : objs) {
+            obj.header.rcHeader.refCount = rng() % 8 == 0 ? 1 : 0;
+        }
+        objs[0].header.rcHeader.refCount = 0;
+        std::vector<DRCHeader> storedObjs;
+        for (const TracedObj& obj : objs) {
+            storedObjs.push_back(newObj(obj.header.rcHeader.refCount));
+        }
+
+        DRC stored;
+        DRC traced;
+        std::vector<DRCNode*> storedNodes;
+        std::vector<DRCNode*> tracedNodes;
+        for (size_t i = 0; i < n; ++i) {
+            storedNodes.push_back(stored.add(&storedObjs[i]));
+            tracedNodes.push_back(objs[i].header.node = traced.add(&objs[i].header));
+        }
+        for (size_t i = 0; i < n; ++i) {
+            for (DRCHeader*& field : objs[i].fields) {
+                if (rng() % 2 == 0) {
+                    continue;
+                }
+                const size_t j = rng() % n;
+                field = &objs[j].header;
+                traced.retain(tracedNodes[i], tracedNodes[j]);
+                stored.retain(storedNodes[i], storedNodes[j]);
+            }
+        }
+
+        std::vector<size_t> storedResult;
+        for (DRCNode* node : stored.tryCleanup(storedNodes[0])) {
+            storedResult.push_back(static_cast<size_t>(node->obj - storedObjs.data()));
+        }
+        std::vector<size_t> tracedResult;
+        const bool incremental = round % 2 == 1;
+        for (DRCNode* node : incremental ? cleanupIncrementally(traced, tracedNodes[0], 3)
+                                         : traced.tryCleanup(tracedNodes[0])) {
+            tracedResult.push_back(static_cast<size_t>(reinterpret_cast<TracedObj*>(node->obj) - objs.data()));
+        }
+
+        EXPECT_THAT(tracedResult, UnorderedElementsAreArray(storedResult)) << "round " << round;
+        for (size_t i = 0; i < n; ++i) {
+            EXPECT_EQ(tracedNodes[i]->internalRefCount, storedNodes[i]->internalRefCount) << "round " << round;
+        }
+    }
+}
+
+TEST(DRCTest, ParallelCleanup) {
+    // root -> a -> b -> c -> a, c -> d, with d externally referenced
+    DRC drc;
+    drc.setParallelCleanup(1, 4);
+    DRCHeader objRoot = newObj(1); DRCNode* root = drc.add(&objRoot);
+    DRCHeader objA = newObj(0); DRCNode* a = drc.add(&objA);
+    DRCHeader objB = newObj(0); DRCNode* b = drc.add(&objB);
+    DRCHeader objC = newObj(0); DRCNode* c = drc.add(&objC);
+    DRCHeader objD = newObj(1); DRCNode* d = drc.add(&objD);
+    drc.retain(root, a);
+    drc.retain(a, b); drc.retain(b, c); drc.retain(c, a);
+    drc.retain(c, d);
+
+    // b is still reachable from root
+    EXPECT_TRUE(drc.tryCleanup(b).empty());
+    EXPECT_EQ(b->internalRefCount, 1);
+
+    std::vector<DRCNode*> expected = { a, b, c };
+    EXPECT_THAT(drc.release(root, a), UnorderedElementsAreArray(expected));
+    EXPECT_EQ(d->internalRefCount, 0);
+}
+
+TEST(DRCTest, RandomGraphsAgreeWithParallel) {
+    // Sequential and parallel cleanups find the same garbage on random graphs, whatever the threshold
+    std::mt19937 rng(13);
+    for (size_t round = 0; round < 100; ++round) {
+        const size_t n = 2 + rng() % 200;
+        std::vector<DRCHeader> objs(n, newObj(0));
+        for (DRCHeader& obj : objs) {
+            obj.rcHeader.refCount = rng() % 16 == 0 ? 1 : 0;
+        }
+        objs[0].rcHeader.refCount = 0;
+
+        auto build = [&](DRC& drc) {
+            std::mt19937 edgeRng(static_cast<uint32_t>(round));
+            std::vector<DRCNode*> nodes;
+            for (DRCHeader& obj : objs) {
+                nodes.push_back(drc.add(&obj));
+            }
+            const size_t edges = edgeRng() % (3 * n);
+            for (size_t i = 0; i < edges; ++i) {
+                drc.retain(nodes[edgeRng() % n], nodes[edgeRng() % n]);
+            }
+            return nodes;
+        };
+
+        DRC seqDRC;
+        std::vector<DRCNode*> seqNodes = build(seqDRC);
+        std::vector<size_t> seqResult;
+        for (DRCNode* node : seqDRC.tryCleanup(seqNodes[0])) {
+            seqResult.push_back(static_cast<size_t>(node->obj - objs.data()));
+        }
+
+        DRC parDRC;
+        parDRC.setParallelCleanup(1 + round % 8, 1 + round % 4);
+        std::vector<DRCNode*> parNodes = build(parDRC);
+        std::vector<size_t> parResult;
+        for (DRCNode* node : parDRC.tryCleanup(parNodes[0])) {
+            parResult.push_back(static_cast<size_t>(node->obj - objs.data()));
+        }
+
+        EXPECT_THAT(parResult, UnorderedElementsAreArray(seqResult)) << "round " << round;
+        for (size_t i = 0; i < n; ++i) {
+            EXPECT_EQ(parNodes[i]->internalRefCount, seqNodes[i]->internalRefCount) << "round " << round;
+        }
+    }
+}
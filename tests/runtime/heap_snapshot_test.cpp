@@ -0,0 +1,104 @@
+#include <gtest/gtest.h>
+
+#include <sstream>
+
+#include "runtime/spark.hpp"
+
+using Spark::Type;
+using Spark::Runtime::DefaultAllocator;
+using Spark::Runtime::DRCHeader;
+using Spark::Runtime::HeapAnalysis;
+using Spark::Runtime::HeapSnapshot;
+using Spark::Runtime::RCHeader;
+using Spark::Runtime::Thread;
+
+namespace {
+    HeapSnapshot::Object newObject(uint32_t size, uint64_t refCount) {
+        return HeapSnapshot::Object{ 0x1000, 1, size, HeapSnapshot::DRCObject, refCount, 0 };
+    }
+}
+
+TEST(HeapSnapshotTest, RoundTrip) {
+    HeapSnapshot snapshot;
+    snapshot.objects.push_back(HeapSnapshot::Object{ 0xdeadbeef0, 7, 48, HeapSnapshot::DRCObject, 1, 2 });
+    snapshot.objects.push_back(HeapSnapshot::Object{ 0x1234, 3, 16, HeapSnapshot::Young, 5, 0 });
+    snapshot.edges.push_back(HeapSnapshot::Edge{ 0, 1, 2 });
+
+    std::stringstream stream;
+    Spark::Runtime::writeHeapSnapshot(stream, snapshot);
+    HeapSnapshot read;
+    ASSERT_TRUE(Spark::Runtime::readHeapSnapshot(stream, read));
+    ASSERT_EQ(read.objects.size(), 2);
+    EXPECT_EQ(read.objects[0].address, 0xdeadbeef0);
+    EXPECT_EQ(read.objects[0].type, 7);
+    EXPECT_EQ(read.objects[0].size, 48);
+    EXPECT_EQ(read.objects[0].internalRefCount, 2);
+    EXPECT_EQ(read.objects[1].flags, HeapSnapshot::Young);
+    EXPECT_EQ(read.objects[1].refCount, 5);
+    ASSERT_EQ(read.edges.size(), 1);
+    EXPECT_EQ(read.edges[0].to, 1);
+    EXPECT_EQ(read.edges[0].count, 2);
+
+    // Truncated or foreign data is rejected
+    std::string data = stream.str();
+    std::stringstream truncated(data.substr(0, data.size() - 1));
+    EXPECT_FALSE(Spark::Runtime::readHeapSnapshot(truncated, read));
+    std::stringstream foreign("not a snapshot");
+    EXPECT_FALSE(Spark::Runtime::readHeapSnapshot(foreign, read));
+}
+
+TEST(HeapSnapshotTest, Analysis) {
+    // root -> a -> b -> c, a -> c, root -> d <-> e, f -> f (unreachable)
+    HeapSnapshot snapshot;
+    snapshot.objects = { newObject(10, 1), newObject(20, 0), newObject(30, 0), newObject(40, 0),
+                         newObject(50, 0), newObject(60, 0), newObject(70, 0) };
+    snapshot.edges = { { 0, 1, 1 }, { 1, 2, 1 }, { 2, 3, 1 }, { 1, 3, 1 },
+                       { 0, 4, 1 }, { 4, 5, 1 }, { 5, 4, 1 }, { 6, 6, 1 } };
+
+    HeapAnalysis analysis = Spark::Runtime::analyzeHeapSnapshot(snapshot);
+    EXPECT_EQ(analysis.dominators, (std::vector<uint32_t>{ HeapAnalysis::Root, 0, 1, 1, 0, 4,
+                                                            HeapAnalysis::Unreachable }));
+    EXPECT_EQ(analysis.retainedSizes, (std::vector<uint64_t>{ 210, 90, 30, 40, 110, 60, 0 }));
+    EXPECT_EQ(analysis.reachableSize, 210);
+    EXPECT_EQ(analysis.unreachableCount, 1);
+    EXPECT_EQ(analysis.unreachableSize, 70);
+
+    ASSERT_EQ(analysis.cycles.size(), 2);
+    EXPECT_EQ(analysis.cycles[0].size, 110);
+    EXPECT_EQ(analysis.cycles[0].objects.size(), 2);
+    EXPECT_EQ(analysis.cycles[1].size, 70);
+    EXPECT_EQ(analysis.cycles[1].objects, (std::vector<uint32_t>{ 6 }));
+}
+
+TEST(HeapSnapshotTest, ThreadSnapshot) {
+    using DefaultThread = Thread<DefaultAllocator>;
+    Type rcType(sizeof(RCHeader) + 8);
+    Type drcType(sizeof(DRCHeader) + 8);
+    DefaultThread th;
+
+    RCHeader* rc = DefaultThread::newRCObject(&th, &rcType);
+    DefaultThread::rcRetain(&th, rc);
+    DRCHeader* root = DefaultThread::newDRCObject(&th, &drcType);
+    DefaultThread::drcRetain(&th, root);
+    DRCHeader* a = DefaultThread::newDRCObject(&th, &drcType);
+    DRCHeader* b = DefaultThread::newDRCObject(&th, &drcType);
+    DefaultThread::drcRetainDRC(&th, root, a);
+    DefaultThread::drcRetainDRC(&th, a, b);
+    DefaultThread::drcRetainDRC(&th, b, a);
+
+    HeapSnapshot snapshot = DefaultThread::heapSnapshot(&th);
+    ASSERT_EQ(snapshot.objects.size(), 4);
+    EXPECT_EQ(snapshot.edges.size(), 3);
+    EXPECT_EQ(snapshot.objects[0].address, reinterpret_cast<uintptr_t>(rc));
+    EXPECT_EQ(snapshot.objects[0].refCount, 1);
+    EXPECT_EQ(snapshot.objects[0].flags, 0);
+    EXPECT_EQ(snapshot.objects[0].type, rcType.index());
+
+    HeapAnalysis analysis = Spark::Runtime::analyzeHeapSnapshot(snapshot);
+    EXPECT_EQ(analysis.unreachableCount, 0);
+    EXPECT_EQ(analysis.reachableSize, snapshot.objects[0].size + 3 * drcType.size());
+    ASSERT_EQ(analysis.cycles.size(), 1);
+    EXPECT_EQ(analysis.cycles[0].size, 2 * drcType.size());
+
+    DefaultThread::rcRelease(&th, rc);
+}
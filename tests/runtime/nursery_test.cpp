@@ -0,0 +1,167 @@
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+#include "runtime/spark.hpp"
+#include "test_utils.hpp"
+
+using Spark::Type;
+using Spark::Runtime::DRCHeader;
+using Spark::Runtime::Nursery;
+using Spark::Runtime::RCHeader;
+using Spark::Tests::countDestruct;
+using Spark::Tests::DefaultThread;
+using Spark::Tests::destructed;
+
+TEST(NurseryTest, Alloc) {
+    Nursery nursery;
+    EXPECT_EQ(nursery.alloc(16, Nursery::Kind::RC), nullptr);
+    ASSERT_TRUE(nursery.reserve(2 * Nursery::ChunkSize));
+    EXPECT_EQ(nursery.freeChunkCount(), 2);
+
+    char* a = static_cast<char*>(nursery.alloc(16, Nursery::Kind::RC));
+    char* b = static_cast<char*>(nursery.alloc(16, Nursery::Kind::DRC));
+    ASSERT_NE(a, nullptr);
+    EXPECT_TRUE(nursery.contains(a));
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(a) % alignof(std::max_align_t), 0);
+    EXPECT_EQ(b - a, sizeof(Nursery::ObjectHeader) + 16);
+    EXPECT_EQ(Nursery::headerOf(b)->kind, Nursery::Kind::DRC);
+    EXPECT_EQ(nursery.alloc(Nursery::LargeSize, Nursery::Kind::RC), nullptr);
+
+    int local;
+    EXPECT_FALSE(nursery.contains(&local));
+}
+
+TEST(NurseryTest, ReusesDeadChunks) {
+    Nursery nursery;
+    ASSERT_TRUE(nursery.reserve(2 * Nursery::ChunkSize));
+
+    // Fill the first chunk and start the second one
+    std::vector<void*> first;
+    void* p;
+    while ((p = nursery.alloc(1024, Nursery::Kind::RC)) != nullptr && nursery.freeChunkCount() == 1) {
+        first.push_back(p);
+    }
+    ASSERT_NE(p, nullptr);
+    EXPECT_EQ(nursery.freeChunkCount(), 0);
+
+    for (void* obj : first) {
+        nursery.free(obj);
+    }
+    EXPECT_EQ(nursery.freeChunkCount(), 1);
+
+    // Full once both chunks are used again
+    size_t count = 0;
+    while (nursery.alloc(1024, Nursery::Kind::RC) != nullptr) {
+        ++count;
+    }
+    EXPECT_EQ(count, first.size() * 2 - 1);
+}
+
+TEST(NurseryTest, CollectYoung) {
+    Nursery nursery;
+    ASSERT_TRUE(nursery.reserve(Nursery::ChunkSize));
+    void* a = nursery.alloc(16, Nursery::Kind::RC);
+    void* b = nursery.alloc(16, Nursery::Kind::RC);
+    void* c = nursery.alloc(16, Nursery::Kind::RC);
+    nursery.free(b);
+
+    std::vector<void*> young;
+    nursery.collectYoung([&](Nursery::ObjectHeader* header) {
+        young.push_back(header + 1);
+        header->state = Nursery::State::Promoted;
+    });
+    EXPECT_EQ(young, (std::vector<void*>{ a, c }));
+
+    // Only objects allocated since are young
+    void* d = nursery.alloc(16, Nursery::Kind::RC);
+    young.clear();
+    nursery.collectYoung([&](Nursery::ObjectHeader* header) {
+        young.push_back(header + 1);
+        nursery.free(header + 1);
+    });
+    EXPECT_EQ(young, (std::vector<void*>{ d }));
+}
+
+TEST(NurseryTest, YoungRCObjects) {
+    Type type(sizeof(RCHeader) + 8, countDestruct);
+    destructed = 0;
+    {
+        DefaultThread th;
+        ASSERT_TRUE(DefaultThread::useNursery(&th));
+        std::vector<RCHeader*> objs;
+        for (size_t i = 0; i < 100; ++i) {
+            objs.push_back(DefaultThread::newRCObject(&th, &type));
+        }
+        for (size_t i = 0; i < objs.size(); i += 2) {
+            DefaultThread::rcRetain(&th, objs[i]);
+            DefaultThread::rcRelease(&th, objs[i]);
+        }
+        EXPECT_EQ(destructed, 50);
+
+        // Survivors get promoted and are deleted as usual afterwards
+        DefaultThread::nurseryCollect(&th);
+        DefaultThread::deleteRCObject(&th, objs[1]);
+        EXPECT_EQ(destructed, 51);
+
+        // Young objects deleted by another thread
+        RCHeader* young = DefaultThread::newRCObject(&th, &type);
+        std::thread other([&] {
+            DefaultThread otherThread;
+            DefaultThread::deleteRCObject(&otherThread, young);
+        });
+        other.join();
+        EXPECT_EQ(destructed, 52);
+        DefaultThread::rcSafePoint(&th);
+
+        DefaultThread::newRCObject(&th, &type);
+    }
+    EXPECT_EQ(destructed, 102);
+}
+
+TEST(NurseryTest, YoungDRCObjects) {
+    Type type(sizeof(DRCHeader), countDestruct);
+    destructed = 0;
+    {
+        DefaultThread th;
+        ASSERT_TRUE(DefaultThread::useNursery(&th));
+        DRCHeader* root = DefaultThread::newDRCObject(&th, &type);
+        root->rcHeader.refCount = 1;
+        DRCHeader* a = DefaultThread::newDRCObject(&th, &type);
+        DRCHeader* b = DefaultThread::newDRCObject(&th, &type);
+        DRCHeader* garbage = DefaultThread::newDRCObject(&th, &type);
+        DRCHeader* kept = DefaultThread::newDRCObject(&th, &type);
+        kept->rcHeader.refCount = 1;
+        (void) garbage;
+
+        // References take objects out of the nursery, into the graph
+        DefaultThread::drcRetainDRC(&th, root, a);
+        DefaultThread::drcRetainDRC(&th, a, b);
+        DefaultThread::drcRetainDRC(&th, b, a);
+        EXPECT_NE(a->node, nullptr);
+
+        // Unreferenced young objects are garbage at a minor collection
+        DefaultThread::nurseryCollect(&th);
+        EXPECT_EQ(destructed, 1);
+
+        DefaultThread::drcReleaseDRC(&th, root, a);
+        EXPECT_EQ(destructed, 3);
+        (void) kept;
+    }
+    EXPECT_EQ(destructed, 5);
+}
+
+TEST(NurseryTest, FallsBackWhenFull) {
+    Type type(sizeof(RCHeader) + 1000, countDestruct);
+    destructed = 0;
+    {
+        DefaultThread th;
+        ASSERT_TRUE(DefaultThread::useNursery(&th, Nursery::ChunkSize));
+        for (size_t i = 0; i < 200; ++i) {
+            DefaultThread::newRCObject(&th, &type);
+        }
+        DefaultThread::nurseryCollect(&th);
+    }
+    EXPECT_EQ(destructed, 200);
+}
@@ -0,0 +1,72 @@
+﻿#include <gtest/gtest.h>
+
+#include "runtime/rc.hpp"
+
+using Spark::Type;
+using Spark::TypeRef;
+using Spark::Runtime::RCHeader;
+using Spark::Runtime::RCInt;
+using Spark::Runtime::RefCountOverflow;
+
+TEST(RCTest, TypeRef) {
+    Type a(16);
+    Type b(32);
+    EXPECT_NE(a.index(), 0);
+    EXPECT_NE(a.index(), b.index());
+
+    RCHeader header { 0, &a };
+    EXPECT_EQ(header.type, &a);
+    EXPECT_EQ(header.type->size(), 16);
+    header.type = &b;
+    EXPECT_EQ(header.type.get(), &b);
+    header.type = nullptr;
+    EXPECT_EQ(header.type, nullptr);
+    EXPECT_EQ(header.type.index(), 0);
+}
+
+TEST(RCTest, TypeIndexReuse) {
+    uint32_t index;
+    uint64_t serial;
+    {
+        Type a(16);
+        index = a.index();
+        serial = a.serial();
+    }
+    Type b(16);
+    EXPECT_EQ(b.index(), index);
+    EXPECT_EQ(Type::fromIndex(index), &b);
+    EXPECT_NE(b.serial(), serial);
+
+    // A moved type keeps its index and serial
+    serial = b.serial();
+    Type c(std::move(b));
+    EXPECT_EQ(c.index(), index);
+    EXPECT_EQ(c.serial(), serial);
+    EXPECT_EQ(Type::fromIndex(index), &c);
+}
+
+TEST(RCTest, RefCountOverflow) {
+    RCHeader header { RefCountOverflow - 1, nullptr };
+    incrementRefCount(&header);
+    EXPECT_EQ(header.refCount, RefCountOverflow);
+    incrementRefCount(&header);
+    incrementRefCount(&header);
+    EXPECT_EQ(header.refCount, RefCountOverflow);
+    EXPECT_EQ(refCountOf(&header), RCInt{RefCountOverflow} + 2);
+
+    EXPECT_FALSE(decrementRefCount(&header));
+    EXPECT_FALSE(decrementRefCount(&header));
+    EXPECT_FALSE(decrementRefCount(&header));
+    EXPECT_EQ(header.refCount, RefCountOverflow - 1);
+    EXPECT_EQ(refCountOf(&header), RCInt{RefCountOverflow} - 1);
+
+    header.refCount = 1;
+    EXPECT_TRUE(decrementRefCount(&header));
+
+    header.refCount = RefCountOverflow;
+    incrementRefCount(&header);
+    resetRefCount(&header);
+    EXPECT_EQ(refCountOf(&header), 0);
+    header.refCount = RefCountOverflow;
+    EXPECT_EQ(refCountOf(&header), RefCountOverflow);
+}
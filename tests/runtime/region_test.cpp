@@ -0,0 +1,215 @@
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+#include "runtime/spark.hpp"
+#include "test_utils.hpp"
+
+using Spark::Type;
+using Spark::Runtime::DRCHeader;
+using Spark::Runtime::RCHeader;
+using Spark::Runtime::Region;
+using Spark::Tests::DefaultThread;
+using Spark::Tests::destructedObjects;
+using Spark::Tests::recordDestruct;
+
+TEST(RegionTest, Alloc) {
+    Type plain(24);
+    Type large(Region::LargeSize + 1);
+    Region region;
+
+    char* a = static_cast<char*>(region.alloc(&plain, plain.size()));
+    char* b = static_cast<char*>(region.alloc(&plain, plain.size()));
+    void* c = region.alloc(&large, large.size());
+    char* d = static_cast<char*>(region.alloc(&plain, plain.size()));
+    ASSERT_NE(a, nullptr);
+    ASSERT_NE(c, nullptr);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(a) % alignof(std::max_align_t), 0);
+    EXPECT_EQ(b - a, 32);
+    // Large objects don't interrupt bumping
+    EXPECT_EQ(d - b, 32);
+    EXPECT_EQ(region.objectCount(), 4);
+
+    for (size_t i = 0; i < 10000; ++i) {
+        ASSERT_NE(region.alloc(&plain, plain.size()), nullptr);
+    }
+    region.release();
+    EXPECT_EQ(region.objectCount(), 0);
+}
+
+TEST(RegionTest, DestructsInReverseOrder) {
+    Type plain(16);
+    Type finalized(16, recordDestruct);
+    Region region;
+
+    destructedObjects.clear();
+    void* a = region.alloc(&finalized, 16);
+    region.alloc(&plain, 16);
+    void* b = region.alloc(&finalized, 32, 16);
+    region.release();
+    ASSERT_EQ(destructedObjects.size(), 2);
+    EXPECT_EQ(destructedObjects[0], static_cast<char*>(b) + 16);
+    EXPECT_EQ(destructedObjects[1], a);
+}
+
+TEST(RegionTest, ThreadRegionObjects) {
+    Type rcType(sizeof(RCHeader) + 8, recordDestruct);
+    Type drcType(sizeof(DRCHeader) + 8, recordDestruct);
+    DefaultThread th;
+
+    destructedObjects.clear();
+    {
+        DefaultThread::RegionScope scope(&th);
+        RCHeader* rc = DefaultThread::newRCObject(&th, &rcType);
+        DRCHeader* a = DefaultThread::newDRCObject(&th, &drcType);
+        DRCHeader* b = DefaultThread::newDRCObject(&th, &drcType);
+        EXPECT_EQ(a->node, nullptr);
+        DefaultThread::drcRetainDRC(&th, a, b);
+        DefaultThread::drcRetainDRC(&th, b, a);
+        DefaultThread::drcReleaseDRC(&th, a, b);
+        DefaultThread::deleteRCObject(&th, rc);
+        {
+            DefaultThread::RegionScope nested(&th);
+            DefaultThread::newDRCObject(&th, &drcType);
+        }
+        EXPECT_TRUE(destructedObjects.empty());
+        EXPECT_EQ(DefaultThread::region(&th).objectCount(), 4);
+    }
+    EXPECT_EQ(destructedObjects.size(), 4);
+    EXPECT_EQ(DefaultThread::region(&th).objectCount(), 0);
+
+    // Out of the region, objects are regular again
+    DRCHeader* obj = DefaultThread::newDRCObject(&th, &drcType);
+    EXPECT_NE(obj->node, nullptr);
+}
+
+TEST(RegionTest, PinsOutsideObjects) {
+    Type type(sizeof(DRCHeader), recordDestruct);
+    DefaultThread th;
+
+    DRCHeader* root = DefaultThread::newDRCObject(&th, &type);
+    root->rcHeader.refCount = 1;
+    DRCHeader* outside = DefaultThread::newDRCObject(&th, &type);
+    DefaultThread::drcRetainDRC(&th, root, outside);
+
+    destructedObjects.clear();
+    {
+        DefaultThread::RegionScope scope(&th);
+        DRCHeader* a = DefaultThread::newDRCObject(&th, &type);
+        DRCHeader* b = DefaultThread::newDRCObject(&th, &type);
+        DefaultThread::drcRetainDRC(&th, a, outside);
+        DefaultThread::drcRetainDRC(&th, b, outside);
+        DefaultThread::drcReleaseDRC(&th, b, outside);
+
+        // Only the region keeps outside alive now
+        DefaultThread::drcReleaseDRC(&th, root, outside);
+        EXPECT_TRUE(destructedObjects.empty());
+        EXPECT_EQ(outside->rcHeader.refCount, 1);
+    }
+    // Region objects first, then the unpinned object
+    ASSERT_EQ(destructedObjects.size(), 3);
+    EXPECT_EQ(destructedObjects[2], outside);
+}
+
+TEST(RegionTest, TracedFieldsStartCleared) {
+    struct Obj {
+        DRCHeader header;
+        DRCHeader* next;
+    };
+    Type plain(sizeof(Obj));
+    Type traced(sizeof(Obj), { offsetof(Obj, next) }, recordDestruct);
+    DefaultThread th;
+    DRCHeader* outside = DefaultThread::newDRCObject(&th, &traced);
+    DefaultThread::drcRetain(&th, outside);
+
+    // Leave garbage in the chunk the region keeps for its next use
+    {
+        DefaultThread::RegionScope scope(&th);
+        for (size_t i = 0; i < 100; ++i) {
+            std::memset(static_cast<void*>(DefaultThread::newDRCObject(&th, &plain)), 0xAB, sizeof(Obj));
+        }
+    }
+
+    destructedObjects.clear();
+    {
+        DefaultThread::RegionScope scope(&th);
+        auto* a = reinterpret_cast<Obj*>(DefaultThread::newDRCObject(&th, &traced));
+        auto* b = reinterpret_cast<Obj*>(DefaultThread::newDRCObject(&th, &traced));
+        EXPECT_EQ(a->next, nullptr);
+        EXPECT_EQ(b->next, nullptr);
+        DefaultThread::drcStoreDRC(&th, &a->header, offsetof(Obj, next), &b->header);
+        DefaultThread::drcStoreDRC(&th, &b->header, offsetof(Obj, next), outside);
+        EXPECT_EQ(outside->rcHeader.refCount, 2);
+        DefaultThread::drcStoreDRC(&th, &b->header, offsetof(Obj, next), &a->header);
+        EXPECT_EQ(outside->rcHeader.refCount, 1);
+    }
+    EXPECT_EQ(destructedObjects.size(), 2);
+    DefaultThread::drcRelease(&th, outside);
+    EXPECT_EQ(destructedObjects.size(), 3);
+}
+
+TEST(RegionTest, DetectsEscapes) {
+    static std::vector<std::pair<DRCHeader*, RCHeader*>> escapes;
+    Type type(sizeof(DRCHeader));
+    DefaultThread th;
+    DefaultThread::setRegionEscapeHandler(&th, [](DRCHeader* owner, RCHeader* referencee) {
+        escapes.emplace_back(owner, referencee);
+    });
+
+    DRCHeader* root = DefaultThread::newDRCObject(&th, &type);
+    root->rcHeader.refCount = 1;
+    {
+        DefaultThread::RegionScope scope(&th);
+        DRCHeader* a = DefaultThread::newDRCObject(&th, &type);
+        DefaultThread::drcRetainDRC(&th, root, a);
+        DefaultThread::drcReleaseDRC(&th, root, a);
+        ASSERT_EQ(escapes.size(), 1);
+        EXPECT_EQ(escapes[0].first, root);
+        EXPECT_EQ(escapes[0].second, &a->rcHeader);
+    }
+    EXPECT_EQ(DefaultThread::region(&th).escapeCount(), 1);
+}
+
+TEST(RegionTest, DetectsHeldReferences) {
+    static std::vector<std::pair<DRCHeader*, RCHeader*>> escapes;
+    Type rcType(sizeof(RCHeader));
+    Type drcType(sizeof(DRCHeader));
+    DefaultThread th;
+    DefaultThread::setRegionEscapeHandler(&th, [](DRCHeader* owner, RCHeader* referencee) {
+        escapes.emplace_back(owner, referencee);
+    });
+
+    RCHeader* rc;
+    DRCHeader* drc;
+    {
+        DefaultThread::RegionScope scope(&th);
+        rc = DefaultThread::newRCObject(&th, &rcType);
+        DefaultThread::rcRetain(&th, rc);
+        DefaultThread::rcRetain(&th, rc);
+        DefaultThread::rcRelease(&th, rc);
+        EXPECT_EQ(rc->refCount, 1);
+
+        drc = DefaultThread::newDRCObject(&th, &drcType);
+        DefaultThread::drcRetain(&th, drc);
+
+        // Dropped before the region is released, in any order
+        for (size_t i = 0; i < 3; ++i) {
+            DRCHeader* local = DefaultThread::newDRCObject(&th, &drcType);
+            DefaultThread::drcRetain(&th, local);
+            RCHeader* other = DefaultThread::newRCObject(&th, &rcType);
+            DefaultThread::rcRetain(&th, other);
+            DefaultThread::drcRelease(&th, local);
+            DefaultThread::rcRelease(&th, other);
+        }
+        EXPECT_TRUE(escapes.empty());
+    }
+    // The handles to rc and drc dangle now
+    ASSERT_EQ(escapes.size(), 2);
+    EXPECT_EQ(escapes[0].first, nullptr);
+    EXPECT_EQ(escapes[0].second, rc);
+    EXPECT_EQ(escapes[1].first, nullptr);
+    EXPECT_EQ(escapes[1].second, &drc->rcHeader);
+    EXPECT_EQ(DefaultThread::region(&th).escapeCount(), 2);
+}
@@ -0,0 +1,204 @@
+﻿#include <gtest/gtest.h>
+
+#include <sstream>
+
+#include "runtime/spark.hpp"
+
+using Spark::Type;
+using Spark::Runtime::CleanupEvent;
+using Spark::Runtime::CleanupTracer;
+using Spark::Runtime::DefaultAllocator;
+using Spark::Runtime::DRC;
+using Spark::Runtime::DRCEdgeList;
+using Spark::Runtime::DRCHeader;
+using Spark::Runtime::DRCNode;
+using Spark::Runtime::RCHeader;
+using Spark::Runtime::SizeHistogram;
+using Spark::Runtime::StatsEnabled;
+using Spark::Runtime::Thread;
+
+namespace {
+    DRCHeader newObj(uint32_t externalRefCount) {
+        return DRCHeader { .node = nullptr, .rcHeader = { .refCount = externalRefCount, .type = nullptr } };
+    }
+}
+
+TEST(RuntimeStatsTest, SizeHistogram) {
+    SizeHistogram histogram;
+    histogram.add(0);
+    histogram.add(1);
+    histogram.add(2);
+    histogram.add(3);
+    histogram.add(4);
+    histogram.add(SIZE_MAX);
+    EXPECT_EQ(histogram.buckets[0], 1);
+    EXPECT_EQ(histogram.buckets[1], 1);
+    EXPECT_EQ(histogram.buckets[2], 2);
+    EXPECT_EQ(histogram.buckets[3], 1);
+    EXPECT_EQ(histogram.buckets[SizeHistogram::BucketCount - 1], 1);
+    EXPECT_EQ(histogram.count(), 6);
+}
+
+TEST(RuntimeStatsTest, ChromeTrace) {
+    using namespace std::chrono_literals;
+
+    CleanupTracer tracer(3);
+    auto start = std::chrono::steady_clock::now();
+    tracer.record(CleanupEvent{ CleanupEvent::Kind::Cleanup, start, 2us, 10, 4 });
+    tracer.record(CleanupEvent{ CleanupEvent::Kind::Step, start + 5us, 1us, 64, 0 });
+
+    std::ostringstream out;
+    Spark::Runtime::writeChromeTrace(out, { &tracer });
+    EXPECT_EQ(out.str(),
+              "{\"traceEvents\":["
+              "{\"name\":\"cleanup\",\"cat\":\"drc\",\"ph\":\"X\",\"pid\":0,\"tid\":3,\"ts\":0,\"dur\":2,"
+              "\"args\":{\"visited\":10,\"collected\":4}},"
+              "{\"name\":\"cleanup step\",\"cat\":\"drc\",\"ph\":\"X\",\"pid\":0,\"tid\":3,\"ts\":5,\"dur\":1,"
+              "\"args\":{\"visited\":64,\"collected\":0}}"
+              "],\"displayTimeUnit\":\"ns\"}");
+}
+
+TEST(RuntimeStatsTest, DRCStats) {
+    if constexpr (!StatsEnabled) {
+        GTEST_SKIP() << "built without SPARK_RUNTIME_STATS";
+    }
+
+    DRC drc;
+    CleanupTracer tracer;
+    drc.setTracer(&tracer);
+
+    DRCHeader objRoot = newObj(1);
+    DRCHeader objA = newObj(0);
+    DRCHeader objB = newObj(0);
+    DRCNode* root = drc.add(&objRoot);
+    DRCNode* a = drc.add(&objA);
+    DRCNode* b = drc.add(&objB);
+    drc.retain(root, a);
+    drc.retain(root, a);
+    drc.retain(a, b);
+    drc.retain(b, a);
+
+    // a is still referenced by root
+    EXPECT_TRUE(drc.release(root, a).empty());
+    // a and b are garbage
+    EXPECT_EQ(drc.release(root, a).size(), 2);
+
+    const auto& stats = drc.stats();
+    EXPECT_EQ(stats.retains, 4);
+    EXPECT_EQ(stats.releases, 2);
+    EXPECT_EQ(stats.cleanups, 2);
+    EXPECT_EQ(stats.abortedCleanups, 1);
+    EXPECT_DOUBLE_EQ(stats.abortRate(), 0.5);
+    EXPECT_EQ(stats.collectedNodes, 2);
+    EXPECT_EQ(stats.traversalSizes.count(), 2);
+    EXPECT_EQ(stats.traversalSizes.buckets[2], 2);
+
+    ASSERT_EQ(tracer.events().size(), 2);
+    EXPECT_EQ(tracer.events()[1].visited, 2);
+    EXPECT_EQ(tracer.events()[1].collected, 2);
+}
+
+TEST(RuntimeStatsTest, IncrementalStats) {
+    if constexpr (!StatsEnabled) {
+        GTEST_SKIP() << "built without SPARK_RUNTIME_STATS";
+    }
+
+    DRC drc;
+    CleanupTracer tracer;
+    drc.setTracer(&tracer);
+
+    DRCHeader objA = newObj(0);
+    DRCHeader objB = newObj(0);
+    DRCNode* a = drc.add(&objA);
+    DRCNode* b = drc.add(&objB);
+    drc.retain(a, b);
+    drc.retain(b, a);
+
+    drc.startCleanup(a);
+    while (drc.stepCleanup(1) == DRC::CleanupStatus::Pending) { }
+    EXPECT_EQ(drc.stats().cleanups, 1);
+    EXPECT_EQ(drc.stats().collectedNodes, 2);
+    EXPECT_EQ(drc.stats().traversalSizes.buckets[2], 1);
+    EXPECT_GT(tracer.events().size(), 1);
+    EXPECT_EQ(tracer.events().back().collected, 2);
+}
+
+TEST(RuntimeStatsTest, ParallelStats) {
+    if constexpr (!StatsEnabled) {
+        GTEST_SKIP() << "built without SPARK_RUNTIME_STATS";
+    }
+
+    DRC drc;
+    drc.setParallelCleanup(1, 2);
+
+    DRCHeader objA = newObj(0);
+    DRCHeader objB = newObj(0);
+    DRCHeader objC = newObj(0);
+    DRCNode* a = drc.add(&objA);
+    DRCNode* b = drc.add(&objB);
+    DRCNode* c = drc.add(&objC);
+
+    // A single node stays below the threshold
+    EXPECT_EQ(drc.tryCleanup(c).size(), 1);
+    EXPECT_EQ(drc.stats().parallelCleanups, 0);
+
+    drc.retain(a, b);
+    drc.retain(b, a);
+    EXPECT_EQ(drc.tryCleanup(a).size(), 2);
+    EXPECT_EQ(drc.stats().parallelCleanups, 1);
+    EXPECT_EQ(drc.stats().traversalSizes.buckets[2], 1);
+}
+
+TEST(RuntimeStatsTest, ThreadStats) {
+    if constexpr (!StatsEnabled) {
+        GTEST_SKIP() << "built without SPARK_RUNTIME_STATS";
+    }
+
+    using DefaultThread = Thread<DefaultAllocator>;
+    Type small(sizeof(RCHeader));
+    Type large(sizeof(DRCHeader) + 64);
+    DefaultThread th;
+
+    RCHeader* a = DefaultThread::newRCObject(&th, &small);
+    RCHeader* b = DefaultThread::newRCObject(&th, &small);
+    DRCHeader* c = DefaultThread::newDRCObject(&th, &large);
+    const auto& stats = DefaultThread::stats(&th);
+    size_t peak = stats.bytesLive;
+    EXPECT_GE(peak, 2 * small.size() + large.size());
+
+    DefaultThread::deleteRCObject(&th, a);
+    DefaultThread::deleteRCObject(&th, b);
+    EXPECT_EQ(stats.allocations, 3);
+    EXPECT_EQ(stats.frees, 2);
+    EXPECT_EQ(stats.typeStats(&small).allocations, 2);
+    EXPECT_EQ(stats.typeStats(&small).frees, 2);
+    EXPECT_EQ(stats.typeStats(&large).allocations, 1);
+    // The DRC node (and edge list, the type isn't traced) counts as well
+    EXPECT_EQ(stats.bytesLive, large.size() + sizeof(DRCNode) + sizeof(DRCEdgeList));
+    EXPECT_EQ(stats.bytesPeak, peak);
+    (void) c;
+}
+
+TEST(RuntimeStatsTest, ThreadStatsOfReusedTypeIndex) {
+    if constexpr (!StatsEnabled) {
+        GTEST_SKIP() << "built without SPARK_RUNTIME_STATS";
+    }
+
+    using DefaultThread = Thread<DefaultAllocator>;
+    DefaultThread th;
+    const auto& stats = DefaultThread::stats(&th);
+    uint32_t index;
+    {
+        Type old(sizeof(RCHeader));
+        index = old.index();
+        DefaultThread::deleteRCObject(&th, DefaultThread::newRCObject(&th, &old));
+        EXPECT_EQ(stats.typeStats(&old).allocations, 1);
+    }
+    Type type(sizeof(RCHeader));
+    ASSERT_EQ(type.index(), index);
+    EXPECT_EQ(stats.typeStats(&type).allocations, 0);
+    RCHeader* obj = DefaultThread::newRCObject(&th, &type);
+    EXPECT_EQ(stats.typeStats(&type).allocations, 1);
+    EXPECT_EQ(stats.typeStats(&type).frees, 0);
+    DefaultThread::deleteRCObject(&th, obj);
+}
@@ -0,0 +1,119 @@
+#include <cstdint>
+#include <cstring>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "runtime/slab_allocator.hpp"
+#include "runtime/spark.hpp"
+
+using Spark::Type;
+using Spark::Runtime::RCHeader;
+using Spark::Runtime::SlabAllocator;
+using Spark::Runtime::Thread;
+
+TEST(SlabAllocatorTest, SizeClasses) {
+    EXPECT_EQ(SlabAllocator::sizeClassOf(0), 0);
+    EXPECT_EQ(SlabAllocator::sizeClassOf(1), 0);
+    EXPECT_EQ(SlabAllocator::sizeClassOf(16), 0);
+    EXPECT_EQ(SlabAllocator::sizeClassOf(17), 1);
+    EXPECT_EQ(SlabAllocator::sizeClassOf(256), 15);
+    EXPECT_EQ(SlabAllocator::sizeClassOf(257), 16);
+    EXPECT_EQ(SlabAllocator::sizeClassOf(SlabAllocator::MaxSlabSize), SlabAllocator::SizeClassCount - 1);
+    EXPECT_EQ(SlabAllocator::sizeClassOf(SlabAllocator::MaxSlabSize + 1), SlabAllocator::SizeClassCount);
+
+    // Every size fits in its class, and the previous class is too small
+    for (size_t size = 1; size <= SlabAllocator::MaxSlabSize; ++size) {
+        size_t cls = SlabAllocator::sizeClassOf(size);
+        EXPECT_GE(SlabAllocator::blockSizeOf(cls), size);
+        if (cls > 0) {
+            EXPECT_LT(SlabAllocator::blockSizeOf(cls - 1), size);
+        }
+    }
+}
+
+TEST(SlabAllocatorTest, AllocFree) {
+    SlabAllocator allocator;
+    std::set<void*> blocks;
+    for (size_t i = 0; i < 10000; ++i) {
+        void* p = allocator.alloc(24);
+        ASSERT_NE(p, nullptr);
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(p) % alignof(std::max_align_t), 0);
+        EXPECT_TRUE(blocks.insert(p).second);
+        std::memset(p, 0xAB, 24);
+    }
+    size_t pages = allocator.pageCount();
+    EXPECT_GT(pages, 1);
+
+    // Freed blocks are reused without new pages
+    for (void* p : blocks) {
+        allocator.free(p);
+    }
+    for (size_t i = 0; i < 10000; ++i) {
+        EXPECT_EQ(blocks.count(allocator.alloc(24)), 1);
+    }
+    EXPECT_EQ(allocator.pageCount(), pages);
+}
+
+TEST(SlabAllocatorTest, Large) {
+    SlabAllocator allocator;
+    std::vector<void*> blocks;
+    for (size_t size : { size_t{4097}, size_t{100000}, SlabAllocator::PageSize, size_t{3} * SlabAllocator::PageSize }) {
+        void* p = allocator.alloc(size);
+        ASSERT_NE(p, nullptr);
+        std::memset(p, 0xCD, size);
+        blocks.push_back(p);
+    }
+    EXPECT_EQ(allocator.pageCount(), 0);
+    for (void* p : blocks) {
+        allocator.free(p);
+    }
+    allocator.free(nullptr);
+}
+
+TEST(SlabAllocatorTest, Move) {
+    SlabAllocator a;
+    void* p = a.alloc(64);
+    ASSERT_NE(p, nullptr);
+    SlabAllocator b(std::move(a));
+    EXPECT_EQ(a.pageCount(), 0);
+    EXPECT_EQ(b.pageCount(), 1);
+    b.free(p);
+    EXPECT_EQ(b.alloc(64), p);
+}
+
+TEST(SlabAllocatorTest, Thread) {
+    Spark::Runtime::Spark<SlabAllocator> spark;
+    Type type(sizeof(RCHeader) + 16);
+    Thread<SlabAllocator> th;
+    for (size_t i = 0; i < 1000; ++i) {
+        RCHeader* obj = Thread<SlabAllocator>::newRCObject(&th, &type);
+        ASSERT_NE(obj, nullptr);
+        EXPECT_EQ(obj->refCount, 0);
+        EXPECT_EQ(obj->type, &type);
+    }
+}
+
+TEST(SlabAllocatorTest, ThreadDeleteFromAnotherThread) {
+    Type type(sizeof(RCHeader) + 16);
+    Thread<SlabAllocator> owner;
+    std::set<RCHeader*> objs;
+    for (size_t i = 0; i < 1000; ++i) {
+        objs.insert(Thread<SlabAllocator>::newRCObject(&owner, &type));
+    }
+
+    std::thread other([&] {
+        Thread<SlabAllocator> th;
+        for (RCHeader* obj : objs) {
+            Thread<SlabAllocator>::deleteRCObject(&th, obj);
+        }
+    });
+    other.join();
+
+    // The objects went back to the owner, which reuses their blocks
+    for (size_t i = 0; i < 1000; ++i) {
+        EXPECT_EQ(objs.count(Thread<SlabAllocator>::newRCObject(&owner, &type)), 1);
+    }
+}
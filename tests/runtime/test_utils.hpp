@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "runtime/allocator.hpp"
+#include "runtime/thread.hpp"
+
+namespace Spark::Tests {
+
+using DefaultThread = Runtime::Thread<Runtime::DefaultAllocator>;
+
+/**
+ * Number of objects destructed by `countDestruct`, reset by each test that uses it.
+ */
+inline size_t destructed = 0;
+
+/**
+ * Objects destructed by `recordDestruct`, in destruction order.
+ */
+inline std::vector<void*> destructedObjects;
+
+/**
+ * Destructor of test types counting its calls in `destructed`.
+ */
+inline void countDestruct(void*) {
+    ++destructed;
+}
+
+/**
+ * Destructor of test types recording the destructed objects in `destructedObjects`.
+ */
+inline void recordDestruct(void* p) {
+    destructedObjects.push_back(p);
+}
+
+} // Spark::Tests
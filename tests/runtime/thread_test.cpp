@@ -0,0 +1,458 @@
+﻿#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include "runtime/slab_allocator.hpp"
+#include "runtime/spark.hpp"
+#include "test_utils.hpp"
+
+using Spark::Type;
+using Spark::Runtime::DRCHeader;
+using Spark::Runtime::DRCWeakRef;
+using Spark::Runtime::RCHeader;
+using Spark::Runtime::SlabAllocator;
+using Spark::Runtime::Thread;
+using Spark::Tests::countDestruct;
+using Spark::Tests::DefaultThread;
+using Spark::Tests::destructed;
+
+TEST(ThreadTest, DestructsSurvivingRCObjects) {
+    Type type(sizeof(RCHeader) + 8, countDestruct);
+    destructed = 0;
+    {
+        DefaultThread th;
+        std::vector<RCHeader*> objs;
+        for (size_t i = 0; i < 100; ++i) {
+            objs.push_back(DefaultThread::newRCObject(&th, &type));
+        }
+        // Delete every other one (in the middle of the registry, not only at its end)
+        for (size_t i = 0; i < objs.size(); i += 2) {
+            DefaultThread::deleteRCObject(&th, objs[i]);
+        }
+        EXPECT_EQ(destructed, 50);
+    }
+    EXPECT_EQ(destructed, 100);
+}
+
+TEST(ThreadTest, DestructsSurvivingDRCObjects) {
+    Type type(sizeof(DRCHeader), countDestruct);
+    destructed = 0;
+    {
+        DefaultThread th;
+        DRCHeader* root = DefaultThread::newDRCObject(&th, &type);
+        root->rcHeader.refCount = 1;
+        DRCHeader* a = DefaultThread::newDRCObject(&th, &type);
+        DRCHeader* b = DefaultThread::newDRCObject(&th, &type);
+        DefaultThread::drcRetainDRC(&th, root, a);
+        DefaultThread::drcRetainDRC(&th, a, b);
+
+        // Dropping the only reference to a deletes a and b
+        DefaultThread::drcReleaseDRC(&th, root, a);
+        EXPECT_EQ(destructed, 2);
+    }
+    EXPECT_EQ(destructed, 3);
+}
+
+TEST(ThreadTest, DeleteRCObjectFromAnotherThread) {
+    Type type(sizeof(RCHeader), countDestruct);
+    destructed = 0;
+    {
+        DefaultThread owner;
+        std::vector<RCHeader*> objs;
+        for (size_t i = 0; i < 1000; ++i) {
+            objs.push_back(DefaultThread::newRCObject(&owner, &type));
+        }
+
+        std::thread other([&] {
+            DefaultThread th;
+            for (size_t i = 0; i < objs.size(); i += 2) {
+                DefaultThread::deleteRCObject(&th, objs[i]);
+            }
+        });
+        other.join();
+        EXPECT_EQ(destructed, 500);
+
+        // The owner frees them at its next allocation
+        DefaultThread::newRCObject(&owner, &type);
+    }
+    EXPECT_EQ(destructed, 1001);
+}
+
+TEST(ThreadTest, BiasedRC) {
+    Type type(sizeof(RCHeader), countDestruct);
+    destructed = 0;
+    DefaultThread th;
+    RCHeader* obj = DefaultThread::newRCObject(&th, &type);
+    DefaultThread::rcRetain(&th, obj);
+    DefaultThread::rcRetain(&th, obj);
+    EXPECT_EQ(obj->refCount, 2);
+    DefaultThread::rcRelease(&th, obj);
+    EXPECT_EQ(destructed, 0);
+    DefaultThread::rcRelease(&th, obj);
+    EXPECT_EQ(destructed, 1);
+}
+
+TEST(ThreadTest, SharedRCLastReleaseOnOwner) {
+    Type type(sizeof(RCHeader), countDestruct);
+    destructed = 0;
+    DefaultThread owner;
+    RCHeader* obj = DefaultThread::newRCObject(&owner, &type);
+    DefaultThread::rcRetain(&owner, obj);
+
+    std::thread other([&] {
+        DefaultThread th;
+        DefaultThread::rcRetain(&th, obj);
+        DefaultThread::rcRetain(&th, obj);
+        DefaultThread::rcRelease(&th, obj);
+        DefaultThread::rcRelease(&th, obj);
+    });
+    other.join();
+    EXPECT_EQ(obj->refCount, 1);
+    EXPECT_EQ(destructed, 0);
+
+    DefaultThread::rcRelease(&owner, obj);
+    EXPECT_EQ(destructed, 1);
+}
+
+TEST(ThreadTest, SharedRCLastReleaseOnOtherThread) {
+    Type type(sizeof(RCHeader), countDestruct);
+    destructed = 0;
+    DefaultThread owner;
+    RCHeader* obj = DefaultThread::newRCObject(&owner, &type);
+    DefaultThread::rcRetain(&owner, obj);
+
+    DefaultThread th;
+    DefaultThread::rcRetain(&th, obj);
+    // The owner merges its count, the object now lives on the shared count
+    DefaultThread::rcRelease(&owner, obj);
+    EXPECT_EQ(destructed, 0);
+    DefaultThread::rcRetain(&owner, obj);
+    DefaultThread::rcRelease(&owner, obj);
+    EXPECT_EQ(destructed, 0);
+
+    std::thread other([&] {
+        DefaultThread::rcRelease(&th, obj);
+    });
+    other.join();
+    EXPECT_EQ(destructed, 1);
+    DefaultThread::rcSafePoint(&owner);
+}
+
+TEST(ThreadTest, SharedRCMovedReference) {
+    Type type(sizeof(RCHeader), countDestruct);
+    destructed = 0;
+    DefaultThread owner;
+    RCHeader* obj = DefaultThread::newRCObject(&owner, &type);
+    DefaultThread::rcRetain(&owner, obj);
+    DefaultThread::rcRetain(&owner, obj);
+
+    // Another thread drops the references the owner handed over
+    std::thread other([&] {
+        DefaultThread th;
+        DefaultThread::rcRelease(&th, obj);
+        DefaultThread::rcRelease(&th, obj);
+    });
+    other.join();
+    EXPECT_EQ(destructed, 0);
+
+    DefaultThread::rcSafePoint(&owner);
+    EXPECT_EQ(destructed, 1);
+}
+
+TEST(ThreadTest, SharedRCMergeLargeOwnerCount) {
+    // Merging an owner count past 2^29 doesn't wrap the shared count around to zero
+    Type type(sizeof(RCHeader), countDestruct);
+    destructed = 0;
+    DefaultThread owner;
+    RCHeader* obj = DefaultThread::newRCObject(&owner, &type);
+    obj->refCount = (1u << 30) + 1;
+
+    std::thread other([&] {
+        DefaultThread th;
+        DefaultThread::rcRelease(&th, obj);
+    });
+    other.join();
+    DefaultThread::rcSafePoint(&owner);
+    EXPECT_EQ(destructed, 0);
+
+    // The merged count is exact
+    Spark::Runtime::HeapSnapshot snapshot = DefaultThread::heapSnapshot(&owner);
+    ASSERT_EQ(snapshot.objects.size(), 1);
+    EXPECT_EQ(snapshot.objects[0].refCount, 1u << 30);
+    // The merged count would keep the object past the owner
+    DefaultThread::deleteRCObject(&owner, obj);
+}
+
+TEST(ThreadTest, SharedRCOutlivesOwner) {
+    using SlabThread = Thread<SlabAllocator>;
+    Type type(sizeof(RCHeader) + 8, countDestruct);
+    destructed = 0;
+    SlabThread th;
+    RCHeader* held;
+    RCHeader* merged;
+    RCHeader* young;
+    {
+        SlabThread owner;
+        held = SlabThread::newRCObject(&owner, &type);
+        SlabThread::rcRetain(&owner, held);
+        SlabThread::rcRetain(&th, held);
+        merged = SlabThread::newRCObject(&owner, &type);
+        SlabThread::rcRetain(&owner, merged);
+        SlabThread::rcRetain(&th, merged);
+        SlabThread::rcRelease(&owner, merged);
+        ASSERT_TRUE(SlabThread::useNursery(&owner));
+        young = SlabThread::newRCObject(&owner, &type);
+        SlabThread::rcRetain(&th, young);
+        // Only referenced by the owner
+        SlabThread::newRCObject(&owner, &type);
+    }
+    EXPECT_EQ(destructed, 1);
+
+    // Freed into the memory of the destroyed owner
+    SlabThread::rcRelease(&th, held);
+    SlabThread::rcRelease(&th, young);
+    EXPECT_EQ(destructed, 3);
+    SlabThread::rcRetain(&th, merged);
+    SlabThread::rcRelease(&th, merged);
+    SlabThread::rcRelease(&th, merged);
+    EXPECT_EQ(destructed, 4);
+}
+
+TEST(ThreadTest, SharedRCConcurrent) {
+    constexpr size_t ThreadCount = 4;
+    constexpr size_t Iterations = 10000;
+
+    Type type(sizeof(RCHeader), countDestruct);
+    destructed = 0;
+    DefaultThread owner;
+    RCHeader* obj = DefaultThread::newRCObject(&owner, &type);
+    DefaultThread::rcRetain(&owner, obj);
+    // One reference per thread, handed over by the owner
+    for (size_t i = 0; i < ThreadCount; ++i) {
+        DefaultThread::rcRetain(&owner, obj);
+    }
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < ThreadCount; ++i) {
+        threads.emplace_back([&] {
+            DefaultThread th;
+            for (size_t j = 0; j < Iterations; ++j) {
+                DefaultThread::rcRetain(&th, obj);
+                DefaultThread::rcRelease(&th, obj);
+            }
+            DefaultThread::rcRelease(&th, obj);
+        });
+    }
+    for (size_t j = 0; j < Iterations; ++j) {
+        DefaultThread::rcRetain(&owner, obj);
+        DefaultThread::rcRelease(&owner, obj);
+    }
+    for (std::thread& t : threads) {
+        t.join();
+    }
+    EXPECT_EQ(destructed, 0);
+
+    DefaultThread::rcSafePoint(&owner);
+    EXPECT_EQ(destructed, 0);
+    DefaultThread::rcRelease(&owner, obj);
+    EXPECT_EQ(destructed, 1);
+}
+
+TEST(ThreadTest, DRCSafePointFreesInBatches) {
+    // A garbage ring is freed a batch at a time, even with no time budget at all
+    constexpr size_t n = 1000;
+    Type type(sizeof(DRCHeader), countDestruct);
+    destructed = 0;
+    DefaultThread th;
+    DefaultThread::drcSetCandidateThreshold(&th, SIZE_MAX);
+    DRCHeader* root = DefaultThread::newDRCObject(&th, &type);
+    DefaultThread::drcRetain(&th, root);
+    std::vector<DRCHeader*> ring;
+    for (size_t i = 0; i < n; ++i) {
+        ring.push_back(DefaultThread::newDRCObject(&th, &type));
+    }
+    for (size_t i = 0; i < n; ++i) {
+        DefaultThread::drcRetainDRC(&th, ring[i], ring[(i + 1) % n]);
+    }
+    DefaultThread::drcRetainDRC(&th, root, ring[0]);
+    DefaultThread::drcReleaseDRC(&th, root, ring[0]);
+    EXPECT_EQ(destructed, 0);
+
+    size_t safePoints = 0;
+    size_t previous = 0;
+    bool done;
+    do {
+        done = DefaultThread::drcSafePoint(&th, std::chrono::nanoseconds(0));
+        ++safePoints;
+        // One quantum of work per safe point (`Thread::IncrementalQuantum`)
+        EXPECT_LE(destructed - previous, 64);
+        previous = destructed;
+    } while (!done);
+    EXPECT_EQ(destructed, n);
+    EXPECT_GE(safePoints, n / 64);
+    DefaultThread::drcRelease(&th, root);
+}
+
+TEST(ThreadTest, DRCReleaseBuffersCandidate) {
+    // Dropping the last external reference to a cycle defers its cleanup to the safe points like a DRC release does,
+    // while an object nothing references is deleted right away
+    Type type(sizeof(DRCHeader), countDestruct);
+    destructed = 0;
+    DefaultThread th;
+    DefaultThread::drcSetCandidateThreshold(&th, SIZE_MAX);
+    DRCHeader* a = DefaultThread::newDRCObject(&th, &type);
+    DefaultThread::drcRetain(&th, a);
+    DRCHeader* b = DefaultThread::newDRCObject(&th, &type);
+    DefaultThread::drcRetainDRC(&th, a, b);
+    DefaultThread::drcRetainDRC(&th, b, a);
+    DefaultThread::drcRelease(&th, a);
+    EXPECT_EQ(destructed, 0);
+
+    DRCHeader* c = DefaultThread::newDRCObject(&th, &type);
+    DefaultThread::drcRetain(&th, c);
+    DefaultThread::drcRelease(&th, c);
+    EXPECT_EQ(destructed, 1);
+
+    while (!DefaultThread::drcSafePoint(&th, std::chrono::milliseconds(10))) { }
+    EXPECT_EQ(destructed, 3);
+}
+
+TEST(ThreadTest, DRCStoreTracedFields) {
+    struct Obj {
+        DRCHeader header;
+        DRCHeader* next;
+    };
+    Type type(sizeof(Obj), { offsetof(Obj, next) }, countDestruct);
+    destructed = 0;
+    DefaultThread th;
+
+    auto* root = reinterpret_cast<Obj*>(DefaultThread::newDRCObject(&th, &type));
+    root->header.rcHeader.refCount = 1;
+    auto* a = reinterpret_cast<Obj*>(DefaultThread::newDRCObject(&th, &type));
+    auto* b = reinterpret_cast<Obj*>(DefaultThread::newDRCObject(&th, &type));
+    EXPECT_EQ(a->next, nullptr);
+
+    DefaultThread::drcStoreDRC(&th, &root->header, offsetof(Obj, next), &a->header);
+    DefaultThread::drcStoreDRC(&th, &a->header, offsetof(Obj, next), &b->header);
+    DefaultThread::drcStoreDRC(&th, &b->header, offsetof(Obj, next), &a->header);
+    EXPECT_EQ(b->next, &a->header);
+    EXPECT_EQ(destructed, 0);
+
+    // Overwriting the only reference to the cycle collects it
+    DefaultThread::drcStoreDRC(&th, &root->header, offsetof(Obj, next), &root->header);
+    EXPECT_EQ(destructed, 2);
+    DefaultThread::drcStoreDRC(&th, &root->header, offsetof(Obj, next), nullptr);
+    EXPECT_EQ(destructed, 2);
+}
+
+TEST(ThreadTest, DRCWeakRefs) {
+    Type type(sizeof(DRCHeader), countDestruct);
+    destructed = 0;
+    DefaultThread th;
+
+    // parent -> child, with a weak back pointer from child to parent
+    DRCHeader* parent = DefaultThread::newDRCObject(&th, &type);
+    DefaultThread::drcRetain(&th, parent);
+    DRCHeader* child = DefaultThread::newDRCObject(&th, &type);
+    DefaultThread::drcRetainDRC(&th, parent, child);
+    DRCWeakRef* back = DefaultThread::drcWeakRef(&th, parent);
+    DRCWeakRef* again = DefaultThread::drcWeakRef(&th, parent);
+    EXPECT_EQ(back, again);
+    DefaultThread::drcWeakRelease(&th, again);
+
+    // Upgrading keeps the parent alive until the strong reference is dropped
+    DRCHeader* strong = DefaultThread::drcWeakUpgrade(&th, back);
+    EXPECT_EQ(strong, parent);
+    DefaultThread::drcRelease(&th, parent);
+    EXPECT_EQ(destructed, 0);
+
+    // The weak reference doesn't keep the parent alive, and reads nullptr once it's deleted
+    DefaultThread::drcRelease(&th, strong);
+    EXPECT_EQ(destructed, 2);
+    EXPECT_EQ(DefaultThread::drcWeakUpgrade(&th, back), nullptr);
+    DefaultThread::drcWeakRelease(&th, back);
+}
+
+TEST(ThreadTest, TypePools) {
+    Type type(sizeof(RCHeader) + 8, countDestruct);
+    destructed = 0;
+    {
+        DefaultThread th;
+        RCHeader* a = DefaultThread::newRCObject(&th, &type);
+        DefaultThread::deleteRCObject(&th, a);
+        // The allocation of a is reused
+        RCHeader* b = DefaultThread::newRCObject(&th, &type);
+        EXPECT_EQ(b, a);
+
+        DRCHeader* c = DefaultThread::newDRCObject(&th, &type);
+        EXPECT_NE(static_cast<void*>(c), static_cast<void*>(b));
+        DefaultThread::setPoolCapacity(&th, &type, 0);
+        DefaultThread::deleteRCObject(&th, b);
+        EXPECT_EQ(destructed, 2);
+    }
+    EXPECT_EQ(destructed, 3);
+}
+
+TEST(ThreadTest, ReserveObjects) {
+    Type type(sizeof(DRCHeader), countDestruct);
+    destructed = 0;
+    {
+        DefaultThread th;
+        DefaultThread::reserveDRCObjects(&th, &type, 100);
+        DefaultThread::reserveRCObjects(&th, &type, 10);
+        std::vector<DRCHeader*> objs;
+        for (size_t i = 0; i < 100; ++i) {
+            objs.push_back(DefaultThread::newDRCObject(&th, &type));
+        }
+        DRCHeader* root = objs[0];
+        root->rcHeader.refCount = 1;
+        for (size_t i = 1; i < objs.size(); ++i) {
+            DefaultThread::drcRetainDRC(&th, root, objs[i]);
+        }
+        // The capacity grew to keep all of them
+        for (size_t i = 1; i < objs.size(); ++i) {
+            DefaultThread::drcReleaseDRC(&th, root, objs[i]);
+        }
+        EXPECT_EQ(destructed, 99);
+        for (size_t i = 1; i < objs.size(); ++i) {
+            DRCHeader* obj = DefaultThread::newDRCObject(&th, &type);
+            EXPECT_NE(std::find(objs.begin(), objs.end(), obj), objs.end());
+        }
+    }
+    EXPECT_EQ(destructed, 199);
+}
+
+TEST(ThreadTest, TypePoolOfReusedTypeIndex) {
+    DefaultThread th;
+    uint32_t index;
+    {
+        Type small(sizeof(RCHeader));
+        index = small.index();
+        DefaultThread::deleteRCObject(&th, DefaultThread::newRCObject(&th, &small));
+    }
+    // The pooled allocation is too small for the new type with the same index
+    Type large(sizeof(RCHeader) + 256);
+    ASSERT_EQ(large.index(), index);
+    RCHeader* obj = DefaultThread::newRCObject(&th, &large);
+    std::fill_n(reinterpret_cast<char*>(obj + 1), 256, 0);
+    DefaultThread::deleteRCObject(&th, obj);
+}
+
+TEST(ThreadTest, TypePoolCapacityOfReusedTypeIndex) {
+    DefaultThread th;
+    uint32_t index;
+    {
+        Type disabled(sizeof(RCHeader));
+        index = disabled.index();
+        DefaultThread::setPoolCapacity(&th, &disabled, 0);
+    }
+    // The new type with the same index (and size) gets the default capacity back
+    Type type(sizeof(RCHeader));
+    ASSERT_EQ(type.index(), index);
+    RCHeader* a = DefaultThread::newRCObject(&th, &type);
+    DefaultThread::deleteRCObject(&th, a);
+    EXPECT_EQ(DefaultThread::newRCObject(&th, &type), a);
+    DefaultThread::deleteRCObject(&th, a);
+}
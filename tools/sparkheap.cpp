@@ -0,0 +1,127 @@
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <numeric>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "runtime/heap_snapshot.hpp"
+
+using namespace Spark::Runtime;
+
+// Offline analysis of heap snapshots written by `writeHeapSnapshot` (see `Thread::heapSnapshot`).
+
+static void printUsage(std::ostream& os, std::string_view exe) {
+    os << "usage: " << exe << " [-n <count>] <snapshot>\n";
+}
+
+static void printObject(std::ostream& os, const HeapSnapshot::Object& object) {
+    os << "0x" << std::hex << object.address << std::dec
+       << " type " << object.type
+       << (object.flags & HeapSnapshot::DRCObject ? " drc" : " rc")
+       << (object.flags & HeapSnapshot::Young ? " young" : "")
+       << " size " << object.size
+       << " refs " << object.refCount << '/' << object.internalRefCount;
+}
+
+int main(int argc, char* argv[]) {
+    // Argument parsing
+    size_t count = 20;
+    bool hasFilePath = false;
+    std::string filePath;
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        if (arg == "-n") {
+            if (i + 1 >= argc) {
+                std::cerr << "error: -n requires an argument\n";
+                return EXIT_FAILURE;
+            }
+            count = std::strtoul(argv[++i], nullptr, 10);
+        } else {
+            if (hasFilePath) {
+                printUsage(std::cerr, argv[0]);
+                return EXIT_FAILURE;
+            }
+            filePath = argv[i];
+            hasFilePath = true;
+        }
+    }
+    if (!hasFilePath) {
+        printUsage(std::cerr, argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    std::ifstream file(filePath, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "error: cannot open file: " << filePath << "\n";
+        return EXIT_FAILURE;
+    }
+    HeapSnapshot snapshot;
+    if (!readHeapSnapshot(file, snapshot)) {
+        std::cerr << "error: not a heap snapshot: " << filePath << "\n";
+        return EXIT_FAILURE;
+    }
+    const std::vector<HeapSnapshot::Object>& objects = snapshot.objects;
+    const HeapAnalysis analysis = analyzeHeapSnapshot(snapshot);
+
+    std::cout << objects.size() << " objects, " << snapshot.edges.size() << " edges\n"
+              << "reachable: " << analysis.reachableSize << " bytes\n"
+              << "unreachable (garbage not collected yet): " << analysis.unreachableCount << " objects, "
+              << analysis.unreachableSize << " bytes\n";
+
+    // Objects by retained size
+    std::vector<uint32_t> order(objects.size());
+    std::iota(order.begin(), order.end(), 0);
+    const size_t top = std::min(count, order.size());
+    std::partial_sort(order.begin(), order.begin() + static_cast<std::ptrdiff_t>(top), order.end(),
+                      [&](uint32_t a, uint32_t b) { return analysis.retainedSizes[a] > analysis.retainedSizes[b]; });
+    std::cout << "\nlargest retained sizes:\n";
+    for (size_t i = 0; i < top; ++i) {
+        const uint32_t v = order[i];
+        std::cout << std::setw(12) << analysis.retainedSizes[v] << "  #" << v << ' ';
+        printObject(std::cout, objects[v]);
+        const uint32_t dominator = analysis.dominators[v];
+        if (dominator == HeapAnalysis::Root) {
+            std::cout << " (root)";
+        } else if (dominator != HeapAnalysis::Unreachable) {
+            std::cout << " (dominated by #" << dominator << ')';
+        }
+        std::cout << '\n';
+    }
+
+    // Types by shallow size
+    struct TypeTotal {
+        size_t count = 0;
+        uint64_t size = 0;
+    };
+    std::map<uint32_t, TypeTotal> types;
+    for (const HeapSnapshot::Object& object : objects) {
+        TypeTotal& total = types[object.type];
+        ++total.count;
+        total.size += object.size;
+    }
+    std::vector<std::pair<uint32_t, TypeTotal>> typeOrder(types.begin(), types.end());
+    std::sort(typeOrder.begin(), typeOrder.end(), [](const auto& a, const auto& b) {
+        return a.second.size > b.second.size;
+    });
+    std::cout << "\ntypes by size:\n";
+    for (size_t i = 0; i < std::min(count, typeOrder.size()); ++i) {
+        std::cout << std::setw(12) << typeOrder[i].second.size << "  type " << typeOrder[i].first << ": "
+                  << typeOrder[i].second.count << " objects\n";
+    }
+
+    std::cout << "\nlargest cycles:\n";
+    for (size_t i = 0; i < std::min(count, analysis.cycles.size()); ++i) {
+        const HeapAnalysis::Cycle& cycle = analysis.cycles[i];
+        std::cout << std::setw(12) << cycle.size << "  " << cycle.objects.size() << " objects, e.g. #"
+                  << cycle.objects.front() << ' ';
+        printObject(std::cout, objects[cycle.objects.front()]);
+        std::cout << '\n';
+    }
+
+    return EXIT_SUCCESS;
+}